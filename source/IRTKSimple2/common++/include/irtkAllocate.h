@@ -49,11 +49,6 @@ template <class Type> inline Type **Allocate(Type **matrix, int x, int y)
     matrix[i] = matrix[i-1] + x;
   }
 
-#ifdef DEBUG
-  memory_allocated += x*y*sizeof(Type);
-  cout << "Allocate: Memory allocated is " << memory_allocated << " bytes.\n";
-#endif
-
   return matrix;
 }
 
@@ -89,11 +84,6 @@ template <class Type> inline Type ***Allocate(Type ***matrix, int x, int y, int
     }
   }
 
-#ifdef DEBUG
-  memory_allocated += x*y*z*sizeof(Type);
-  cout << "Allocate: Memory allocated is " << memory_allocated << " bytes.\n";
-#endif
-
   return matrix;
 }
 
@@ -143,10 +133,49 @@ template <class Type> inline Type ****Allocate(Type ****matrix, int x, int y, in
     }
   }
 
-#ifdef DEBUG
-  memory_allocated += x*y*z*t*sizeof(Type);
-  cout << "Allocate: Memory allocated is " << memory_allocated << " bytes.\n";
-#endif
+  return matrix;
+}
+
+/// Allocate 4-dimensional pointer table for existing (e.g. memory mapped) data
+template <class Type> inline Type ****Allocate(Type ****matrix, int x, int y, int z, int t, Type *data)
+{
+  int i, j, k;
+
+  if ((matrix = new Type ***[t]) == NULL) {
+    cerr << "Allocate: malloc failed for " << x << " x " << y << " x ";
+    cerr << z << " x " << t << "\n";
+    exit(1);
+  }
+
+  if ((matrix[0] = new Type **[t*z]) == NULL) {
+    cerr << "Allocate: malloc failed for " << x << " x " << y << " x ";
+    cerr << z << " x " << t << "\n";
+    exit(1);
+  }
+
+  for (i = 1; i < t; i++) {
+    matrix[i] = matrix[i-1] + z;
+  }
+
+  if ((matrix[0][0] = new Type*[t*z*y]) == NULL) {
+    cerr << "Allocate: malloc failed for " << x << " x " << y << " x ";
+    cerr << z << " x " << t << "\n";
+    exit(1);
+  }
+
+  for (i = 0; i < t; i++) {
+    for (j = 0; j < z; j++) {
+      matrix[i][j] = matrix[0][0] + i*z*y + j*y;
+    }
+  }
+
+  for (i = 0; i < t; i++) {
+    for (j = 0; j < z; j++) {
+      for (k = 0; k < y; k++) {
+        matrix[i][j][k] = data + i*z*y*x + j*y*x + k*x;
+      }
+    }
+  }
 
   return matrix;
 }
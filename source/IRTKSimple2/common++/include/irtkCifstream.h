@@ -38,6 +38,41 @@ class irtkCifstream : public irtkObject
   long _pos;
 #endif
 
+#ifdef HAS_ZLIB
+  /// File pointer for raw access to indexed (blocked) gzip files
+  FILE *_blockFile;
+
+  /// Offsets of the gzip members of an indexed file (plus end of file)
+  vector<long> _blockOffset;
+
+  /// Uncompressed start of the gzip members of an indexed file (plus total size)
+  vector<long> _blockStart;
+
+  /// Current uncompressed position in an indexed file
+  long _blockPosition;
+
+  /// Builds the block index if the file consists of gzip members with size field
+  bool ReadBlockIndex();
+
+  /// Reads data from an indexed file, inflating blocks in parallel
+  void ReadBlocks(char *data, long start, long num);
+#endif
+
+  /// Name of the open file
+  string _filename;
+
+  /// I/O counters of the open file
+  irtkIOStatistics::Entry _statistics;
+
+  /// Time the open file was opened
+  double _opened;
+
+  /// Size of the read buffer
+  static long _BufferSize;
+
+  /// Flag whether the kernel is asked to read ahead
+  static int _ReadAhead;
+
 protected:
 
   /// Flag whether file is swapped
@@ -99,44 +134,49 @@ public:
   /// Sets whether file is swapped
   void IsSwapped(int);
 
+  /** Returns whether the file is an indexed blocked gzip file (written by
+   *  irtkCofstream with block index, or BGZF). Such files are read by
+   *  inflating only the blocks covering the requested range in parallel. */
+  int  IsIndexed();
+
+  /// Returns whether the file is compressed
+  int  IsCompressed();
+
+  /** Sets the size of the read buffer (zlib and stdio). Large buffers turn
+   *  the many small reads of headers and transformations into few large
+   *  reads from the file. */
+  static void SetBufferSize(long);
+
+  /// Returns the size of the read buffer
+  static long GetBufferSize();
+
+  /** Sets whether the kernel is told that files are read sequentially and
+   *  asked to start reading the whole file ahead (posix_fadvise). */
+  static void SetReadAhead(int);
+
+  /// Returns whether the kernel is asked to read ahead
+  static int  GetReadAhead();
+
 };
 
-inline void irtkCifstream::Open(const char *filename)
+inline void irtkCifstream::SetBufferSize(long size)
 {
-#ifdef HAS_ZLIB
-  _file = gzopen(filename, "rb");
-#else
-  _file = fopen(filename, "rb");
-#endif
+  _BufferSize = size;
+}
 
-  // Check whether file was opened successful
-  if (_file == NULL) {
-      stringstream msg;
-      msg << "cifstream::Open: Can't open file " << filename << endl;
-      cerr << msg.str();
-      throw irtkException( msg.str(),
-                           __FILE__,
-                           __LINE__ );
-  }
+inline long irtkCifstream::GetBufferSize()
+{
+  return _BufferSize;
+}
 
-#ifdef ENABLE_UNIX_COMPRESS
-  _pos = 0;
-#endif
+inline void irtkCifstream::SetReadAhead(int readahead)
+{
+  _ReadAhead = readahead;
 }
 
-inline void irtkCifstream::Close()
+inline int irtkCifstream::GetReadAhead()
 {
-  if (_file != NULL) {
-#ifdef HAS_ZLIB
-    gzclose(_file);
-#else
-    fclose(_file);
-#endif
-    _file = NULL;
-  }
-#ifdef ENABLE_UNIX_COMPRESS
-  _pos = 0;
-#endif
+  return _ReadAhead;
 }
 
 inline int irtkCifstream::IsSwapped()
@@ -149,9 +189,28 @@ inline void irtkCifstream::IsSwapped(int swapped)
   _swapped = swapped;
 }
 
+inline int irtkCifstream::IsIndexed()
+{
+#ifdef HAS_ZLIB
+  return (_blockFile != NULL);
+#else
+  return false;
+#endif
+}
+
+inline int irtkCifstream::IsCompressed()
+{
+#ifdef HAS_ZLIB
+  return (gzdirect(_file) == 0);
+#else
+  return false;
+#endif
+}
+
 inline long irtkCifstream::Tell()
 {
 #ifdef HAS_ZLIB
+  if (_blockFile != NULL) return _blockPosition;
   return gztell(_file);
 #else
   return ftell(_file);
@@ -161,6 +220,10 @@ inline long irtkCifstream::Tell()
 inline void irtkCifstream::Seek(long offset)
 {
 #ifdef HAS_ZLIB
+  if (_blockFile != NULL) {
+    _blockPosition = offset;
+    return;
+  }
   gzseek(_file, offset, SEEK_SET);
 #else
   fseek(_file, offset, SEEK_SET);
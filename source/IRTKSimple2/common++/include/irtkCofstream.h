@@ -33,8 +33,50 @@ class irtkCofstream : public irtkObject
 #ifdef HAS_ZLIB
   /// File pointer to compressed file
   gzFile _compressedFile;
+
+  /// Flag whether compressed file is written as independently deflated blocks
+  int _blocked;
+
+  /// Flag whether each block is written as gzip member with its size (block index)
+  int _indexed;
+
+  /// Uncompressed data not yet passed to the block compressor
+  vector<char> _pending;
+
+  /// Last 32K of data passed to the block compressor (dictionary of next block)
+  vector<char> _dictionary;
+
+  /// Number of uncompressed bytes written to the block compressed stream
+  long _position;
+
+  /// CRC-32 of the uncompressed data of the block compressed stream
+  unsigned long _crc;
+
+  /// Compresses pending data, the last partial block only if finish is set
+  void FlushBlocks(bool finish);
 #endif
 
+  /// Number of threads for block compression (0: automatic, 1: serial zlib)
+  static int _CompressionThreads;
+
+  /// zlib compression level of compressed files
+  static int _CompressionLevel;
+
+  /// Flag whether compressed files are written with block index
+  static int _CompressionIndex;
+
+  /// Size of the write buffer
+  static long _BufferSize;
+
+  /// Name of the open file
+  string _filename;
+
+  /// I/O counters of the open file
+  irtkIOStatistics::Entry _statistics;
+
+  /// Time the open file was opened
+  double _opened;
+
 protected:
 
   /// Flag whether file is compressed
@@ -115,10 +157,46 @@ public:
   /// Sets whether file is swapped
   void IsSwapped(int);
 
+  /** Sets the number of threads used to compress .gz files. With more than
+   *  one thread the data is deflated in independent blocks in parallel
+   *  (pigz-style); the output is still a single standard gzip stream.
+   *  0 selects the number of TBB threads, 1 the serial zlib writer. */
+  static void SetCompressionThreads(int);
+
+  /// Returns the number of threads used to compress .gz files
+  static int  GetCompressionThreads();
+
+  /// Sets the zlib compression level (0-9, -1 for the zlib default) of .gz files
+  static void SetCompressionLevel(int);
+
+  /// Returns the zlib compression level of .gz files
+  static int  GetCompressionLevel();
+
+  /** Sets whether block compressed .gz files are written with block index.
+   *  Each block is then a separate gzip member which records its compressed
+   *  size in an extra field (like BGZF), so that irtkCifstream can inflate
+   *  the blocks in parallel and seek without decompressing from the start.
+   *  The file remains a valid gzip file. Requires more than one thread. */
+  static void SetCompressionIndex(int);
+
+  /// Returns whether block compressed .gz files are written with block index
+  static int  GetCompressionIndex();
+
+  /// Sets the size of the write buffer (zlib and stdio)
+  static void SetBufferSize(long);
+
+  /// Returns the size of the write buffer
+  static long GetBufferSize();
+
 };
 
 inline void irtkCofstream::Open(const char *filename)
 {
+  _filename = filename;
+  _statistics = irtkIOStatistics::Entry();
+  _statistics.opens = 1;
+  _opened = irtkIOStatistics::Time();
+
   if (strstr(basename2(filename), ".gz") == NULL) {
     _compressed = false;
     _uncompressedFile = fopen(filename, "wb");
@@ -132,10 +210,44 @@ inline void irtkCofstream::Open(const char *filename)
                            __FILE__,
                            __LINE__ );
     }
+    if (_BufferSize > 0) setvbuf(_uncompressedFile, NULL, _IOFBF, _BufferSize);
   } else {
 #ifdef HAS_ZLIB
     _compressed = true;
-    _compressedFile = gzopen(filename, "wb");
+    if (_CompressionThreads != 1) {
+      // Block compressed gzip stream is assembled by FlushBlocks()
+      _blocked = true;
+      _indexed = _CompressionIndex;
+      _position = 0;
+      _crc = crc32(0L, Z_NULL, 0);
+      _pending.clear();
+      _dictionary.clear();
+      _uncompressedFile = fopen(filename, "wb");
+
+      // Check whether file was opened successful
+      if (_uncompressedFile == NULL) {
+        stringstream msg;
+        msg << "cofstream::Open: Can't open file " << filename << endl;
+        cerr << msg.str();
+        throw irtkException( msg.str(),
+                             __FILE__,
+                             __LINE__ );
+      }
+
+      // gzip member header: deflate, no flags, no mtime, OS unknown
+      // (indexed blocks are written with their own member headers)
+      const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 255 };
+      if (_BufferSize > 0) setvbuf(_uncompressedFile, NULL, _IOFBF, _BufferSize);
+      if (!_indexed) fwrite(header, sizeof(header), 1, _uncompressedFile);
+      return;
+    }
+    _blocked = false;
+    if (_CompressionLevel >= 0) {
+      char mode[4] = { 'w', 'b', char('0' + (_CompressionLevel > 9 ? 9 : _CompressionLevel)), 0 };
+      _compressedFile = gzopen(filename, mode);
+    } else {
+      _compressedFile = gzopen(filename, "wb");
+    }
 
     // Check whether file was opened successful
     if (_compressedFile == NULL) {
@@ -146,6 +258,9 @@ inline void irtkCofstream::Open(const char *filename)
                              __FILE__,
                              __LINE__ );
     }
+#if ZLIB_VERNUM >= 0x1240
+    if (_BufferSize > 0) gzbuffer(_compressedFile, _BufferSize);
+#endif
 #else
     stringstream msg;
     msg << "cofstream::Open: Can't write compressed file without zlib" << endl;
@@ -159,16 +274,30 @@ inline void irtkCofstream::Open(const char *filename)
 
 inline void irtkCofstream::Close()
 {
+  double t = irtkIOStatistics::Time();
+  bool open = (_uncompressedFile != NULL);
+
 #ifdef HAS_ZLIB
+  if (_blocked && (_uncompressedFile != NULL)) {
+    this->FlushBlocks(true);
+    _blocked = false;
+  }
   if (_compressedFile != NULL) {
     gzclose(_compressedFile);
     _compressedFile = NULL;
+    open = true;
   }
 #endif
   if (_uncompressedFile != NULL) {
     fclose(_uncompressedFile);
     _uncompressedFile = NULL;
   }
+
+  // Flushing the buffers is part of the time spent writing
+  if (open) {
+    _statistics.writeSeconds += irtkIOStatistics::Time() - t;
+    irtkIOStatistics::Add(_filename.c_str(), _statistics, _opened);
+  }
 }
 
 inline int irtkCofstream::IsCompressed()
@@ -191,6 +320,46 @@ inline void irtkCofstream::IsSwapped(int swapped)
   _swapped = swapped;
 }
 
+inline void irtkCofstream::SetCompressionThreads(int threads)
+{
+  _CompressionThreads = threads;
+}
+
+inline int irtkCofstream::GetCompressionThreads()
+{
+  return _CompressionThreads;
+}
+
+inline void irtkCofstream::SetCompressionLevel(int level)
+{
+  _CompressionLevel = level;
+}
+
+inline int irtkCofstream::GetCompressionLevel()
+{
+  return _CompressionLevel;
+}
+
+inline void irtkCofstream::SetCompressionIndex(int index)
+{
+  _CompressionIndex = index;
+}
+
+inline int irtkCofstream::GetCompressionIndex()
+{
+  return _CompressionIndex;
+}
+
+inline void irtkCofstream::SetBufferSize(long size)
+{
+  _BufferSize = size;
+}
+
+inline long irtkCofstream::GetBufferSize()
+{
+  return _BufferSize;
+}
+
 #endif
 
 
@@ -26,6 +26,7 @@ See LICENSE for details
 #include <algorithm>
 #include <string>
 #include <limits>
+#include <vector>
 
 // C header files
 #include <stdio.h>
@@ -112,6 +113,8 @@ extern double weightedmedian(int, double,double, float*, float*);
 #define IRTK_S2I  6    /* Superior to Inferior  */
 
 #include <irtkObject.h>
+#include <irtkIOStatistics.h>
+#include <irtkMemoryStatistics.h>
 #include <irtkCifstream.h>
 #include <irtkCofstream.h>
 #include <irtkAllocate.h>
@@ -29,11 +29,6 @@ template <class Type> inline Type **Deallocate(Type **matrix)
   delete []matrix;
   matrix = NULL;
 
-#ifdef DEBUG
-  memory_allocated -= x*y*sizeof(Type);
-  cout << "Deallocate: Memory allocated is " << memory_allocated << " bytes.\n";
-#endif
-
   return NULL;
 }
 
@@ -43,11 +38,6 @@ template <class Type> inline Type ***Deallocate(Type ***matrix)
   delete []matrix[0];
   delete []matrix;
 
-#ifdef DEBUG
-  memory_allocated -= x*y*z*sizeof(Type);
-  cout << "Deallocate: Memory allocated is " << memory_allocated << " bytes.\n";
-#endif
-
   matrix = NULL;
   return NULL;
 }
@@ -0,0 +1,67 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2011 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKIOSTATISTICS_H
+
+#define _IRTKIOSTATISTICS_H
+
+/**
+ * Statistics of file I/O.
+ *
+ * irtkCifstream and irtkCofstream count the calls, bytes and time spent
+ * reading and writing each file and add them here when the file is closed,
+ * so that slow I/O shows up next to the other timings of an application.
+ */
+
+class irtkIOStatistics
+{
+
+public:
+
+  /// Counters of one file
+  struct Entry
+  {
+    long opens;
+    long reads;
+    long readBytes;
+    double readSeconds;
+    long writes;
+    long writtenBytes;
+    double writeSeconds;
+
+    Entry() : opens(0), reads(0), readBytes(0), readSeconds(0), writes(0), writtenBytes(0), writeSeconds(0) { }
+  };
+
+  /// Callback for each closed file, times as returned by Time()
+  typedef void (*Tracer)(const char *filename, const Entry &, double opened, double closed);
+
+  /// Adds counters of a file closed now which was opened at the given time
+  static void Add(const char *filename, const Entry &, double opened = -1);
+
+  /// Sets a callback for closed files, e.g. to draw file I/O in a timeline
+  static void SetTracer(Tracer);
+
+  /// Returns counters of all files
+  static Entry Total();
+
+  /// Prints total and the files with the most time spent in I/O
+  static void Print(ostream &, int files = 10);
+
+  /// Clears all counters
+  static void Reset();
+
+  /// Wall clock time in seconds for measuring I/O calls
+  static double Time();
+
+};
+
+#endif
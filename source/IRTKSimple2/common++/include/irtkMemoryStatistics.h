@@ -0,0 +1,83 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2011 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#ifndef _IRTKMEMORYSTATISTICS_H
+
+#define _IRTKMEMORYSTATISTICS_H
+
+/// Large structures whose memory is counted
+enum irtkMemoryTag {
+  IRTK_MEMORY_IMAGES,       ///< Voxel data owned by irtkGenericImage
+  IRTK_MEMORY_SLICE_ARENA,  ///< Contiguous per-slice images of the reconstruction
+  IRTK_MEMORY_TAGS
+};
+
+/**
+ * Statistics of memory use.
+ *
+ * Counting is switched off by default and only enabled with Enable(). The
+ * owners of large structures report their memory explicitly with a tag and
+ * remember the counted size themselves, the counters are atomic and shared
+ * by all threads without a lock. Next to these counts, the resident set
+ * size of the process is reported as seen by the operating system.
+ */
+
+class irtkMemoryStatistics
+{
+
+  /// Set by Enable()
+  static bool _enabled;
+
+public:
+
+  /// Switches counting of new allocations on or off
+  static void Enable(bool enabled = true);
+
+  /// Returns whether new allocations are counted
+  static bool IsEnabled();
+
+  /// Counts bytes of a structure and returns the bytes counted (0 if disabled),
+  /// which have to be passed to Deallocated() when the structure is released
+  static long Allocated(irtkMemoryTag, long bytes);
+
+  /// Releases bytes returned by Allocated()
+  static void Deallocated(irtkMemoryTag, long bytes);
+
+  /// Returns the bytes of a structure type currently counted
+  static long Current(irtkMemoryTag);
+
+  /// Returns the bytes of all structures currently counted
+  static long Current();
+
+  /// Returns the maximum of Current() since start or the last ResetPeak()
+  static long Peak();
+
+  /// Sets the peak to the current allocation
+  static void ResetPeak();
+
+  /// Returns the resident set size of the process in bytes (0 if unknown)
+  static long ResidentSetSize();
+
+  /// Returns the peak resident set size of the process in bytes (0 if unknown)
+  static long PeakResidentSetSize();
+
+  /// Returns the physical memory of the machine in bytes (0 if unknown)
+  static long PhysicalMemory();
+
+};
+
+inline bool irtkMemoryStatistics::IsEnabled()
+{
+  return _enabled;
+}
+
+#endif
@@ -14,12 +14,42 @@
 
 #define _IRTKPARALLEL_H
 
+#include <cstddef>
+
 /// Debugging level of parallel code
 extern int tbb_debug;
 
 /// Number of threads to use
 extern int tbb_no_threads;
 
+/// Pin the threads of the parallel code to cores
+extern bool tbb_pin_threads;
+
+/// Placement of memory on NUMA systems
+enum irtkNumaPolicy {
+  /// Leave the placement to the operating system
+  NUMA_Default,
+  /// Interleave the pages of all allocations across the NUMA nodes
+  NUMA_Interleave,
+  /// Large images are zero initialised in parallel such that their pages
+  /// are spread over the nodes of the threads which work on them
+  NUMA_FirstTouch
+};
+
+/// Memory placement policy on NUMA systems
+extern irtkNumaPolicy tbb_numa_policy;
+
+/// Configure the parallel code at the start of the program
+///
+/// May be called again between parallel sections to change the number of
+/// threads, e.g. to compare thread counts in one process. Arguments which are not set (threads <= 0, pin false, numa NULL or empty)
+/// are taken from the environment variables IRTK_THREADS, IRTK_PIN_THREADS
+/// and IRTK_NUMA (default, interleave, first-touch).
+void irtkInitializeParallel(int threads = 0, bool pin = false, const char *numa = NULL);
+
+/// Number of threads of the persistent task arena
+int irtkParallelThreads();
+
 // If TBB is available and BUILD_TBB_EXE is set to ON, use TBB to execute
 // any parallelizable code concurrently
 //
@@ -39,7 +69,53 @@ extern int tbb_no_threads;
 #  include <tbb/tick_count.h>
 #  include <tbb/concurrent_queue.h>
 #  include <tbb/mutex.h>
+#  include <tbb/task_arena.h>
 using namespace tbb;
+
+/// Persistent task arena in which all parallel code is executed
+///
+/// The arena is created by irtkInitializeParallel (or with the default number
+/// of threads on first use) instead of initialising the task scheduler for
+/// every parallel section. Only irtkInitializeParallel changes the number of
+/// threads; it replaces the arena, but never destroys the old one.
+task_arena &irtkArena();
+
+template <class Range, class Body>
+class irtkArenaParallelFor
+{
+  const Range &_range;
+  const Body &_body;
+
+public:
+  irtkArenaParallelFor(const Range &range, const Body &body) : _range(range), _body(body) {}
+  void operator()() const { parallel_for(_range, _body); }
+};
+
+template <class Range, class Body>
+class irtkArenaParallelReduce
+{
+  const Range &_range;
+  Body &_body;
+
+public:
+  irtkArenaParallelReduce(const Range &range, Body &body) : _range(range), _body(body) {}
+  void operator()() const { parallel_reduce(_range, _body); }
+};
+
+/// parallel_for executed in the persistent task arena
+template <class Range, class Body>
+void irtkParallelFor(const Range &range, const Body &body) {
+  irtkArenaParallelFor<Range, Body> f(range, body);
+  irtkArena().execute(f);
+}
+
+/// parallel_reduce executed in the persistent task arena
+template <class Range, class Body>
+void irtkParallelReduce(const Range &range, Body &body) {
+  irtkArenaParallelReduce<Range, Body> f(range, body);
+  irtkArena().execute(f);
+}
+
 // Otherwise, use dummy implementations of TBB classes/functions which allows
 // developers to write parallelizable code as if TBB was available and yet
 // executes the code serially due to the lack of TBB (or BUILD_TBB_EXE set to OFF).
@@ -137,6 +213,16 @@ using namespace tbb;
   }
 
   struct split {};
+
+  template <class Range, class Body>
+  void irtkParallelFor(const Range &range, const Body &body) {
+    body(range);
+  }
+
+  template <class Range, class Body>
+  void irtkParallelReduce(const Range &range, Body &body) {
+    body(range);
+  }
 #endif
 
 /// Preprocessor flag to over all remove timing code from binary must be
@@ -12,9 +12,209 @@
 
 #include <irtkCommon.h>
 
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Default: 1MB read buffer
+long irtkCifstream::_BufferSize = 1048576;
+
+// Default: No read ahead hints
+int irtkCifstream::_ReadAhead = false;
+
+#ifdef HAS_ZLIB
+
+/// Reads a little endian unsigned integer of n bytes
+static inline unsigned long irtkGetLittleEndian(const unsigned char *buffer, int n)
+{
+  unsigned long value = 0;
+  for (int i = n - 1; i >= 0; i--) value = (value << 8) | buffer[i];
+  return value;
+}
+
+class irtkMultiThreadedBlockInflate
+{
+  /// Compressed gzip members, starting with the first member of the range
+  const unsigned char *_input;
+
+  /// Offsets of the gzip members in the file
+  const vector<long> &_offset;
+
+  /// Uncompressed start of the gzip members
+  const vector<long> &_start;
+
+  /// First member of the range
+  int _first;
+
+  /// Uncompressed range which is read
+  long _from, _to;
+
+  /// Output buffer of the uncompressed range
+  char *_output;
+
+  /// Status of each member of the range, set to 1 if it can't be inflated
+  vector<char> &_failed;
+
+public:
+
+  irtkMultiThreadedBlockInflate(const unsigned char *input, const vector<long> &offset, const vector<long> &start,
+                                int first, long from, long to, char *output, vector<char> &failed) :
+    _input(input), _offset(offset), _start(start), _first(first), _from(from), _to(to), _output(output), _failed(failed) {
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int b;
+    long header, length, from, to;
+    z_stream strm;
+    vector<char> buffer;
+
+    for (b = r.begin(); b != r.end(); b++) {
+      const unsigned char *member = _input + (_offset[b] - _offset[_first]);
+      long size = _offset[b+1] - _offset[b];
+
+      // Skip member header (indexed members always have an extra field)
+      header = 12 + irtkGetLittleEndian(member + 10, 2);
+      if (member[3] & 8)  while ((header < size) && member[header++] != 0);
+      if (member[3] & 16) while ((header < size) && member[header++] != 0);
+      if (member[3] & 2)  header += 2;
+
+      // Inflate straight into the output unless only part of the block is needed
+      length = _start[b+1] - _start[b];
+      from   = max(_from, _start[b]);
+      to     = min(_to,   _start[b+1]);
+      char *out;
+      if ((from == _start[b]) && (to == _start[b+1])) {
+        out = _output + (from - _from);
+      } else {
+        buffer.resize(length + 1);
+        out = &buffer[0];
+      }
+
+      memset(&strm, 0, sizeof(strm));
+      if (inflateInit2(&strm, -15) != Z_OK) {
+        _failed[b - _first] = 1;
+        return;
+      }
+      strm.next_in   = (Bytef *)(member + header);
+      strm.avail_in  = size - header - 8;
+      strm.next_out  = (Bytef *)out;
+      strm.avail_out = length;
+      int status = inflate(&strm, Z_FINISH);
+      inflateEnd(&strm);
+      if ((status != Z_STREAM_END) || (long(strm.total_out) != length) ||
+          (crc32(0L, (const Bytef *)out, length) != irtkGetLittleEndian(member + size - 8, 4))) {
+        _failed[b - _first] = 1;
+        return;
+      }
+
+      if (out != _output + (from - _from)) memcpy(_output + (from - _from), out + (from - _start[b]), to - from);
+    }
+  }
+};
+
+bool irtkCifstream::ReadBlockIndex()
+{
+  unsigned char header[12], extra[256], trailer[4];
+  long offset, start, size, length;
+  int i, xlen;
+
+  _blockOffset.clear();
+  _blockStart.clear();
+
+  // Get size of file
+  if (fseek(_blockFile, 0, SEEK_END) != 0) return false;
+  length = ftell(_blockFile);
+
+  offset = 0;
+  start  = 0;
+  while (offset < length) {
+    // Every member must be gzip with an extra field holding its size
+    if (fseek(_blockFile, offset, SEEK_SET) != 0) return false;
+    if (fread(header, sizeof(header), 1, _blockFile) != 1) return false;
+    if ((header[0] != 0x1f) || (header[1] != 0x8b) || (header[2] != 8) || !(header[3] & 4)) return false;
+    xlen = irtkGetLittleEndian(header + 10, 2);
+    if ((xlen > int(sizeof(extra))) || (fread(extra, xlen, 1, _blockFile) != 1)) return false;
+
+    // Find block size subfield, 'IR' (irtkCofstream) or 'BC' (BGZF)
+    size = 0;
+    for (i = 0; i + 4 <= xlen; i += 4 + irtkGetLittleEndian(extra + i + 2, 2)) {
+      int n = irtkGetLittleEndian(extra + i + 2, 2);
+      if ((extra[i] == 'I') && (extra[i+1] == 'R') && (n == 4) && (i + 8 <= xlen)) {
+        size = irtkGetLittleEndian(extra + i + 4, 4) + 1;
+      } else if ((extra[i] == 'B') && (extra[i+1] == 'C') && (n == 2) && (i + 6 <= xlen)) {
+        size = irtkGetLittleEndian(extra + i + 4, 2) + 1;
+      }
+    }
+    if ((size < 12 + xlen + 8) || (offset + size > length)) return false;
+
+    // Uncompressed size of the member from the trailer
+    if (fseek(_blockFile, offset + size - 4, SEEK_SET) != 0) return false;
+    if (fread(trailer, sizeof(trailer), 1, _blockFile) != 1) return false;
+
+    _blockOffset.push_back(offset);
+    _blockStart.push_back(start);
+    offset += size;
+    start  += irtkGetLittleEndian(trailer, 4);
+  }
+  if (_blockOffset.size() == 0) return false;
+  _blockOffset.push_back(offset);
+  _blockStart.push_back(start);
+
+  return true;
+}
+
+void irtkCifstream::ReadBlocks(char *mem, long start, long num)
+{
+  int first, last;
+
+  if (start == -1) start = _blockPosition;
+
+  // Clip to uncompressed size like gzread
+  if (start + num > _blockStart.back()) num = max(0L, _blockStart.back() - start);
+  _blockPosition = start + num;
+  if (num <= 0) return;
+
+  // Find members covering the range
+  first = upper_bound(_blockStart.begin(), _blockStart.end(), start) - _blockStart.begin() - 1;
+  last  = lower_bound(_blockStart.begin(), _blockStart.end(), start + num) - _blockStart.begin();
+
+  // Read compressed data of the members at once
+  vector<unsigned char> input(_blockOffset[last] - _blockOffset[first]);
+  fseek(_blockFile, _blockOffset[first], SEEK_SET);
+  if (fread(&input[0], input.size(), 1, _blockFile) != 1) {
+    stringstream msg;
+    msg << "cifstream::Read: Can't read compressed blocks" << endl;
+    cerr << msg.str();
+    throw irtkException( msg.str(),
+                         __FILE__,
+                         __LINE__ );
+  }
+
+  // Every task only writes the status of its own members
+  vector<char> failed(last - first, 0);
+  irtkParallelFor(blocked_range<int>(first, last), irtkMultiThreadedBlockInflate(&input[0], _blockOffset, _blockStart, first, start, start + num, mem, failed));
+
+  if (find(failed.begin(), failed.end(), 1) != failed.end()) {
+    stringstream msg;
+    msg << "cifstream::Read: Corrupt compressed block" << endl;
+    cerr << msg.str();
+    throw irtkException( msg.str(),
+                         __FILE__,
+                         __LINE__ );
+  }
+}
+
+#endif
+
 irtkCifstream::irtkCifstream()
 {
   _file = NULL;
+  _opened = 0;
+#ifdef HAS_ZLIB
+  _blockFile = NULL;
+  _blockPosition = 0;
+#endif
 #ifndef WORDS_BIGENDIAN
   _swapped = true;
 #else
@@ -30,8 +230,99 @@ irtkCifstream::~irtkCifstream()
   this->Close();
 }
 
+void irtkCifstream::Open(const char *filename)
+{
+  int fd = -1;
+
+  _opened = irtkIOStatistics::Time();
+
+#ifndef WIN32
+  fd = open(filename, O_RDONLY);
+#ifdef POSIX_FADV_SEQUENTIAL
+  if ((fd >= 0) && _ReadAhead) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  }
+#endif
+#endif
+
+#ifdef HAS_ZLIB
+  if (fd >= 0) {
+    _file = gzdopen(fd, "rb");
+    if (_file == NULL) close(fd);
+  } else {
+    _file = gzopen(filename, "rb");
+  }
+  if (_file != NULL) {
+#if ZLIB_VERNUM >= 0x1240
+    if (_BufferSize > 0) gzbuffer(_file, _BufferSize);
+#endif
+    _blockPosition = 0;
+    _blockFile = fopen(filename, "rb");
+    if ((_blockFile != NULL) && (this->ReadBlockIndex() == false)) {
+      fclose(_blockFile);
+      _blockFile = NULL;
+    }
+  }
+#else
+  if (fd >= 0) {
+    _file = fdopen(fd, "rb");
+    if (_file == NULL) close(fd);
+  } else {
+    _file = fopen(filename, "rb");
+  }
+  if ((_file != NULL) && (_BufferSize > 0)) setvbuf(_file, NULL, _IOFBF, _BufferSize);
+#endif
+
+  // Check whether file was opened successful
+  if (_file == NULL) {
+      stringstream msg;
+      msg << "cifstream::Open: Can't open file " << filename << endl;
+      cerr << msg.str();
+      throw irtkException( msg.str(),
+                           __FILE__,
+                           __LINE__ );
+  }
+
+  _filename = filename;
+  _statistics = irtkIOStatistics::Entry();
+  _statistics.opens = 1;
+
+#ifdef ENABLE_UNIX_COMPRESS
+  _pos = 0;
+#endif
+}
+
+void irtkCifstream::Close()
+{
+#ifdef HAS_ZLIB
+  if (_blockFile != NULL) {
+    fclose(_blockFile);
+    _blockFile = NULL;
+  }
+  _blockOffset.clear();
+  _blockStart.clear();
+#endif
+  if (_file != NULL) {
+#ifdef HAS_ZLIB
+    gzclose(_file);
+#else
+    fclose(_file);
+#endif
+    _file = NULL;
+    irtkIOStatistics::Add(_filename.c_str(), _statistics, _opened);
+  }
+#ifdef ENABLE_UNIX_COMPRESS
+  _pos = 0;
+#endif
+}
+
 void irtkCifstream::Read(char *mem, long start, long num)
 {
+  double t = irtkIOStatistics::Time();
+  _statistics.reads++;
+  _statistics.readBytes += num;
+
   // Read data uncompressed
 #ifdef ENABLE_UNIX_COMPRESS
   if (start == -1) {
@@ -43,13 +334,19 @@ void irtkCifstream::Read(char *mem, long start, long num)
   }
 #else
 #ifdef HAS_ZLIB
-  if (start != -1) gzseek(_file, start, SEEK_SET);
-  gzread(_file, mem, num);
+  if (_blockFile != NULL) {
+    this->ReadBlocks(mem, start, num);
+  } else {
+    if (start != -1) gzseek(_file, start, SEEK_SET);
+    gzread(_file, mem, num);
+  }
 #else
   if (start != -1) fseek(_file, start, SEEK_SET);
   fread(mem, num, 1, _file);
 #endif
 #endif
+
+  _statistics.readSeconds += irtkIOStatistics::Time() - t;
 }
 
 void irtkCifstream::ReadAsChar(char *data, long length, long offset)
@@ -122,15 +419,28 @@ void irtkCifstream::ReadAsDouble(double *data, long length, long offset)
 
 void irtkCifstream::ReadAsString(char *data, long length, long offset)
 {
+  double t = irtkIOStatistics::Time();
+
   // Read string
 #ifdef HAS_ZLIB
-  if (offset != -1) gzseek(_file, offset, SEEK_SET);
-  gzgets(_file, data, length);
+  if (_blockFile != NULL) {
+    // Strings are rare (headers), read them through zlib
+    gzseek(_file, (offset != -1) ? offset : _blockPosition, SEEK_SET);
+    gzgets(_file, data, length);
+    _blockPosition = gztell(_file);
+  } else {
+    if (offset != -1) gzseek(_file, offset, SEEK_SET);
+    gzgets(_file, data, length);
+  }
 #else
   if (offset!= -1) fseek(_file, offset, SEEK_SET);
   fgets(data, length, _file);
 #endif
 
+  _statistics.reads++;
+  _statistics.readBytes += strlen(data);
+  _statistics.readSeconds += irtkIOStatistics::Time() - t;
+
   // Check for UNIX end-of-line char
   if ((strlen(data) > 0) && (data[strlen(data)-1] = '\n')) {
     data[strlen(data)-1] = '\0';
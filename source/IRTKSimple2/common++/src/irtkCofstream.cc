@@ -12,8 +12,192 @@
 
 #include <irtkCommon.h>
 
+// Default: Block compression with the number of TBB threads
+int irtkCofstream::_CompressionThreads = 0;
+
+// Default: zlib default compression level
+int irtkCofstream::_CompressionLevel = -1;
+
+// Default: Single gzip member without block index
+int irtkCofstream::_CompressionIndex = false;
+
+// Default: 1MB write buffer
+long irtkCofstream::_BufferSize = 1048576;
+
+#ifdef HAS_ZLIB
+
+/// Size of the independently deflated blocks (pigz uses the same default)
+#define IRTK_GZIP_BLOCK_SIZE (128*1024)
+
+/// Number of blocks compressed concurrently before they are written
+#define IRTK_GZIP_BATCH_BLOCKS 64
+
+/// Size of the deflate window used as dictionary of the following block
+#define IRTK_GZIP_DICTIONARY_SIZE 32768
+
+/// Size of the gzip member header of indexed blocks (incl. 'IR' extra subfield)
+#define IRTK_GZIP_INDEX_HEADER_SIZE 20
+
+class irtkMultiThreadedBlockDeflate
+{
+  /// Uncompressed data of the batch
+  const char *_data;
+
+  /// Length of the uncompressed data of the batch
+  long _length;
+
+  /// Dictionary for the first block of the batch
+  const vector<char> &_dictionary;
+
+  /// Whether the last block of the batch terminates the stream
+  bool _finish;
+
+  /// Whether each block is written as separate gzip member with its size
+  bool _indexed;
+
+  /// zlib compression level
+  int _level;
+
+  /// Compressed blocks
+  vector<vector<unsigned char> > &_output;
+
+  /// CRC-32 of the uncompressed blocks
+  vector<unsigned long> &_crc;
+
+public:
+
+  irtkMultiThreadedBlockDeflate(const char *data, long length, const vector<char> &dictionary, bool finish, bool indexed, int level,
+                                vector<vector<unsigned char> > &output, vector<unsigned long> &crc) :
+    _data(data), _length(length), _dictionary(dictionary), _finish(finish), _indexed(indexed), _level(level), _output(output), _crc(crc) {
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int b, i;
+    long start, length, header;
+    unsigned long size;
+    z_stream strm;
+
+    for (b = r.begin(); b != r.end(); b++) {
+      start  = long(b) * IRTK_GZIP_BLOCK_SIZE;
+      length = min(long(IRTK_GZIP_BLOCK_SIZE), _length - start);
+      bool last = _indexed || (_finish && (b == int(_output.size()) - 1));
+      header = _indexed ? IRTK_GZIP_INDEX_HEADER_SIZE : 0;
+
+      memset(&strm, 0, sizeof(strm));
+      if (deflateInit2(&strm, _level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        cerr << "irtkCofstream: Can't initialize deflate" << endl;
+        exit(1);
+      }
+
+      // Prime the window with the data preceding the block, unless
+      // blocks have to be inflated independently
+      if (_indexed) {
+        // No dictionary
+      } else if (b > 0) {
+        deflateSetDictionary(&strm, (const Bytef *)(_data + start - IRTK_GZIP_DICTIONARY_SIZE), IRTK_GZIP_DICTIONARY_SIZE);
+      } else if (_dictionary.size() > 0) {
+        deflateSetDictionary(&strm, (const Bytef *)&_dictionary[0], _dictionary.size());
+      }
+
+      // Blocks other than the last end on a byte boundary (sync flush),
+      // so that their raw deflate data can simply be concatenated
+      vector<unsigned char> &out = _output[b];
+      out.resize(header + deflateBound(&strm, length) + 16);
+      strm.next_in   = (Bytef *)(_data + start);
+      strm.avail_in  = length;
+      strm.next_out  = &out[header];
+      strm.avail_out = out.size() - header;
+      while (true) {
+        deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+        if (strm.avail_out > 0) break;
+        out.resize(2 * out.size());
+        strm.next_out  = &out[header + strm.total_out];
+        strm.avail_out = out.size() - header - strm.total_out;
+      }
+      out.resize(header + strm.total_out);
+      deflateEnd(&strm);
+
+      _crc[b] = crc32(0L, (const Bytef *)(_data + start), length);
+
+      if (_indexed) {
+        // gzip member header with extra field: subfield 'IR' holds the
+        // total size of the member minus 1 (32 bit, little endian)
+        size = out.size() + 8;
+        const unsigned char member[IRTK_GZIP_INDEX_HEADER_SIZE] = { 0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 255, 8, 0, 'I', 'R', 4, 0 };
+        for (i = 0; i < IRTK_GZIP_INDEX_HEADER_SIZE - 4; i++) out[i] = member[i];
+        for (i = 0; i < 4; i++) out[IRTK_GZIP_INDEX_HEADER_SIZE - 4 + i] = ((size - 1) >> (8 * i)) & 0xff;
+        // gzip member trailer
+        for (i = 0; i < 4; i++) out.push_back((_crc[b] >> (8 * i)) & 0xff);
+        for (i = 0; i < 4; i++) out.push_back(((unsigned long)length >> (8 * i)) & 0xff);
+      }
+    }
+  }
+};
+
+void irtkCofstream::FlushBlocks(bool finish)
+{
+  int b, blocks;
+  long length;
+
+  if (finish) {
+    // The final block is always written, even if empty, to terminate the stream
+    length = _pending.size();
+    blocks = max(1L, (length + IRTK_GZIP_BLOCK_SIZE - 1) / IRTK_GZIP_BLOCK_SIZE);
+  } else {
+    blocks = _pending.size() / IRTK_GZIP_BLOCK_SIZE;
+    length = long(blocks) * IRTK_GZIP_BLOCK_SIZE;
+    if (blocks == 0) return;
+  }
+
+  vector<vector<unsigned char> > output(blocks);
+  vector<unsigned long> crc(blocks);
+  const char *data = (_pending.size() > 0) ? &_pending[0] : NULL;
+
+  blocked_range<int> range(0, blocks);
+  irtkMultiThreadedBlockDeflate deflate(data, length, _dictionary, finish, _indexed, _CompressionLevel, output, crc);
+#ifdef HAS_TBB
+  if (_CompressionThreads > 0) {
+    // Own arena, compression may use another number of threads than the computation
+    task_arena arena(_CompressionThreads);
+    arena.execute(irtkArenaParallelFor<blocked_range<int>, irtkMultiThreadedBlockDeflate>(range, deflate));
+  } else {
+    irtkParallelFor(range, deflate);
+  }
+#else
+  irtkParallelFor(range, deflate);
+#endif
+
+  for (b = 0; b < blocks; b++) {
+    if (output[b].size() > 0) fwrite(&output[b][0], output[b].size(), 1, _uncompressedFile);
+    _crc = crc32_combine(_crc, crc[b], min(long(IRTK_GZIP_BLOCK_SIZE), length - long(b) * IRTK_GZIP_BLOCK_SIZE));
+  }
+
+  // Keep the end of the compressed data as dictionary of the next batch
+  _dictionary.insert(_dictionary.end(), _pending.begin(), _pending.begin() + length);
+  if (_dictionary.size() > IRTK_GZIP_DICTIONARY_SIZE) {
+    _dictionary.erase(_dictionary.begin(), _dictionary.end() - IRTK_GZIP_DICTIONARY_SIZE);
+  }
+  _pending.erase(_pending.begin(), _pending.begin() + length);
+
+  if (finish && !_indexed) {
+    // gzip member trailer: CRC-32 and length modulo 2^32, little endian
+    unsigned char trailer[8];
+    unsigned long size = (unsigned long)_position;
+    for (b = 0; b < 4; b++) {
+      trailer[b]   = (_crc >> (8 * b)) & 0xff;
+      trailer[b+4] = (size >> (8 * b)) & 0xff;
+    }
+    fwrite(trailer, sizeof(trailer), 1, _uncompressedFile);
+  }
+  if (finish) _dictionary.clear();
+}
+
+#endif
+
 irtkCofstream::irtkCofstream()
 {
+  _opened = 0;
+
 #ifndef WORDS_BIGENDIAN
   _swapped = true;
 #else
@@ -22,6 +206,10 @@ irtkCofstream::irtkCofstream()
 
 #ifdef HAS_ZLIB
   _compressedFile = NULL;
+  _blocked  = false;
+  _indexed  = false;
+  _position = 0;
+  _crc      = 0;
 #endif
   _uncompressedFile = NULL;
 }
@@ -33,11 +221,42 @@ irtkCofstream::~irtkCofstream()
 
 void irtkCofstream::Write(char *data, long offset, long length)
 {
+  double t = irtkIOStatistics::Time();
+  _statistics.writes++;
+  _statistics.writtenBytes += length;
+
   if (_compressed == false) {
     if (offset != -1) fseek(_uncompressedFile, offset, SEEK_SET);
     fwrite(data, length, 1, _uncompressedFile);
   } else {
 #ifdef HAS_ZLIB
+    if (_blocked) {
+      if (offset != -1) {
+        if (_position > offset) {
+          stringstream msg;
+          msg << "Warning, writing compressed files only supports forward seek" << _position << " " << offset << endl;
+          cerr << msg.str();
+          throw irtkException( msg.str(),
+                               __FILE__,
+                               __LINE__ );
+        }
+        // Forward seek fills the gap with zeros like gzseek
+        _pending.insert(_pending.end(), offset - _position, 0);
+        _position = offset;
+      }
+      // Buffer at most one batch so that large writes are not copied as a whole
+      const long batch = long(IRTK_GZIP_BATCH_BLOCKS) * IRTK_GZIP_BLOCK_SIZE;
+      while (length > 0) {
+        long n = min(length, batch - long(_pending.size()));
+        _pending.insert(_pending.end(), data, data + n);
+        _position += n;
+        data      += n;
+        length    -= n;
+        if (long(_pending.size()) >= batch) this->FlushBlocks(false);
+      }
+      _statistics.writeSeconds += irtkIOStatistics::Time() - t;
+      return;
+    }
     if (offset != -1) {
       if (gztell(_compressedFile) > offset) {
           stringstream msg;
@@ -52,6 +271,8 @@ void irtkCofstream::Write(char *data, long offset, long length)
     gzwrite(_compressedFile, data, length);
 #endif
   }
+
+  _statistics.writeSeconds += irtkIOStatistics::Time() - t;
 }
 
 void irtkCofstream::WriteAsChar(char data, long offset)
@@ -190,6 +411,10 @@ void irtkCofstream::WriteAsDouble(double data, long offset)
 
 void irtkCofstream::WriteAsString(char *data, long offset)
 {
+  double t = irtkIOStatistics::Time();
+  _statistics.writes++;
+  _statistics.writtenBytes += strlen(data);
+
   if (_compressed == false) {
     if (offset!= -1) fseek(_uncompressedFile, offset, SEEK_SET);
     fputs(data, _uncompressedFile);
@@ -199,4 +424,6 @@ void irtkCofstream::WriteAsString(char *data, long offset)
     gzputs(_compressedFile, data);
 #endif
   }
+
+  _statistics.writeSeconds += irtkIOStatistics::Time() - t;
 }
@@ -0,0 +1,122 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2011 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkCommon.h>
+
+#include <irtkIOStatistics.h>
+
+#include <map>
+#include <algorithm>
+
+#ifndef WIN32
+#include <sys/time.h>
+#endif
+
+static map<string, irtkIOStatistics::Entry> _Statistics;
+
+#ifdef HAS_TBB
+static tbb::mutex _StatisticsMutex;
+#endif
+
+static irtkIOStatistics::Tracer _Tracer = NULL;
+
+void irtkIOStatistics::SetTracer(Tracer tracer)
+{
+  _Tracer = tracer;
+}
+
+void irtkIOStatistics::Add(const char *filename, const Entry &entry, double opened)
+{
+  // Called without lock, the tracer records into buffers of the calling thread
+  if ((_Tracer != NULL) && (opened >= 0)) _Tracer(filename, entry, opened, Time());
+
+#ifdef HAS_TBB
+  tbb::mutex::scoped_lock lock(_StatisticsMutex);
+#endif
+  Entry &e = _Statistics[filename];
+  e.opens        += entry.opens;
+  e.reads        += entry.reads;
+  e.readBytes    += entry.readBytes;
+  e.readSeconds  += entry.readSeconds;
+  e.writes       += entry.writes;
+  e.writtenBytes += entry.writtenBytes;
+  e.writeSeconds += entry.writeSeconds;
+}
+
+irtkIOStatistics::Entry irtkIOStatistics::Total()
+{
+#ifdef HAS_TBB
+  tbb::mutex::scoped_lock lock(_StatisticsMutex);
+#endif
+  Entry total;
+  for (map<string, Entry>::const_iterator it = _Statistics.begin(); it != _Statistics.end(); ++it) {
+    total.opens        += it->second.opens;
+    total.reads        += it->second.reads;
+    total.readBytes    += it->second.readBytes;
+    total.readSeconds  += it->second.readSeconds;
+    total.writes       += it->second.writes;
+    total.writtenBytes += it->second.writtenBytes;
+    total.writeSeconds += it->second.writeSeconds;
+  }
+  return total;
+}
+
+static bool irtkIOStatisticsSlower(const pair<string, irtkIOStatistics::Entry> &a, const pair<string, irtkIOStatistics::Entry> &b)
+{
+  return a.second.readSeconds + a.second.writeSeconds > b.second.readSeconds + b.second.writeSeconds;
+}
+
+static void PrintEntry(ostream &out, const string &name, const irtkIOStatistics::Entry &e)
+{
+  out << name << ": " << e.opens << " opens, "
+      << e.reads << " reads (" << e.readBytes / 1048576.0 << " MB, " << e.readSeconds << " s), "
+      << e.writes << " writes (" << e.writtenBytes / 1048576.0 << " MB, " << e.writeSeconds << " s)" << endl;
+}
+
+void irtkIOStatistics::Print(ostream &out, int files)
+{
+  Entry total = Total();
+
+  vector<pair<string, Entry> > sorted;
+  {
+#ifdef HAS_TBB
+    tbb::mutex::scoped_lock lock(_StatisticsMutex);
+#endif
+    sorted.assign(_Statistics.begin(), _Statistics.end());
+  }
+  sort(sorted.begin(), sorted.end(), irtkIOStatisticsSlower);
+
+  out << "File I/O of " << sorted.size() << " files" << endl;
+  PrintEntry(out, "total", total);
+  for (int i = 0; (i < files) && (i < int(sorted.size())); i++) {
+    PrintEntry(out, sorted[i].first, sorted[i].second);
+  }
+}
+
+void irtkIOStatistics::Reset()
+{
+#ifdef HAS_TBB
+  tbb::mutex::scoped_lock lock(_StatisticsMutex);
+#endif
+  _Statistics.clear();
+}
+
+double irtkIOStatistics::Time()
+{
+#ifndef WIN32
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+#else
+  return double(clock()) / CLOCKS_PER_SEC;
+#endif
+}
@@ -0,0 +1,122 @@
+/*=========================================================================
+
+  Library   : Image Registration Toolkit (IRTK)
+  Module    : $Id$
+  Copyright : Imperial College, Department of Computing
+              Visual Information Processing (VIP), 2011 onwards
+  Date      : $Date$
+  Version   : $Revision$
+  Changes   : $Author$
+
+=========================================================================*/
+
+#include <irtkCommon.h>
+
+#ifndef WIN32
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#ifdef HAS_TBB
+#include <tbb/atomic.h>
+typedef tbb::atomic<long> irtkMemoryCounter;
+#else
+typedef long irtkMemoryCounter;
+#endif
+
+// Static counters are zero initialised before any image is constructed
+static irtkMemoryCounter _MemoryCurrent[IRTK_MEMORY_TAGS];
+static irtkMemoryCounter _MemoryTotal;
+static irtkMemoryCounter _MemoryPeak;
+
+bool irtkMemoryStatistics::_enabled = false;
+
+void irtkMemoryStatistics::Enable(bool enabled)
+{
+  _enabled = enabled;
+}
+
+long irtkMemoryStatistics::Allocated(irtkMemoryTag tag, long bytes)
+{
+  if (!_enabled || (bytes == 0)) return 0;
+
+  _MemoryCurrent[tag] += bytes;
+  long total = (_MemoryTotal += bytes);
+#ifdef HAS_TBB
+  long peak = _MemoryPeak;
+  while (total > peak) {
+    long old = _MemoryPeak.compare_and_swap(total, peak);
+    if (old == peak) break;
+    peak = old;
+  }
+#else
+  if (total > _MemoryPeak) _MemoryPeak = total;
+#endif
+  return bytes;
+}
+
+void irtkMemoryStatistics::Deallocated(irtkMemoryTag tag, long bytes)
+{
+  if (bytes == 0) return;
+
+  _MemoryCurrent[tag] -= bytes;
+  _MemoryTotal -= bytes;
+}
+
+long irtkMemoryStatistics::Current(irtkMemoryTag tag)
+{
+  return _MemoryCurrent[tag];
+}
+
+long irtkMemoryStatistics::Current()
+{
+  return _MemoryTotal;
+}
+
+long irtkMemoryStatistics::Peak()
+{
+  return _MemoryPeak;
+}
+
+void irtkMemoryStatistics::ResetPeak()
+{
+  _MemoryPeak = _MemoryTotal;
+}
+
+long irtkMemoryStatistics::ResidentSetSize()
+{
+#ifdef __linux__
+  long pages = 0, resident = 0;
+  FILE *fp = fopen("/proc/self/statm", "r");
+  if (fp == NULL) return 0;
+  if (fscanf(fp, "%ld %ld", &pages, &resident) != 2) resident = 0;
+  fclose(fp);
+  return resident * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+long irtkMemoryStatistics::PeakResidentSetSize()
+{
+#ifndef WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return usage.ru_maxrss * 1024L;
+#endif
+#else
+  return 0;
+#endif
+}
+
+long irtkMemoryStatistics::PhysicalMemory()
+{
+#if !defined(WIN32) && defined(_SC_PHYS_PAGES)
+  return sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
@@ -24,3 +24,198 @@ int tbb_no_threads = task_scheduler_init::automatic;
 #else
 int tbb_no_threads = 1;
 #endif
+
+// Default: Threads are not pinned, memory placement is left to the system
+bool tbb_pin_threads = false;
+irtkNumaPolicy tbb_numa_policy = NUMA_Default;
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#  include <sched.h>
+#  include <unistd.h>
+#  include <sys/syscall.h>
+#  include <fstream>
+#endif
+
+#ifdef HAS_TBB
+#  include <tbb/task_scheduler_observer.h>
+#  include <tbb/atomic.h>
+#endif
+
+using namespace std;
+
+#ifdef __linux__
+
+/// Cores the process may run on, in the order threads are pinned to them
+static cpu_set_t irtkAllowedCores;
+
+/// Parses a kernel cpu/node list such as "0-3,8" into a bit mask
+static void irtkParseList(const string &list, unsigned long *mask, int words)
+{
+  size_t pos = 0;
+  while (pos < list.size()) {
+    size_t end = list.find(',', pos);
+    if (end == string::npos) end = list.size();
+    string range = list.substr(pos, end - pos);
+    int first, last;
+    size_t dash = range.find('-');
+    first = atoi(range.c_str());
+    last  = (dash == string::npos) ? first : atoi(range.c_str() + dash + 1);
+    for (int i = first; i <= last && i < int(words * 8 * sizeof(unsigned long)); i++) {
+      mask[i / (8 * sizeof(unsigned long))] |= 1UL << (i % (8 * sizeof(unsigned long)));
+    }
+    pos = end + 1;
+  }
+}
+
+/// Interleaves the pages of this thread and of all threads started later
+/// across the online NUMA nodes (set_mempolicy without libnuma)
+static void irtkInterleaveMemory()
+{
+  const int words = 16;
+  unsigned long mask[words];
+  memset(mask, 0, sizeof(mask));
+
+  ifstream online("/sys/devices/system/node/online");
+  string list;
+  if (!(online >> list)) return;
+  irtkParseList(list, mask, words);
+
+  int nodes = 0;
+  for (int i = 0; i < words; i++) nodes += __builtin_popcountl(mask[i]);
+  if (nodes < 2) return;
+
+  // MPOL_INTERLEAVE
+  if (syscall(SYS_set_mempolicy, 3, mask, words * 8 * sizeof(unsigned long) + 1) != 0) {
+    cerr << "irtkInitializeParallel: Failed to interleave memory across " << nodes << " NUMA nodes" << endl;
+  }
+}
+
+#endif
+
+#ifdef HAS_TBB
+
+/// Pins every thread entering the task scheduler to the next allowed core
+class irtkThreadPinning : public task_scheduler_observer
+{
+  int _next;
+
+public:
+
+  irtkThreadPinning() : _next(0) {}
+
+  void on_scheduler_entry(bool) {
+#ifdef __linux__
+    static __thread bool pinned = false;
+    if (pinned) return;
+    pinned = true;
+
+    int cores = CPU_COUNT(&irtkAllowedCores);
+    if (cores == 0) return;
+    int n = __sync_fetch_and_add(&_next, 1) % cores;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &irtkAllowedCores) && n-- == 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        sched_setaffinity(0, sizeof(set), &set);
+        break;
+      }
+    }
+#endif
+  }
+};
+
+static irtkThreadPinning *irtkPinning = NULL;
+
+/// Current task arena, only replaced by irtkInitializeParallel
+static tbb::atomic<task_arena *> irtkTaskArena;
+static int irtkTaskArenaThreads = 0;
+static tbb::mutex irtkTaskArenaMutex;
+
+/// Arenas replaced by a later irtkInitializeParallel, which are kept alive
+/// as parallel code started before may still execute in them
+static vector<task_arena *> irtkRetiredArenas;
+
+/// Creates the arena with tbb_no_threads threads (caller holds the mutex)
+static task_arena *irtkCreateArena()
+{
+  irtkTaskArenaThreads = tbb_no_threads;
+  return new task_arena((tbb_no_threads > 0) ? tbb_no_threads : int(task_arena::automatic));
+}
+
+task_arena &irtkArena()
+{
+  task_arena *arena = irtkTaskArena;
+  if (arena == NULL) {
+    // Programs which do not call irtkInitializeParallel get the default arena
+    tbb::mutex::scoped_lock lock(irtkTaskArenaMutex);
+    arena = irtkTaskArena;
+    if (arena == NULL) irtkTaskArena = arena = irtkCreateArena();
+  }
+  return *arena;
+}
+
+#endif
+
+int irtkParallelThreads()
+{
+#ifdef HAS_TBB
+  return (tbb_no_threads > 0) ? tbb_no_threads : task_scheduler_init::default_num_threads();
+#else
+  return 1;
+#endif
+}
+
+void irtkInitializeParallel(int threads, bool pin, const char *numa)
+{
+  const char *env;
+
+  if (threads <= 0 && (env = getenv("IRTK_THREADS")) != NULL) threads = atoi(env);
+  if (threads > 0) tbb_no_threads = threads;
+
+  if (!pin && (env = getenv("IRTK_PIN_THREADS")) != NULL) pin = (atoi(env) != 0);
+  tbb_pin_threads = pin;
+
+  if ((numa == NULL || numa[0] == '\0') && (env = getenv("IRTK_NUMA")) != NULL) numa = env;
+  if (numa == NULL || numa[0] == '\0' || strcmp(numa, "default") == 0) {
+    tbb_numa_policy = NUMA_Default;
+  } else if (strcmp(numa, "interleave") == 0) {
+    tbb_numa_policy = NUMA_Interleave;
+  } else if (strcmp(numa, "first-touch") == 0) {
+    tbb_numa_policy = NUMA_FirstTouch;
+  } else {
+    cerr << "irtkInitializeParallel: Unknown NUMA policy " << numa << ", use default, interleave or first-touch" << endl;
+    exit(1);
+  }
+
+#ifdef __linux__
+  // Memory policy and affinity are inherited by the worker threads, which
+  // the task arena starts only after this
+  if (tbb_numa_policy == NUMA_Interleave) irtkInterleaveMemory();
+  CPU_ZERO(&irtkAllowedCores);
+  sched_getaffinity(0, sizeof(irtkAllowedCores), &irtkAllowedCores);
+#endif
+
+#ifdef HAS_TBB
+  if (tbb_pin_threads && irtkPinning == NULL) {
+    irtkPinning = new irtkThreadPinning;
+    irtkPinning->observe(true);
+  }
+
+  // Replace the arena if the number of threads changed
+  tbb::mutex::scoped_lock lock(irtkTaskArenaMutex);
+  task_arena *arena = irtkTaskArena;
+  if (arena == NULL) {
+    irtkTaskArena = irtkCreateArena();
+  } else if (irtkTaskArenaThreads != tbb_no_threads) {
+    irtkRetiredArenas.push_back(arena);
+    irtkTaskArena = irtkCreateArena();
+  }
+#endif
+}
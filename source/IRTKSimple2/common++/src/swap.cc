@@ -12,11 +12,49 @@
 
 #include <irtkCommon.h>
 
+#ifdef __GNUC__
+
+// In-place swapping of whole words, which compilers turn into vector shuffles
+template <class T> inline void swapWords(char *a, long n, T (*bswap)(T))
+{
+  T w;
+
+  for (long i = 0; i < n; i++) {
+    memcpy(&w, a + i * sizeof(T), sizeof(T));
+    w = bswap(w);
+    memcpy(a + i * sizeof(T), &w, sizeof(T));
+  }
+}
+
+inline unsigned short bswap16(unsigned short w)
+{
+  return (unsigned short)((w << 8) | (w >> 8));
+}
+
+inline unsigned int bswap32(unsigned int w)
+{
+  return __builtin_bswap32(w);
+}
+
+inline unsigned long long bswap64(unsigned long long w)
+{
+  return __builtin_bswap64(w);
+}
+
+#endif
+
 void swap16(char *a, char *b, long n)
 {
-  int i;
+  long i;
   char c;
 
+#ifdef __GNUC__
+  if (a == b) {
+    swapWords<unsigned short>(a, n, bswap16);
+    return;
+  }
+#endif
+
   for (i = 0; i < n * 2; i += 2) {
     c = a[i];
     a[i] = b[i+1];
@@ -26,9 +64,16 @@ void swap16(char *a, char *b, long n)
 
 void swap32(char *a, char *b, long n)
 {
-  int i;
+  long i;
   char c;
 
+#ifdef __GNUC__
+  if (a == b) {
+    swapWords<unsigned int>(a, n, bswap32);
+    return;
+  }
+#endif
+
   for (i = 0; i < n * 4; i += 4) {
     c = a[i];
     a[i] = b[i+3];
@@ -41,9 +86,16 @@ void swap32(char *a, char *b, long n)
 
 void swap64(char *a, char *b, long n)
 {
-  int i;
+  long i;
   char c;
 
+#ifdef __GNUC__
+  if (a == b) {
+    swapWords<unsigned long long>(a, n, bswap64);
+    return;
+  }
+#endif
+
   for (i = 0; i < n * 8; i += 8) {
     c = a[i];
     a[i] = b[i+7];
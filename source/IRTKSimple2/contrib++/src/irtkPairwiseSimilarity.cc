@@ -446,7 +446,6 @@ void irtkPairwiseSimilarity::GetSimilarities()
 		cout << i << ": ";
 #ifdef HAS_TBB
 //			cout << "Nr of Regions: " << _nrRegions << endl;
-		task_scheduler_init init;
 		MultiThreadedSimilarity evaluate(_useMasks , _images, _regions,i, _results, _nrRegions,_similarityType, _twoSets, _nrRows,_singleRegionMask,_padding);
 		int blocks = -1;
 		if(i==0)
@@ -462,10 +461,10 @@ void irtkPairwiseSimilarity::GetSimilarities()
 			else
 			blocks = 24;
 
-			parallel_for(blocked_range<int>(_nrRows, _nrRows+_nrCols, int(blocks)), evaluate);
+			irtkParallelFor(blocked_range<int>(_nrRows, _nrRows+_nrCols, int(blocks)), evaluate);
 		}
 		else
-		parallel_for(blocked_range<int>(1, _nrRows, int(blocks)), evaluate);
+		irtkParallelFor(blocked_range<int>(1, _nrRows, int(blocks)), evaluate);
 #else
 		for (int j = 0; j < _nrRows + _nrCols; j++) {
 			if (j > i || _twoSets) {
@@ -42,6 +42,9 @@ protected:
    */
   virtual double Run(int, int, int, int);
 
+  /// Run the convolution filter on a whole row of voxels
+  virtual void RunRow(int, int, int, VoxelType *);
+
 public:
 
   /// Constructor
@@ -62,6 +62,9 @@ protected:
   /// Debug flag
   int _debug;
 
+  /// Flag whether uncompressed image data is memory mapped if possible
+  static int _MemoryMapping;
+
   /** Read header. This is an abstract function. Each derived class has to
    *  implement this function in order to initialize image dimensions, voxel
    *  dimensions, voxel type and a lookup table which the address for each
@@ -69,6 +72,13 @@ protected:
    */
   virtual void ReadHeader() = 0;
 
+  /// Reads region of image data of type FileType, converting it into the image on the fly
+  template <class FileType, class VoxelType> void ReadConverted(irtkGenericImage<VoxelType> &, void (irtkCifstream::*)(FileType *, long, long),
+                                                                int, int, int, int, int, int, int, int);
+
+  /// Reads region into the image (allocated by the caller) for the voxel type of the file
+  template <class VoxelType> void ReadRegion(irtkGenericImage<VoxelType> &, int, int, int, int, int, int, int, int);
+
 public:
 
   /// Contructor
@@ -90,6 +100,27 @@ public:
   /// Get output
   virtual irtkImage *GetOutput();
 
+  /** Get output as image of the given voxel type. The image data is decoded
+   *  straight into the image in blocks of slices, applying type conversion,
+   *  intensity scaling (slope/intercept) and reflections in a single pass,
+   *  without allocating an image of the file voxel type. */
+  template <class VoxelType> void GetOutputAs(irtkGenericImage<VoxelType> &);
+
+  /** Get region [i1,i2) x [j1,j2) x [k1,k2) x [l1,l2) of the image as image of
+   *  the given voxel type, like irtkGenericImage::GetRegion but without
+   *  reading the whole image. Only the rows j1 to j2 of the slices k1 to k2
+   *  are read and decoded; with an uncompressed or indexed gzip file the
+   *  data outside this range is skipped without being decompressed. */
+  template <class VoxelType> void GetRegionAs(irtkGenericImage<VoxelType> &, int, int, int, int, int, int, int, int);
+
+  /// Get region [i1,i2) x [j1,j2) x [k1,k2) of all frames of the image
+  template <class VoxelType> void GetRegionAs(irtkGenericImage<VoxelType> &, int, int, int, int, int, int);
+
+  /** Returns whether regions can be read without decompressing the data
+   *  in front of them (uncompressed or indexed gzip file), i.e. whether
+   *  several readers can read disjoint regions of the file efficiently. */
+  int IsRandomAccess();
+
   /// Get debug flag
   virtual int  GetDebugFlag();
 
@@ -108,6 +139,15 @@ public:
   /// Print  debugging info
   virtual void Debug(char *);
 
+  /** Sets whether GetOutput() memory maps the image data of uncompressed
+   *  files if no byte swapping, type conversion or reflection is needed.
+   *  The mapping is copy on write, but the file must not be truncated or
+   *  overwritten while it is mapped. */
+  static void SetMemoryMapping(int);
+
+  /// Returns whether image data is memory mapped if possible
+  static int  GetMemoryMapping();
+
   // Returns the name of the class
   virtual const char *NameOfClass() = 0;
 
@@ -115,6 +155,21 @@ public:
   virtual int GetDataType();
 };
 
+inline void irtkFileToImage::SetMemoryMapping(int mapping)
+{
+  _MemoryMapping = mapping;
+}
+
+inline int irtkFileToImage::GetMemoryMapping()
+{
+  return _MemoryMapping;
+}
+
+inline int irtkFileToImage::IsRandomAccess()
+{
+  return (this->IsCompressed() == false) || this->IsIndexed();
+}
+
 #include <irtkFilePGMToImage.h>
 #include <irtkFileVTKToImage.h>
 #include <irtkFileGIPLToImage.h>
@@ -42,6 +42,21 @@ protected:
   /// Pointer to image data
   VoxelType ****_matrix;
 
+  /// Memory mapped file region holding the image data (NULL if allocated)
+  void *_mappedRegion;
+
+  /// Size of memory mapped file region
+  size_t _mappedSize;
+
+  /// Whether the image data is a view of memory owned by someone else
+  bool _external;
+
+  /// Bytes of the image data counted by irtkMemoryStatistics
+  long _countedSize;
+
+  /// Deallocates image data, unmapping it if it is memory mapped
+  VoxelType ****DeallocateMatrix(VoxelType ****);
+
 public:
 
   /// Default constructor
@@ -68,12 +83,32 @@ public:
   /// Initialize an image
   void Initialize(const irtkImageAttributes &);
 
+  /// Initialize an image, setting voxels to zero only if the flag is true
+  void Initialize(const irtkImageAttributes &, bool);
+
   /// Clear an image
   void Clear();
 
   /// Read image from file
   void Read (const char *);
 
+  /** Maps image data of an uncompressed file in native byte order starting
+   *  at the given offset (copy on write: changes are private to the image
+   *  and never written back). Returns false if the file can't be mapped. */
+  bool Map(const char *, long, const irtkImageAttributes &);
+
+  /// Returns whether image data is memory mapped
+  bool IsMapped() const;
+
+  /** Makes the image a view of external voxel memory, e.g. a block holding
+   *  the data of many images. The memory is neither initialized nor freed
+   *  by the image and must outlive it. Initializing the image with another
+   *  size allocates its own memory again. */
+  void View(const irtkImageAttributes &, VoxelType *);
+
+  /// Returns whether image data is a view of external memory
+  bool IsView() const;
+
   /// Write image to file
   void Write(const char *);
 
@@ -389,6 +424,16 @@ template <class VoxelType> inline int irtkGenericImage<VoxelType>::VoxelToIndex(
 #endif
 }
 
+template <class VoxelType> inline bool irtkGenericImage<VoxelType>::IsMapped() const
+{
+  return (_mappedRegion != NULL);
+}
+
+template <class VoxelType> inline bool irtkGenericImage<VoxelType>::IsView() const
+{
+  return _external;
+}
+
 template <class VoxelType> inline VoxelType *irtkGenericImage<VoxelType>::GetPointerToVoxels(int x, int y, int z, int t) const
 {
 #ifdef NO_BOUNDS
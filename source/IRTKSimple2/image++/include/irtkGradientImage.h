@@ -40,6 +40,9 @@ protected:
   /// Runs the filter on a single voxel.
   virtual double Run(int, int, int, int);
 
+  /// Runs the filter on a whole row of voxels.
+  virtual void RunRow(int, int, int, VoxelType *);
+
 public:
   /// Constructor
   irtkGradientImage();
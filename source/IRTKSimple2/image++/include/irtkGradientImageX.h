@@ -37,6 +37,12 @@ protected:
   // Calculate the gradient on a single voxel.
   virtual double Run(int, int, int, int);
 
+  // Calculate the gradient on a whole row of voxels.
+  virtual void RunRow(int, int, int, VoxelType *);
+
+  /// Initialize the filter
+  virtual void Initialize();
+
 public:
 
   /// Run the convolution filter
@@ -59,6 +59,12 @@ public:
   /// Returns the name of the class
   virtual const char *NameOfClass() = 0;
 
+  /// Set default value returned outside of the image domain
+  SetMacro(DefaultValue, double);
+
+  /// Get default value returned outside of the image domain
+  GetMacro(DefaultValue, double);
+
   /// Set debugging flag
   SetMacro(DebugFlag, bool);
 
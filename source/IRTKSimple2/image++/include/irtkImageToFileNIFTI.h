@@ -42,6 +42,9 @@ protected:
   /// Finalize filter (empty, overrides parent method).
   virtual void Finalize();
 
+  /// Write header and data as block compressed gzip stream (see irtkCofstream)
+  virtual void WriteBlockCompressed();
+
 public:
 
   /// Constructor
@@ -81,6 +81,21 @@ public:
   /// Run filter on single voxel
   virtual double Run(int, int, int, int = 0);
 
+protected:
+
+  /** Run filter on a single row of voxels. The row is given by its y, z and
+   *  t index and the filter response is written to the typed output row.
+   *  The default implementation calls Run(int, int, int, int) for each voxel
+   *  of the row, so that filters which only implement the per-voxel member
+   *  function continue to work. Derived filters should override this member
+   *  function and process the whole row with direct pointer access.
+   */
+  virtual void RunRow(int, int, int, VoxelType *);
+
+public:
+
+  /// Converts a filter response to the voxel type as done by PutAsDouble
+  static VoxelType ToVoxelType(double);
 
   /** Returns whether the filter requires buffering. Any derived class must
    *  implement this member function to indicate whether the filter should
@@ -103,4 +118,11 @@ public:
   virtual void Debug(const char *);
 };
 
+template <class VoxelType> inline VoxelType irtkImageToImage<VoxelType>::ToVoxelType(double val)
+{
+  if (val > voxel_limits<VoxelType>::max()) val = voxel_limits<VoxelType>::max();
+  if (val < voxel_limits<VoxelType>::min()) val = voxel_limits<VoxelType>::min();
+  return static_cast<VoxelType>(val);
+}
+
 #endif
@@ -61,6 +61,18 @@ public:
    *  above, but is only defined inside the image domain. */
   virtual double EvaluateInside(double, double, double, double = 0);
 
+  /** Evaluate the filter at n image locations (in pixels) given as arrays of
+   *  coordinates. Inside the field of view (-0.5 to size-0.5 along each
+   *  axis) the result is identical to Evaluate(), locations outside it are
+   *  set to the default value. The scalar type is resolved once per call and
+   *  the locations are processed in blocks with branch-free weights. */
+  void EvaluateBatch(int, const double *, const double *, const double *, double *, double = 0);
+
+  /** Evaluate the filter at n equally spaced image locations starting at
+   *  (x, y, z) with step (dx, dy, dz), e.g. a row of a target image mapped
+   *  through an affine transformation. Same conventions as EvaluateBatch(). */
+  void EvaluateRow(int, double, double, double, double, double, double, double *, double = 0);
+
 };
 
 #endif
@@ -33,6 +33,9 @@ protected:
   /// Initialize the filter
   virtual void Initialize();
 
+  /// Run the median filter on a whole row of voxels
+  virtual void RunRow(int, int, int, VoxelType *);
+
   /// What connectivity to assume when running the filter.
   int _kernelRadius;
 
@@ -40,6 +40,10 @@ protected:
   /// Returns the name of the class
   virtual const char *NameOfClass();
 
+  /// Seed of the random numbers of a voxel, different for each voxel and
+  /// reproducible for a given initialization
+  unsigned int Seed(int, int, int, int);
+
 public:
 
   /// Constructor
@@ -54,6 +58,12 @@ public:
   /// Get amplitude
   GetMacro(Amplitude, double);
 
+  /// Set initialization of the random numbers (default: time of construction)
+  SetMacro(Init, long int);
+
+  /// Get initialization of the random numbers
+  GetMacro(Init, long int);
+
 };
 
 #include <irtkUniformNoise.h>
@@ -72,6 +72,12 @@ protected:
   */
   virtual double Run(int, int, int, int);
 
+  /// Run the filter on a whole row of voxels with thread-local buffers
+  virtual void RunRow(int, int, int, VoxelType *);
+
+  /// Computes the filter response of a single voxel using the given buffers
+  double RunVoxel(int, int, int, int, float *, float *);
+
   /// Returns whether the filter requires buffering
   virtual bool RequiresBuffering();
 
@@ -18,12 +18,6 @@
 
 #include <irtkImageFunction.h>
 
-#ifdef HAS_TBB
-
-template <class VoxelType> class irtkMultiThreadedResampling;
-
-#endif
-
 /**
  * Class for resampling of images
  *
@@ -36,12 +30,6 @@ template <class VoxelType> class irtkMultiThreadedResampling;
 template <class VoxelType> class irtkResampling : public irtkImageToImage<VoxelType>
 {
 
-#ifdef HAS_TBB
-
-  friend class irtkMultiThreadedResampling<VoxelType>;
-
-#endif
-
 protected:
 
   /// Voxel size of output after resampling
@@ -52,6 +40,20 @@ protected:
   /// Interpolation used to interpolate output
   irtkImageFunction *_Interpolator;
 
+  /** Affine map from output to input voxel coordinates. Column 3 holds the
+   *  input coordinates of output voxel (0, 0, 0) and columns 0 to 2 hold the
+   *  increments for a step along the x-, y- and z-axis of the output. */
+  double _IndexMap[3][4];
+
+  /// Whether the index map only scales and translates along each axis
+  bool _AxisAligned;
+
+  /// Computes the index map from the input and output image attributes
+  virtual void InitializeIndexMap();
+
+  /// Resamples one frame separably along each axis using linear interpolation
+  virtual void RunSeparableLinear(int);
+
   /// Returns whether the filter requires buffering
   virtual bool RequiresBuffering();
 
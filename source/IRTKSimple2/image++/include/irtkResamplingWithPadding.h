@@ -14,12 +14,6 @@
 
 #define _IRTKRESAMPLINGWITHPADDING_H
 
-#ifdef HAS_TBB
-
-template <class VoxelType> class irtkMultiThreadedResamplingWithPadding;
-
-#endif
-
 /**
  * Class for resampling of padded images
  *
@@ -35,12 +29,6 @@ template <class VoxelType> class irtkMultiThreadedResamplingWithPadding;
 template <class VoxelType> class irtkResamplingWithPadding : public irtkResampling<VoxelType>
 {
 
-#ifdef HAS_TBB
-
-  friend class irtkMultiThreadedResamplingWithPadding<VoxelType>;
-
-#endif
-
 protected:
 
   /// Padding value
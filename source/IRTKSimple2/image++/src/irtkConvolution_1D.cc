@@ -117,6 +117,64 @@ template <class VoxelType> double irtkConvolution_1D<VoxelType>::Run(int x, int
   }
 }
 
+template <class VoxelType> void irtkConvolution_1D<VoxelType>::RunRow(int y, int z, int t, VoxelType *out)
+{
+  int i, x, x1, x2, n, r;
+  irtkRealPixel *kernel, *ptr2;
+  VoxelType *in, *ptr;
+  irtkRealPixel val, sum, ksum;
+
+  // Initialize
+  n      = this->_input->GetX();
+  r      = this->_input2->GetX()/2;
+  in     = this->_input->GetPointerToVoxels(0, y, z, t);
+  kernel = this->_input2->GetPointerToVoxels();
+
+  // Sum of filter elements, identical for all voxels away from the boundary
+  ksum = 0;
+  for (i = 0; i <= 2*r; i++) ksum += kernel[i];
+
+  for (x = 0; x < n; x++) {
+    val = 0;
+    sum = 0;
+    x1  = x - r;
+    x2  = x + r;
+
+    // Check whether boundary checking is necessary
+    if ((x1 > 0) && (x2 < n)) {
+
+      // If no, do fast convolution
+      ptr  = in + x1;
+      ptr2 = kernel;
+      for (i = x1; i <= x2; i++) {
+        val += *ptr2 * *ptr;
+        ptr++;
+        ptr2++;
+      }
+      sum = ksum;
+
+    } else {
+
+      // If yes, do slow convolution which handles boundaries
+      ptr2 = kernel;
+      for (i = x1; i <= x2; i++) {
+        if ((i >= 0) && (i < n)) {
+          val += *ptr2 * in[i];
+          sum += *ptr2;
+        }
+        ptr2++;
+      }
+    }
+
+    // Normalize filter value by sum of filter elements
+    if (this->_Normalization == true) {
+      out[x] = this->ToVoxelType((sum > 0) ? val / sum : 0);
+    } else {
+      out[x] = this->ToVoxelType(val);
+    }
+  }
+}
+
 template <class VoxelType> void irtkConvolution_1D<VoxelType>::Initialize()
 {
   // Check kernel
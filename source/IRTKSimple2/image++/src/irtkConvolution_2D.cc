@@ -119,6 +119,72 @@ template <class VoxelType> double irtkConvolution_2D<VoxelType>::Run(int x, int
   }
 }
 
+template <class VoxelType> void irtkConvolution_2D<VoxelType>::RunRow(int y, int z, int t, VoxelType *out)
+{
+  int i, j, x, x1, x2, y1, y2, nx, ny, rx, ry;
+  irtkRealPixel *kernel, *ptr2;
+  VoxelType *in, *ptr;
+  irtkRealPixel val, sum, ksum;
+
+  // Initialize
+  nx     = this->_input->GetX();
+  ny     = this->_input->GetY();
+  rx     = this->_input2->GetX()/2;
+  ry     = this->_input2->GetY()/2;
+  in     = this->_input->GetPointerToVoxels(0, 0, z, t);
+  kernel = this->_input2->GetPointerToVoxels();
+  y1     = y - ry;
+  y2     = y + ry;
+
+  // Sum of filter elements, identical for all voxels away from the boundary
+  ksum = 0;
+  for (i = 0; i < (2*rx+1)*(2*ry+1); i++) ksum += kernel[i];
+
+  for (x = 0; x < nx; x++) {
+    val = 0;
+    sum = 0;
+    x1  = x - rx;
+    x2  = x + rx;
+
+    // Check whether boundary checking is necessary
+    if ((x1 > 0) && (x2 < nx) && (y1 > 0) && (y2 < ny)) {
+
+      // If no, do fast convolution
+      ptr2 = kernel;
+      for (j = y1; j <= y2; j++) {
+        ptr = in + j*nx + x1;
+        for (i = x1; i <= x2; i++) {
+          val += *ptr2 * *ptr;
+          ptr++;
+          ptr2++;
+        }
+      }
+      sum = ksum;
+
+    } else {
+
+      // If yes, do slow convolution which handles boundaries
+      ptr2 = kernel;
+      for (j = y1; j <= y2; j++) {
+        for (i = x1; i <= x2; i++) {
+          if ((i >= 0) && (i < nx) && (j >= 0) && (j < ny)) {
+            val += *ptr2 * in[j*nx + i];
+            sum += *ptr2;
+          }
+          ptr2++;
+        }
+      }
+    }
+
+    // Normalize filter value by sum of filter elements
+    if (this->_Normalization == true) {
+      out[x] = this->ToVoxelType((sum > 0) ? val / sum : 0);
+    } else {
+      out[x] = this->ToVoxelType(val);
+    }
+  }
+}
+
 template <class VoxelType> void irtkConvolution_2D<VoxelType>::Initialize()
 {
   // Check kernel
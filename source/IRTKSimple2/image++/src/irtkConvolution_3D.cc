@@ -135,6 +135,80 @@ template <class VoxelType> double irtkConvolution_3D<VoxelType>::Run(int x, int
   }
 }
 
+template <class VoxelType> void irtkConvolution_3D<VoxelType>::RunRow(int y, int z, int t, VoxelType *out)
+{
+  int i, j, k, x, x1, x2, y1, y2, z1, z2, nx, ny, nz, rx, ry, rz;
+  irtkRealPixel *kernel, *ptr2;
+  VoxelType *in, *ptr;
+  irtkRealPixel val, sum, ksum;
+
+  // Initialize
+  nx     = this->_input->GetX();
+  ny     = this->_input->GetY();
+  nz     = this->_input->GetZ();
+  rx     = this->_input2->GetX()/2;
+  ry     = this->_input2->GetY()/2;
+  rz     = this->_input2->GetZ()/2;
+  in     = this->_input->GetPointerToVoxels(0, 0, 0, t);
+  kernel = this->_input2->GetPointerToVoxels();
+  y1     = y - ry;
+  y2     = y + ry;
+  z1     = z - rz;
+  z2     = z + rz;
+
+  // Sum of filter elements, identical for all voxels away from the boundary
+  ksum = 0;
+  for (i = 0; i < (2*rx+1)*(2*ry+1)*(2*rz+1); i++) ksum += kernel[i];
+
+  for (x = 0; x < nx; x++) {
+    val = 0;
+    sum = 0;
+    x1  = x - rx;
+    x2  = x + rx;
+
+    // Check whether boundary checking is necessary
+    if ((x1 > 0) && (x2 < nx) && (y1 > 0) && (y2 < ny) && (z1 > 0) && (z2 < nz)) {
+
+      // If no, do fast convolution
+      ptr2 = kernel;
+      for (k = z1; k <= z2; k++) {
+        for (j = y1; j <= y2; j++) {
+          ptr = in + (k*ny + j)*nx + x1;
+          for (i = x1; i <= x2; i++) {
+            val += *ptr2 * *ptr;
+            ptr++;
+            ptr2++;
+          }
+        }
+      }
+      sum = ksum;
+
+    } else {
+
+      // If yes, do slow convolution which handles boundaries
+      ptr2 = kernel;
+      for (k = z1; k <= z2; k++) {
+        for (j = y1; j <= y2; j++) {
+          for (i = x1; i <= x2; i++) {
+            if ((i >= 0) && (i < nx) && (j >= 0) && (j < ny) && (k >= 0) && (k < nz)) {
+              val += *ptr2 * in[(k*ny + j)*nx + i];
+              sum += *ptr2;
+            }
+            ptr2++;
+          }
+        }
+      }
+    }
+
+    // Normalize filter value by sum of filter elements
+    if (this->_Normalization == true) {
+      out[x] = this->ToVoxelType((sum > 0) ? val / sum : 0);
+    } else {
+      out[x] = this->ToVoxelType(val);
+    }
+  }
+}
+
 template <class VoxelType> void irtkConvolution_3D<VoxelType>::Initialize()
 {
   // Check kernel
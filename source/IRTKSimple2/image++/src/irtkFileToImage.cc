@@ -14,6 +14,20 @@
 
 #include <irtkFileToImage.h>
 
+// Default: Always read image data into memory
+int irtkFileToImage::_MemoryMapping = false;
+
+template <class VoxelType> static irtkImage *irtkMapImage(const char *filename, long offset, const irtkImageAttributes &attr)
+{
+  irtkGenericImage<VoxelType> *image = new irtkGenericImage<VoxelType>;
+
+  if (image->Map(filename, offset, attr) == false) {
+    delete image;
+    return NULL;
+  }
+  return image;
+}
+
 irtkFileToImage::irtkFileToImage()
 {
   _type  = IRTK_VOXEL_UNKNOWN;
@@ -38,8 +52,10 @@ irtkFileToImage::~irtkFileToImage()
   _reflectZ = false;
   _debug = true;
   _start = 0;
-  if (_imagename != NULL) 
+  if (_imagename != NULL) {
+      free((char *)_imagename);
       _imagename = NULL;
+  }
 }
 
 irtkFileToImage *irtkFileToImage::New(const char *imagename)
@@ -126,7 +142,8 @@ void irtkFileToImage::SetInput(const char *imagename)
   this->Close();
 
   // Copy new file name
-  _imagename = imagename;
+  if (_imagename != NULL) free((char *)_imagename);
+  _imagename = strdup(imagename);
 
   // Open new file for reading
   this->Open(_imagename);
@@ -139,6 +156,26 @@ irtkImage *irtkFileToImage::GetOutput()
 {
   irtkImage *output = NULL;
 
+  // Note: Indexed blocked gzip files (see irtkCofstream::SetCompressionIndex)
+  // are detected by irtkCifstream::Open and inflated in parallel by the
+  // ReadAs* functions below
+
+  // Map image data if it can be used as is
+  if ((_MemoryMapping == true) && (_reflectX == false) && (_reflectY == false) && (_reflectZ == false) &&
+      ((_bytes == 1) || (_swapped == false)) && (this->IsCompressed() == false)) {
+    switch (_type) {
+    case IRTK_VOXEL_CHAR:           output = irtkMapImage<char>(_imagename, _start, _attr); break;
+    case IRTK_VOXEL_UNSIGNED_CHAR:  output = irtkMapImage<unsigned char>(_imagename, _start, _attr); break;
+    case IRTK_VOXEL_SHORT:          output = irtkMapImage<short>(_imagename, _start, _attr); break;
+    case IRTK_VOXEL_UNSIGNED_SHORT: output = irtkMapImage<unsigned short>(_imagename, _start, _attr); break;
+    case IRTK_VOXEL_INT:            output = irtkMapImage<int>(_imagename, _start, _attr); break;
+    case IRTK_VOXEL_UNSIGNED_INT:   output = irtkMapImage<unsigned int>(_imagename, _start, _attr); break;
+    case IRTK_VOXEL_FLOAT:          output = irtkMapImage<float>(_imagename, _start, _attr); break;
+    case IRTK_VOXEL_DOUBLE:         output = irtkMapImage<double>(_imagename, _start, _attr); break;
+    }
+    if (output != NULL) return output;
+  }
+
   // Bring image to correct size
   switch (_type) {
   case IRTK_VOXEL_CHAR: {
@@ -239,6 +276,194 @@ irtkImage *irtkFileToImage::GetOutput()
   return output;
 }
 
+/// Size of the blocks of slices which are read and converted at once
+#define IRTK_CONVERT_BLOCK_SIZE (4*1024*1024)
+
+template <class FileType, class VoxelType> void irtkFileToImage::ReadConverted(irtkGenericImage<VoxelType> &image, void (irtkCifstream::*read)(FileType *, long, long),
+                                                                               int i1, int j1, int k1, int l1, int i2, int j2, int k2, int l2)
+{
+  int i, x, y, z, l, r, rows, fx1, fy1, fz1, fz2, block, nx;
+  VoxelType *out;
+  const FileType *in;
+
+  const int X = _attr._x, Y = _attr._y, Z = _attr._z;
+  const double slope = _slope, intercept = _intercept;
+  const bool real  = (image.GetScalarType() == IRTK_VOXEL_FLOAT) || (image.GetScalarType() == IRTK_VOXEL_DOUBLE);
+  const bool scale = real && (slope != 0) && ((slope != 1) || (intercept != 0));
+
+  // Region in file coordinates (before reflection)
+  fx1 = (_reflectX == true) ? X - i2 : i1;
+  fy1 = (_reflectY == true) ? Y - j2 : j1;
+  fz1 = (_reflectZ == true) ? Z - k2 : k1;
+  fz2 = (_reflectZ == true) ? Z - k1 : k2;
+  nx   = i2 - i1;
+  rows = j2 - j1;
+
+  // Read whole rows; blocks of several slices if they are contiguous in the file
+  block = (rows == Y) ? max(1L, IRTK_CONVERT_BLOCK_SIZE / (long(X) * Y * long(sizeof(FileType)))) : 1;
+  block = min(block, fz2 - fz1);
+  vector<FileType> buffer(long(block) * rows * X);
+
+  for (l = l1; l < l2; l++) {
+    for (z = fz1; z < fz2; z += block) {
+      int z2 = min(z + block, fz2);
+      long offset = _start + ((long(l) * Z + z) * Y + fy1) * long(X) * long(sizeof(FileType));
+      (this->*read)(&buffer[0], long(z2 - z) * rows * X, offset);
+
+      for (i = z; i < z2; i++) {
+        for (r = 0; r < rows; r++) {
+          in  = &buffer[0] + ((long(i - z) * rows + r) * X + fx1);
+          y   = (_reflectY == true) ? Y - 1 - (fy1 + r) : fy1 + r;
+          out = image.GetPointerToVoxels(0, y - j1, ((_reflectZ == true) ? Z - 1 - i : i) - k1, l - l1);
+          if (_reflectX == true) {
+            out += nx - 1;
+            if (scale) {
+              for (x = 0; x < nx; x++) out[-x] = static_cast<VoxelType>(slope * in[x] + intercept);
+            } else {
+              for (x = 0; x < nx; x++) out[-x] = static_cast<VoxelType>(in[x]);
+            }
+          } else {
+            if (scale) {
+              for (x = 0; x < nx; x++) out[x] = static_cast<VoxelType>(slope * in[x] + intercept);
+            } else {
+              for (x = 0; x < nx; x++) out[x] = static_cast<VoxelType>(in[x]);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+template <class VoxelType> void irtkFileToImage::ReadRegion(irtkGenericImage<VoxelType> &image, int i1, int j1, int k1, int l1, int i2, int j2, int k2, int l2)
+{
+  // Slope and intercept are only applied to floating point images (as in irtkGenericImage::Read)
+  if ((_slope != 0) && ((_slope != 1) || (_intercept != 0)) &&
+      (image.GetScalarType() != IRTK_VOXEL_FLOAT) && (image.GetScalarType() != IRTK_VOXEL_DOUBLE)) {
+    cerr << image.NameOfClass() << "::Read: Ignore slope and intercept, use irtkGenericImage<float> or " << endl;
+    cerr << "irtkGenericImage<double> instead" << endl;
+  }
+
+  switch (_type) {
+  case IRTK_VOXEL_CHAR:
+    this->ReadConverted<char>(image, &irtkCifstream::ReadAsChar, i1, j1, k1, l1, i2, j2, k2, l2);
+    break;
+  case IRTK_VOXEL_UNSIGNED_CHAR:
+    this->ReadConverted<unsigned char>(image, &irtkCifstream::ReadAsUChar, i1, j1, k1, l1, i2, j2, k2, l2);
+    break;
+  case IRTK_VOXEL_SHORT:
+    this->ReadConverted<short>(image, &irtkCifstream::ReadAsShort, i1, j1, k1, l1, i2, j2, k2, l2);
+    break;
+  case IRTK_VOXEL_UNSIGNED_SHORT:
+    this->ReadConverted<unsigned short>(image, &irtkCifstream::ReadAsUShort, i1, j1, k1, l1, i2, j2, k2, l2);
+    break;
+  case IRTK_VOXEL_INT:
+    this->ReadConverted<int>(image, &irtkCifstream::ReadAsInt, i1, j1, k1, l1, i2, j2, k2, l2);
+    break;
+  case IRTK_VOXEL_UNSIGNED_INT:
+    this->ReadConverted<unsigned int>(image, &irtkCifstream::ReadAsUInt, i1, j1, k1, l1, i2, j2, k2, l2);
+    break;
+  case IRTK_VOXEL_FLOAT:
+    this->ReadConverted<float>(image, &irtkCifstream::ReadAsFloat, i1, j1, k1, l1, i2, j2, k2, l2);
+    break;
+  case IRTK_VOXEL_DOUBLE:
+    this->ReadConverted<double>(image, &irtkCifstream::ReadAsDouble, i1, j1, k1, l1, i2, j2, k2, l2);
+    break;
+  default:
+    cout << "irtkFileToImage::ReadRegion: Unknown voxel type" << endl;
+  }
+}
+
+template <class VoxelType> void irtkFileToImage::GetOutputAs(irtkGenericImage<VoxelType> &image)
+{
+  // Don't decode into a memory mapped file
+  if (image.IsMapped()) image.Clear();
+
+  // Allocate image without initializing voxels
+  image.Initialize(_attr, false);
+  if (image.GetNumberOfVoxels() == 0) return;
+
+  this->ReadRegion(image, 0, 0, 0, 0, _attr._x, _attr._y, _attr._z, _attr._t);
+}
+
+template <class VoxelType> void irtkFileToImage::GetRegionAs(irtkGenericImage<VoxelType> &image, int i1, int j1, int k1, int l1, int i2, int j2, int k2, int l2)
+{
+  double x1, y1, z1, x2, y2, z2;
+
+  if ((i1 < 0) || (i1 >= i2) ||
+      (j1 < 0) || (j1 >= j2) ||
+      (k1 < 0) || (k1 >= k2) ||
+      (l1 < 0) || (l1 >= l2) ||
+      (i2 > _attr._x) || (j2 > _attr._y) || (k2 > _attr._z) || (l2 > _attr._t)) {
+      stringstream msg;
+      msg << "irtkFileToImage::GetRegionAs: Parameter out of range\n";
+      cerr << msg.str();
+      throw irtkException( msg.str(),
+                           __FILE__,
+                           __LINE__ );
+  }
+
+  // Calculate position of first voxel in roi in original image
+  irtkMatrix i2w = irtkBaseImage::GetImageToWorldMatrix(_attr);
+  x1 = i2w(0, 0) * i1 + i2w(0, 1) * j1 + i2w(0, 2) * k1 + i2w(0, 3);
+  y1 = i2w(1, 0) * i1 + i2w(1, 1) * j1 + i2w(1, 2) * k1 + i2w(1, 3);
+  z1 = i2w(2, 0) * i1 + i2w(2, 1) * j1 + i2w(2, 2) * k1 + i2w(2, 3);
+
+  // Initialize
+  irtkImageAttributes attr = _attr;
+  attr._x = i2 - i1;
+  attr._y = j2 - j1;
+  attr._z = k2 - k1;
+  attr._t = l2 - l1;
+  attr._xorigin = 0;
+  attr._yorigin = 0;
+  attr._zorigin = 0;
+  if (image.IsMapped()) image.Clear();
+  image.Initialize(attr, false);
+
+  // Calculate position of first voxel in roi in new image
+  x2 = 0;
+  y2 = 0;
+  z2 = 0;
+  image.ImageToWorld(x2, y2, z2);
+
+  // Shift origin of new image accordingly
+  image.PutOrigin(x1 - x2, y1 - y2, z1 - z2);
+
+  this->ReadRegion(image, i1, j1, k1, l1, i2, j2, k2, l2);
+}
+
+template <class VoxelType> void irtkFileToImage::GetRegionAs(irtkGenericImage<VoxelType> &image, int i1, int j1, int k1, int i2, int j2, int k2)
+{
+  this->GetRegionAs(image, i1, j1, k1, 0, i2, j2, k2, _attr._t);
+}
+
+template void irtkFileToImage::GetOutputAs(irtkGenericImage<char> &);
+template void irtkFileToImage::GetOutputAs(irtkGenericImage<unsigned char> &);
+template void irtkFileToImage::GetOutputAs(irtkGenericImage<short> &);
+template void irtkFileToImage::GetOutputAs(irtkGenericImage<unsigned short> &);
+template void irtkFileToImage::GetOutputAs(irtkGenericImage<int> &);
+template void irtkFileToImage::GetOutputAs(irtkGenericImage<unsigned int> &);
+template void irtkFileToImage::GetOutputAs(irtkGenericImage<float> &);
+template void irtkFileToImage::GetOutputAs(irtkGenericImage<double> &);
+
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<char> &, int, int, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<unsigned char> &, int, int, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<short> &, int, int, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<unsigned short> &, int, int, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<int> &, int, int, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<unsigned int> &, int, int, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<float> &, int, int, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<double> &, int, int, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<char> &, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<unsigned char> &, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<short> &, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<unsigned short> &, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<int> &, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<unsigned int> &, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<float> &, int, int, int, int, int, int);
+template void irtkFileToImage::GetRegionAs(irtkGenericImage<double> &, int, int, int, int, int, int);
+
 double irtkFileToImage::GetSlope()
 {
 	return this->_slope;
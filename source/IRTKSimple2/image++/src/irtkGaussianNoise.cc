@@ -66,11 +66,11 @@ template <class VoxelType> const char *irtkGaussianNoise<VoxelType>::NameOfClass
 
 template <class VoxelType> double irtkGaussianNoise<VoxelType>::Run(int x, int y, int z, int t)
 {
-  boost::mt19937 rng;
-  rng.seed(this->_Init);
+  // Seeded per voxel, the filter may run the voxels in any order and in parallel
+  boost::minstd_rand rng(this->Seed(x, y, z, t));
 
   boost::normal_distribution<> nd(0, 1);
-  boost::variate_generator<boost::mt19937&,
+  boost::variate_generator<boost::minstd_rand&,
                            boost::normal_distribution<> > var_nor(rng, nd);
 
   double tmp = this->_input->Get(x, y, z, t) + this->_Sigma * var_nor() + this->_Mean;
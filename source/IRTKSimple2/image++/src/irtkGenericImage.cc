@@ -17,6 +17,13 @@
 #include <irtkFileToImage.h>
 #include <irtkImageToFile.h>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(void) : irtkBaseImage()
 {
   _attr._x = 0;
@@ -26,6 +33,10 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(void) :
 
   // Initialize data
   _matrix  = NULL;
+  _mappedRegion = NULL;
+  _mappedSize   = 0;
+  _external     = false;
+  _countedSize  = 0;
 }
 
 template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(int x, int y, int z, int t) : irtkBaseImage()
@@ -39,6 +50,10 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(int x,
 
   // Initialize data
   _matrix = NULL;
+  _mappedRegion = NULL;
+  _mappedSize   = 0;
+  _external     = false;
+  _countedSize  = 0;
 
   // Initialize rest of class
   this->Initialize(attr);
@@ -48,6 +63,10 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(char *f
 {
   // Initialize data
   _matrix = NULL;
+  _mappedRegion = NULL;
+  _mappedSize   = 0;
+  _external     = false;
+  _countedSize  = 0;
 
   // Read image
   this->Read(filename);
@@ -57,6 +76,10 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(const i
 {
   // Initialize data
   _matrix  = NULL;
+  _mappedRegion = NULL;
+  _mappedSize   = 0;
+  _external     = false;
+  _countedSize  = 0;
 
   // Initialize rest of class
   this->Initialize(attr);
@@ -69,6 +92,10 @@ template <class VoxelType> irtkGenericImage<VoxelType>::irtkGenericImage(const i
 
   // Initialize data
   _matrix = NULL;
+  _mappedRegion = NULL;
+  _mappedSize   = 0;
+  _external     = false;
+  _countedSize  = 0;
 
   // Initialize rest of class
   this->Initialize(image._attr);
@@ -89,6 +116,10 @@ template <class VoxelType> template <class VoxelType2> irtkGenericImage<VoxelTyp
 
   // Initialize data
   _matrix = NULL;
+  _mappedRegion = NULL;
+  _mappedSize   = 0;
+  _external     = false;
+  _countedSize  = 0;
 
   // Initialize rest of class
   this->Initialize(image.GetImageAttributes());
@@ -104,8 +135,7 @@ template <class VoxelType> template <class VoxelType2> irtkGenericImage<VoxelTyp
 template <class VoxelType> irtkGenericImage<VoxelType>::~irtkGenericImage(void)
 {
   if (_matrix != NULL) {
-    Deallocate<VoxelType>(_matrix);
-    _matrix = NULL;
+    _matrix = this->DeallocateMatrix(_matrix);
   }
   _attr._x = 0;
   _attr._y = 0;
@@ -154,14 +184,20 @@ template <> const char *irtkGenericImage<double>::NameOfClass()
 }
 
 template <class VoxelType> void irtkGenericImage<VoxelType>::Initialize(const irtkImageAttributes &attr)
+{
+  this->Initialize(attr, true);
+}
+
+template <class VoxelType> void irtkGenericImage<VoxelType>::Initialize(const irtkImageAttributes &attr, bool zero)
 {
   // Free memory
   if ((_attr._x != attr._x) || (_attr._y != attr._y) || (_attr._z != attr._z) || (_attr._t != attr._t)) {
     // Free old memory
-    if (_matrix != NULL) Deallocate<VoxelType>(_matrix);
+    _matrix = this->DeallocateMatrix(_matrix);
     // Allocate new memory
     if (attr._x*attr._y*attr._z*attr._t > 0) {
       _matrix = Allocate(_matrix, attr._x, attr._y, attr._z, attr._t);
+      _countedSize = irtkMemoryStatistics::Allocated(IRTK_MEMORY_IMAGES, long(attr._x) * attr._y * attr._z * attr._t * sizeof(VoxelType));
     } else {
       _matrix = NULL;
     }
@@ -171,14 +207,13 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::Initialize(const ir
   this->irtkBaseImage::Update(attr);
 
   // Initialize voxels
-  *this = VoxelType();
+  if (zero) *this = VoxelType();
 }
 
 template <class VoxelType> void irtkGenericImage<VoxelType>::Clear()
 {
 	// Free memory
-	if (_matrix != NULL)
-		Deallocate<VoxelType>(_matrix);
+	_matrix = this->DeallocateMatrix(_matrix);
 
   _attr._x = 0;
   _attr._y = 0;
@@ -187,40 +222,145 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::Clear()
 
 }
 
+template <class VoxelType> VoxelType ****irtkGenericImage<VoxelType>::DeallocateMatrix(VoxelType ****matrix)
+{
+  if (matrix == NULL) return NULL;
+
+  // Flip functions swap in a copy of the same size and free the old data here
+  if (matrix == _matrix) {
+    irtkMemoryStatistics::Deallocated(IRTK_MEMORY_IMAGES, _countedSize);
+    _countedSize = 0;
+  }
+
+#ifndef WIN32
+  // Only free pointer table of memory mapped data
+  if ((_mappedRegion != NULL) && ((char *)matrix[0][0][0] >= (char *)_mappedRegion) &&
+      ((char *)matrix[0][0][0] <  (char *)_mappedRegion + _mappedSize)) {
+    delete []matrix[0][0];
+    delete []matrix[0];
+    delete []matrix;
+    munmap(_mappedRegion, _mappedSize);
+    _mappedRegion = NULL;
+    _mappedSize   = 0;
+    return NULL;
+  }
+#endif
+
+  // Only free pointer table of external data
+  if (_external) {
+    delete []matrix[0][0];
+    delete []matrix[0];
+    delete []matrix;
+    _external = false;
+    return NULL;
+  }
+
+  return Deallocate<VoxelType>(matrix);
+}
+
+template <class VoxelType> void irtkGenericImage<VoxelType>::View(const irtkImageAttributes &attr, VoxelType *data)
+{
+  _matrix = this->DeallocateMatrix(_matrix);
+  _matrix = Allocate(_matrix, attr._x, attr._y, attr._z, attr._t, data);
+  _external = true;
+
+  // Initialize base class
+  this->irtkBaseImage::Update(attr);
+}
+
+template <class VoxelType> bool irtkGenericImage<VoxelType>::Map(const char *filename, long offset, const irtkImageAttributes &attr)
+{
+#ifndef WIN32
+  int fd;
+  void *region;
+  size_t size;
+  struct stat buf;
+  long n = long(attr._x) * attr._y * attr._z * attr._t;
+
+  // Data must be aligned for the voxel type
+  if ((n <= 0) || (offset < 0) || (offset % sizeof(VoxelType) != 0)) return false;
+  size = offset + n * sizeof(VoxelType);
+
+  if ((fd = open(filename, O_RDONLY)) < 0) return false;
+  if ((fstat(fd, &buf) != 0) || (size_t(buf.st_size) < size)) {
+    close(fd);
+    return false;
+  }
+
+  // Private mapping: pages are shared with the page cache until written
+  region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (region == MAP_FAILED) return false;
+
+  _matrix = this->DeallocateMatrix(_matrix);
+  _mappedRegion = region;
+  _mappedSize   = size;
+  _matrix = Allocate(_matrix, attr._x, attr._y, attr._z, attr._t, (VoxelType *)((char *)region + offset));
+
+  // Initialize base class
+  this->irtkBaseImage::Update(attr);
+
+  return true;
+#else
+  return false;
+#endif
+}
+
 template <class VoxelType> void irtkGenericImage<VoxelType>::Read(const char *filename)
 {
   irtkBaseImage *image;
+  irtkGenericImage<VoxelType> *source;
 
   // Allocate file reader
   irtkFileToImage *reader = irtkFileToImage::New(filename);
 
+  // Decode and scale floating point images of other voxel types in one pass
+  if ((reader->GetDataType() != this->GetScalarType()) &&
+      ((this->GetScalarType() == IRTK_VOXEL_FLOAT) || (this->GetScalarType() == IRTK_VOXEL_DOUBLE))) {
+    reader->GetOutputAs(*this);
+    delete reader;
+    return;
+  }
+
   // Get output
   image = reader->GetOutput();
 
-  // Convert image
-  switch (reader->GetDataType()) {
-          
-  case IRTK_VOXEL_CHAR: { *this = *(dynamic_cast<irtkGenericImage<char> *>(image)); } break;
+  // Take over image data if no conversion is needed (keeps memory mapping)
+  source = dynamic_cast<irtkGenericImage<VoxelType> *>(image);
+  if (source != NULL) {
+    swap(_matrix, source->_matrix);
+    swap(_mappedRegion, source->_mappedRegion);
+    swap(_mappedSize, source->_mappedSize);
+    swap(_external, source->_external);
+    swap(_countedSize, source->_countedSize);
+    this->irtkBaseImage::Update(source->GetImageAttributes());
+  } else {
+    // Convert image
+    switch (reader->GetDataType()) {
+
+    case IRTK_VOXEL_CHAR: { *this = *(dynamic_cast<irtkGenericImage<char> *>(image)); } break;
+
+    case IRTK_VOXEL_UNSIGNED_CHAR: { *this = *(dynamic_cast<irtkGenericImage<unsigned char> *>(image)); } break;
 
-  case IRTK_VOXEL_UNSIGNED_CHAR: { *this = *(dynamic_cast<irtkGenericImage<unsigned char> *>(image)); } break;
+    case IRTK_VOXEL_SHORT: { *this = *(dynamic_cast<irtkGenericImage<short> *>(image)); } break;
 
-  case IRTK_VOXEL_SHORT: { *this = *(dynamic_cast<irtkGenericImage<short> *>(image)); } break;
+    case IRTK_VOXEL_UNSIGNED_SHORT: { *this = *(dynamic_cast<irtkGenericImage<unsigned short> *>(image)); } break;
 
-  case IRTK_VOXEL_UNSIGNED_SHORT: { *this = *(dynamic_cast<irtkGenericImage<unsigned short> *>(image)); } break;
-    
-  case IRTK_VOXEL_INT: { *this = *(dynamic_cast<irtkGenericImage<int> *>(image)); } break;
+    case IRTK_VOXEL_INT: { *this = *(dynamic_cast<irtkGenericImage<int> *>(image)); } break;
 
-  case IRTK_VOXEL_UNSIGNED_INT: { *this = *(dynamic_cast<irtkGenericImage<unsigned int> *>(image)); } break;
+    case IRTK_VOXEL_UNSIGNED_INT: { *this = *(dynamic_cast<irtkGenericImage<unsigned int> *>(image)); } break;
 
-  case IRTK_VOXEL_FLOAT: { *this = *(dynamic_cast<irtkGenericImage<float> *>(image)); } break;
+    case IRTK_VOXEL_FLOAT: { *this = *(dynamic_cast<irtkGenericImage<float> *>(image)); } break;
 
-  case IRTK_VOXEL_DOUBLE: { *this = *(dynamic_cast<irtkGenericImage<double> *>(image)); } break;
+    case IRTK_VOXEL_DOUBLE: { *this = *(dynamic_cast<irtkGenericImage<double> *>(image)); } break;
 
-  default:
-      cout << "irtkGenericImage::GetOutput: Unknown voxel type" << endl;
+    default:
+        cout << "irtkGenericImage::GetOutput: Unknown voxel type" << endl;
+    }
   }
 
-  if (reader->GetSlope() != 0) {
+  // Identity scaling would write every page of a memory mapped image
+  if ((reader->GetSlope() != 0) && ((reader->GetSlope() != 1) || (reader->GetIntercept() != 0))) {
       switch (this->GetScalarType()) {
 
       case IRTK_VOXEL_FLOAT: {
@@ -236,10 +376,8 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::Read(const char *fi
           break;
 
       default:
-          if ((reader->GetSlope() != 1) || (reader->GetIntercept() != 0)) {
-              cerr << this->NameOfClass() << "::Read: Ignore slope and intercept, use irtkGenericImage<float> or " << endl;
-              cerr << "irtkGenericImage<double> instead" << endl;
-          }
+          cerr << this->NameOfClass() << "::Read: Ignore slope and intercept, use irtkGenericImage<float> or " << endl;
+          cerr << "irtkGenericImage<double> instead" << endl;
       }
   }
   
@@ -848,6 +986,24 @@ template <class VoxelType> bool irtkGenericImage<VoxelType>::operator==(const ir
   return true;
 }
 
+/// Fills voxels in parallel such that their pages are first touched, and
+/// therefore placed, by the threads of the task arena
+template <class VoxelType> class irtkMultiThreadedImageFill
+{
+  VoxelType *_ptr;
+  VoxelType _pixel;
+
+public:
+
+  irtkMultiThreadedImageFill(VoxelType *ptr, VoxelType pixel) : _ptr(ptr), _pixel(pixel) {}
+
+  void operator()(const blocked_range<int> &r) const {
+    for (int i = r.begin(); i != r.end(); i++) {
+      _ptr[i] = _pixel;
+    }
+  }
+};
+
 template <class VoxelType> irtkGenericImage<VoxelType>& irtkGenericImage<VoxelType>::operator=(VoxelType pixel)
 {
   int i, n;
@@ -855,6 +1011,10 @@ template <class VoxelType> irtkGenericImage<VoxelType>& irtkGenericImage<VoxelTy
   
   n   = this->GetNumberOfVoxels();
   ptr = this->GetPointerToVoxels();
+  if ((tbb_numa_policy == NUMA_FirstTouch) && (n * sizeof(VoxelType) >= 4 * 1024 * 1024)) {
+    irtkParallelFor(blocked_range<int>(0, n, 16384), irtkMultiThreadedImageFill<VoxelType>(ptr, pixel));
+    return *this;
+  }
   for (i = 0; i < n; i++) {
     ptr[i] = pixel;
   }
@@ -1095,7 +1255,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXY(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  matrix = this->DeallocateMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._x, _attr._y);
@@ -1135,7 +1295,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXZ(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  matrix = this->DeallocateMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._x, _attr._z);
@@ -1174,7 +1334,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipYZ(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  matrix = this->DeallocateMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._y, _attr._z);
@@ -1213,7 +1373,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipXT(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  matrix = this->DeallocateMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._x, _attr._t);
@@ -1253,7 +1413,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipYT(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  matrix = this->DeallocateMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._y, _attr._t);
@@ -1293,7 +1453,7 @@ template <class VoxelType> void irtkGenericImage<VoxelType>::FlipZT(int modifyOr
   swap(matrix, _matrix);
 
   // Deallocate memory
-  matrix = Deallocate<VoxelType>(matrix);
+  matrix = this->DeallocateMatrix(matrix);
 
   // Swap image dimensions
   swap(_attr._z, _attr._t);
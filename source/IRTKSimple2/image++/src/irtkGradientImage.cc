@@ -63,24 +63,45 @@ template <class VoxelType> double irtkGradientImage<VoxelType>::Run(int x, int y
   return sqrt(dx*dx + dy*dy + dz*dz);
 }
 
-template <class VoxelType> void irtkGradientImage<VoxelType>::Run()
+template <class VoxelType> void irtkGradientImage<VoxelType>::RunRow(int y, int z, int t, VoxelType *out)
 {
-  int x, y, z, t;
-
-  // Do the initial set up
-  this->Initialize();
-
-  for (t = 0; t < this->_input->GetT(); ++t) {
-    for (z = 0; z < this->_input->GetZ(); ++z) {
-      for (y = 0; y < this->_input->GetY(); ++y) {
-        for (x = 0; x < this->_input->GetX(); ++x) {
-          this->_output->PutAsDouble(x, y, z, t, this->Run(x, y, z, t));
-        }
-      }
+  int x, nx, ny, nz, sy, sz;
+  double dx, dy, dz;
+  VoxelType *in;
+
+  nx = this->_input->GetX();
+  ny = this->_input->GetY();
+  nz = this->_input->GetZ();
+  sy = nx;
+  sz = nx * ny;
+  in = this->_input->GetPointerToVoxels(0, y, z, t);
+
+  for (x = 0; x < nx; x++) {
+    if ((x > 0) && (x < nx-1) && in[x-1] > _Padding && in[x+1] > _Padding) {
+      dx = in[x-1] - in[x+1];
+    } else {
+      dx = 0;
+    }
+
+    if ((y > 0) && (y < ny-1) && in[x-sy] > _Padding && in[x+sy] > _Padding) {
+      dy = in[x-sy] - in[x+sy];
+    } else {
+      dy = 0;
+    }
+
+    if ((z > 0) && (z < nz-1) && in[x-sz] > _Padding && in[x+sz] > _Padding) {
+      dz = in[x-sz] - in[x+sz];
+    } else {
+      dz = 0;
     }
+
+    out[x] = this->ToVoxelType(sqrt(dx*dx + dy*dy + dz*dz));
   }
-  // Do the final cleaning up
-  this->Finalize();
+}
+
+template <class VoxelType> void irtkGradientImage<VoxelType>::Run()
+{
+  this->irtkImageToImage<VoxelType>::Run();
 }
 
 template class irtkGradientImage<unsigned char>;
@@ -36,35 +36,39 @@ template <class VoxelType> double irtkGradientImageX<VoxelType>::Run(int x, int
 }
 
 
-template <class VoxelType> void irtkGradientImageX<VoxelType>::Run()
+template <class VoxelType> void irtkGradientImageX<VoxelType>::RunRow(int y, int z, int t, VoxelType *out)
 {
-  int x, y, z, t;
+  int x, n;
+  VoxelType *in;
+
+  n  = this->_input->GetX();
+  in = this->_input->GetPointerToVoxels(0, y, z, t);
 
+  out[0] = 0;
+  for (x = 1; x < n-1; ++x) {
+    out[x] = this->ToVoxelType(static_cast<double>(in[x-1]) - static_cast<double>(in[x+1]));
+  }
+  out[n-1] = 0;
+}
+
+template <class VoxelType> void irtkGradientImageX<VoxelType>::Initialize()
+{
   // Do the initial set up
-  this->Initialize();
+  this->irtkImageToImage<VoxelType>::Initialize();
 
+  // Check image dimensions....
   if (this->_input->GetX() < 2) {
     cerr<<" irtkGradientImageX: Dimensions of input image are wrong"<<endl;
     exit(1);
   }
+}
 
-  for ( t = 0; t < this->_input->GetT(); ++t) {
-    for ( z = 0; z < this->_input->GetZ(); ++z) {
-      for ( y = 0; y < this->_input->GetY(); ++y) {
-        this->_output->Put(0, y, z, t, 0);
-        for ( x = 1; x < this->_input->GetX()-1; ++x) {
-          this->_output->PutAsDouble(x, y, z, t, this->Run(x, y, z, t));
-        }
-        this->_output->Put(x, y, z, t, 0);
-      }
-    }
-  }
-
-  // Do the final cleaning up
-  this->Finalize();
-
+template <class VoxelType> void irtkGradientImageX<VoxelType>::Run()
+{
+  this->irtkImageToImage<VoxelType>::Run();
 }
 
+
 template class  irtkGradientImageX<irtkBytePixel>;
 template class  irtkGradientImageX<irtkGreyPixel>;
 template class  irtkGradientImageX<irtkRealPixel>;
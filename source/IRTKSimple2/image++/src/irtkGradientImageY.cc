@@ -36,34 +36,39 @@ template <class VoxelType> double irtkGradientImageY<VoxelType>::Run(int x, int
 }
 
 
-template <class VoxelType> void irtkGradientImageY<VoxelType>::Run()
+template <class VoxelType> void irtkGradientImageY<VoxelType>::RunRow(int y, int z, int t, VoxelType *out)
 {
-  int x, y, z, t;
+  int x, n;
+  VoxelType *in;
+
+  n = this->_input->GetX();
+
+  if ((y == 0) || (y == this->_input->GetY()-1)) {
+    for (x = 0; x < n; ++x) out[x] = 0;
+    return;
+  }
+
+  in = this->_input->GetPointerToVoxels(0, y, z, t);
+  for (x = 0; x < n; ++x) {
+    out[x] = this->ToVoxelType(static_cast<double>(in[x-n]) - static_cast<double>(in[x+n]));
+  }
+}
 
+template <class VoxelType> void irtkGradientImageY<VoxelType>::Initialize()
+{
   // Do the initial set up
-  this->Initialize();
+  this->irtkImageToImage<VoxelType>::Initialize();
 
   // Check image dimensions....
   if (this->_input->GetY() < 2) {
     cerr<<" irtkGradientImageY: Dimensions of input image are wrong"<<endl;
     exit(1);
   }
+}
 
-  for ( t = 0; t < this->_input->GetT(); ++t) {
-    for ( z = 0; z < this->_input->GetZ(); ++z) {
-      for ( x = 0; x < this->_input->GetX(); ++x) {
-        this->_output->Put(x, 0, z, t, 0);
-        for ( y = 1; y < this->_input->GetY()-1; ++y) {
-          this->_output->PutAsDouble(x, y, z, t, this->Run(x, y, z, t));
-        }
-        this->_output->Put(x, y, z, t, 0);
-      }
-    }
-  }
-
-  // Do the final cleaning up
-  this->Finalize();
-
+template <class VoxelType> void irtkGradientImageY<VoxelType>::Run()
+{
+  this->irtkImageToImage<VoxelType>::Run();
 }
 
 
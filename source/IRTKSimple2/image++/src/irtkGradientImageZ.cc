@@ -36,33 +36,40 @@ template <class VoxelType> double irtkGradientImageZ<VoxelType>::Run(int x, int
 }
 
 
-template <class VoxelType> void irtkGradientImageZ<VoxelType>::Run()
+template <class VoxelType> void irtkGradientImageZ<VoxelType>::RunRow(int y, int z, int t, VoxelType *out)
 {
-  int x, y, z, t;
+  int x, n, stride;
+  VoxelType *in;
+
+  n      = this->_input->GetX();
+  stride = this->_input->GetX() * this->_input->GetY();
+
+  if ((z == 0) || (z == this->_input->GetZ()-1)) {
+    for (x = 0; x < n; ++x) out[x] = 0;
+    return;
+  }
+
+  in = this->_input->GetPointerToVoxels(0, y, z, t);
+  for (x = 0; x < n; ++x) {
+    out[x] = this->ToVoxelType(static_cast<double>(in[x-stride]) - static_cast<double>(in[x+stride]));
+  }
+}
 
+template <class VoxelType> void irtkGradientImageZ<VoxelType>::Initialize()
+{
   // Do the initial set up
-  this->Initialize();
+  this->irtkImageToImage<VoxelType>::Initialize();
 
   // Check image dimensions....
   if (this->_input->GetZ() < 2) {
     cerr<<" irtkGradientImageZ: Dimensions of input image are wrong"<<endl;
     exit(1);
   }
+}
 
-  for ( t = 0; t < this->_input->GetT(); ++t) {
-    for ( x = 0; x < this->_input->GetX(); ++x) {
-      for ( y = 0; y < this->_input->GetY(); ++y) {
-        this->_output->Put(x, y, 0, t, 0);
-        for ( z = 1; z < this->_input->GetZ()-1; ++z) {
-          this->_output->PutAsDouble(x, y, z, t, this->Run(x, y, z, t));
-        }
-        this->_output->Put(x, y, z, t, 0);
-      }
-    }
-  }
-
-  // Do the final cleaning up
-  this->Finalize();
+template <class VoxelType> void irtkGradientImageZ<VoxelType>::Run()
+{
+  this->irtkImageToImage<VoxelType>::Run();
 }
 
 
@@ -125,6 +125,22 @@ void irtkImageToFileNIFTI::Initialize()
   }
 }
 
+void irtkImageToFileNIFTI::WriteBlockCompressed()
+{
+	irtkCofstream to;
+	char extender[4] = {0, 0, 0, 0};
+
+	// Same layout as nifti_image_write: header, empty extension flag, data
+	nifti_set_iname_offset(_hdr.nim);
+	struct nifti_1_header nhdr = nifti_convert_nim2nhdr(_hdr.nim);
+
+	to.Open(_hdr.nim->fname);
+	to.Write((char *)&nhdr, 0, sizeof(nhdr));
+	to.Write(extender, sizeof(nhdr), sizeof(extender));
+	to.Write((char *)_hdr.nim->data, _hdr.nim->iname_offset, long(_hdr.nim->nvox) * _hdr.nim->nbyper);
+	to.Close();
+}
+
 void irtkImageToFileNIFTI::Run()
 {
 	// Initialize filter
@@ -139,7 +155,16 @@ void irtkImageToFileNIFTI::Run()
 	_hdr.nim->data = this->_input->GetScalarPointer();
 
 	// Write hdr and data
+#ifdef HAS_ZLIB
+	if ((irtkCofstream::GetCompressionThreads() != 1) && nifti_is_gzfile(_hdr.nim->fname) &&
+	    (_hdr.nim->nifti_type == NIFTI_FTYPE_NIFTI1_1) && (_hdr.nim->num_ext == 0)) {
+		this->WriteBlockCompressed();
+	} else {
+		nifti_image_write(_hdr.nim);
+	}
+#else
 	nifti_image_write(_hdr.nim);
+#endif
 
 	// Finalize filter
 	this->Finalize();
@@ -35,13 +35,11 @@ public:
   }
 
   void operator()(const blocked_range<int> &r) const {
-    int i, j, k;
+    int j, k;
 
     for (k = r.begin(); k != r.end(); k++) {
       for (j = 0; j < _filter->_input->GetY(); j++) {
-        for (i = 0; i < _filter->_input->GetX(); i++) {
-          _filter->_output->PutAsDouble(i, j, k, _t, _filter->Run(i, j, k, _t));
-        }
+        _filter->RunRow(j, k, _t, _filter->_output->GetPointerToVoxels(0, j, k, _t));
       }
     }
   }
@@ -166,19 +164,27 @@ template <class VoxelType> double irtkImageToImage<VoxelType>::Run(int, int, int
   return 0;
 }
 
+template <class VoxelType> void irtkImageToImage<VoxelType>::RunRow(int y, int z, int t, VoxelType *out)
+{
+  int x;
+
+  for (x = 0; x < _input->GetX(); x++) {
+    out[x] = ToVoxelType(this->Run(x, y, z, t));
+  }
+}
+
 template <class VoxelType> void irtkImageToImage<VoxelType>::Run()
 {
 #ifdef HAS_TBB
   int t;
 #else
-  int x, y, z, t;
+  int y, z, t;
 #endif
 
   // Do the initial set up
   this->Initialize();
 
 #ifdef HAS_TBB
-  task_scheduler_init init(tbb_no_threads);
 #if USE_TIMING
   tick_count t_start = tick_count::now();
 #endif
@@ -188,14 +194,12 @@ template <class VoxelType> void irtkImageToImage<VoxelType>::Run()
   for (t = 0; t < _input->GetT(); t++) {
 
 #ifdef HAS_TBB
-    parallel_for(blocked_range<int>(0, this->_output->GetZ(), 1), irtkMultiThreadedImageToImage<VoxelType>(this, t));
+    irtkParallelFor(blocked_range<int>(0, this->_output->GetZ(), 1), irtkMultiThreadedImageToImage<VoxelType>(this, t));
 #else
 
     for (z = 0; z < _input->GetZ(); z++) {
       for (y = 0; y < _input->GetY(); y++) {
-        for (x = 0; x < _input->GetX(); x++) {
-          _output->PutAsDouble(x, y, z, t, this->Run(x, y, z, t));
-        }
+        this->RunRow(y, z, t, _output->GetPointerToVoxels(0, y, z, t));
       }
     }
 
@@ -208,8 +212,6 @@ template <class VoxelType> void irtkImageToImage<VoxelType>::Run()
   tick_count t_end = tick_count::now();
   if (tbb_debug) cout << this->NameOfClass() << " = " << (t_end - t_start).seconds() << " secs." << endl;
 #endif
-  init.terminate();
-
 #endif
 
   // Do the final cleaning up
@@ -162,4 +162,130 @@ double irtkLinearInterpolateImageFunction::Evaluate(double x, double y, double z
 	  default: break;
   }
   return val;
-}
\ No newline at end of file
+}
+// Number of locations interpolated per block by the batch interface
+#define IRTK_LINEAR_BATCH_SIZE 32
+
+template <class VoxelType> static void irtkLinearInterpolateBatch(const VoxelType *ptr, int nx, int ny, int nz, int n,
+    const double *x, const double *y, const double *z, double *value, double padding, bool rounding)
+{
+  int i0[IRTK_LINEAR_BATCH_SIZE], i1[IRTK_LINEAR_BATCH_SIZE];
+  int j0[IRTK_LINEAR_BATCH_SIZE], j1[IRTK_LINEAR_BATCH_SIZE];
+  int k0[IRTK_LINEAR_BATCH_SIZE], k1[IRTK_LINEAR_BATCH_SIZE];
+  double t1[IRTK_LINEAR_BATCH_SIZE], t2[IRTK_LINEAR_BATCH_SIZE];
+  double u1[IRTK_LINEAR_BATCH_SIZE], u2[IRTK_LINEAR_BATCH_SIZE];
+  double v1[IRTK_LINEAR_BATCH_SIZE], v2[IRTK_LINEAR_BATCH_SIZE];
+  bool inside[IRTK_LINEAR_BATCH_SIZE];
+  int b, p, m, i, j, k, nxy;
+  double xc, yc, zc, fx, fy, fz, val;
+
+  nxy = nx * ny;
+
+  for (b = 0; b < n; b += IRTK_LINEAR_BATCH_SIZE) {
+    m = n - b;
+    if (m > IRTK_LINEAR_BATCH_SIZE) m = IRTK_LINEAR_BATCH_SIZE;
+
+    // Indices and weights of the corners. Corners outside the image get zero
+    // weight and a clamped index, so no branches are needed in the gather.
+    for (p = 0; p < m; p++) {
+      inside[p] = (x[b+p] > -0.5) && (x[b+p] < nx - 0.5) &&
+                  (y[b+p] > -0.5) && (y[b+p] < ny - 0.5) &&
+                  (z[b+p] > -0.5) && (z[b+p] < nz - 0.5);
+
+      // Keep masked locations in range before the conversion to int
+      xc = (x[b+p] > -1) ? x[b+p] : -1;
+      yc = (y[b+p] > -1) ? y[b+p] : -1;
+      zc = (z[b+p] > -1) ? z[b+p] : -1;
+      xc = (xc < nx) ? xc : nx;
+      yc = (yc < ny) ? yc : ny;
+      zc = (zc < nz) ? zc : nz;
+
+      fx = floor(xc);
+      fy = floor(yc);
+      fz = floor(zc);
+      i  = int(fx);
+      j  = int(fy);
+      k  = int(fz);
+
+      t1[p] = (i + 1 < nx) ? xc - fx : 0;
+      t2[p] = (i >= 0) ? 1 - (xc - fx) : 0;
+      u1[p] = (j + 1 < ny) ? yc - fy : 0;
+      u2[p] = (j >= 0) ? 1 - (yc - fy) : 0;
+      v1[p] = (k + 1 < nz) ? zc - fz : 0;
+      v2[p] = (k >= 0) ? 1 - (zc - fz) : 0;
+
+      i0[p] = (i < 0) ? 0 : i;
+      i1[p] = (i + 1 < nx) ? i + 1 : nx - 1;
+      j0[p] = ((j < 0) ? 0 : j) * nx;
+      j1[p] = ((j + 1 < ny) ? j + 1 : ny - 1) * nx;
+      k0[p] = ((k < 0) ? 0 : k) * nxy;
+      k1[p] = ((k + 1 < nz) ? k + 1 : nz - 1) * nxy;
+    }
+
+    // Gather and combine
+    for (p = 0; p < m; p++) {
+      const VoxelType *p00 = ptr + k0[p] + j0[p];
+      const VoxelType *p01 = ptr + k0[p] + j1[p];
+      const VoxelType *p10 = ptr + k1[p] + j0[p];
+      const VoxelType *p11 = ptr + k1[p] + j1[p];
+
+      val = v2[p] * (u2[p] * (t2[p] * p00[i0[p]] + t1[p] * p00[i1[p]]) +
+                     u1[p] * (t2[p] * p01[i0[p]] + t1[p] * p01[i1[p]])) +
+            v1[p] * (u2[p] * (t2[p] * p10[i0[p]] + t1[p] * p10[i1[p]]) +
+                     u1[p] * (t2[p] * p11[i0[p]] + t1[p] * p11[i1[p]]));
+      if (rounding) val = round(val);
+
+      value[b+p] = inside[p] ? val : padding;
+    }
+  }
+}
+
+void irtkLinearInterpolateImageFunction::EvaluateBatch(int n, const double *x, const double *y, const double *z,
+    double *value, double time)
+{
+  int t = round(time);
+
+  switch (this->_input->GetScalarType()) {
+  case IRTK_VOXEL_UNSIGNED_SHORT: {
+      irtkLinearInterpolateBatch((unsigned short *)this->_input->GetScalarPointer(0, 0, 0, t),
+                                 this->_x, this->_y, this->_z, n, x, y, z, value, this->_DefaultValue, true);
+      break;
+    }
+  case IRTK_VOXEL_SHORT: {
+      irtkLinearInterpolateBatch((short *)this->_input->GetScalarPointer(0, 0, 0, t),
+                                 this->_x, this->_y, this->_z, n, x, y, z, value, this->_DefaultValue, true);
+      break;
+    }
+  case IRTK_VOXEL_FLOAT: {
+      irtkLinearInterpolateBatch((float *)this->_input->GetScalarPointer(0, 0, 0, t),
+                                 this->_x, this->_y, this->_z, n, x, y, z, value, this->_DefaultValue, false);
+      break;
+    }
+  case IRTK_VOXEL_DOUBLE: {
+      irtkLinearInterpolateBatch((double *)this->_input->GetScalarPointer(0, 0, 0, t),
+                                 this->_x, this->_y, this->_z, n, x, y, z, value, this->_DefaultValue, false);
+      break;
+    }
+  default:
+    cerr << "irtkLinearInterpolateImageFunction::EvaluateBatch: Unknown scalar type" << endl;
+    exit(1);
+  }
+}
+
+void irtkLinearInterpolateImageFunction::EvaluateRow(int n, double x, double y, double z,
+    double dx, double dy, double dz, double *value, double time)
+{
+  double bx[IRTK_LINEAR_BATCH_SIZE], by[IRTK_LINEAR_BATCH_SIZE], bz[IRTK_LINEAR_BATCH_SIZE];
+  int b, p, m;
+
+  for (b = 0; b < n; b += IRTK_LINEAR_BATCH_SIZE) {
+    m = n - b;
+    if (m > IRTK_LINEAR_BATCH_SIZE) m = IRTK_LINEAR_BATCH_SIZE;
+    for (p = 0; p < m; p++) {
+      bx[p] = x + (b + p) * dx;
+      by[p] = y + (b + p) * dy;
+      bz[p] = z + (b + p) * dz;
+    }
+    this->EvaluateBatch(m, bx, by, bz, value + b, time);
+  }
+}
@@ -36,6 +36,19 @@ template <class VoxelType> void irtkMedianFilter<VoxelType>::Initialize()
 {
   // Do the initial set up
   this->irtkImageToImage<VoxelType>::Initialize();
+
+  // Check mask
+  if (_mask == NULL) {
+    cerr << this->NameOfClass() << "::Run: Filter has no mask" << endl;
+    exit(1);
+  }
+
+  if ((_mask->GetX() != this->_input->GetX()) ||
+      (_mask->GetY() != this->_input->GetY()) ||
+      (_mask->GetZ() != this->_input->GetZ())) {
+    cerr << this->NameOfClass() << "::Run: Mask dimensions do not match input" << endl;
+    exit(1);
+  }
 }
 
 template <class VoxelType> bool irtkMedianFilter<VoxelType>::RequiresBuffering(void)
@@ -53,52 +66,56 @@ template <class VoxelType> void irtkMedianFilter<VoxelType>::SetMask(irtkRealIma
   }
 }
 
-template <class VoxelType> void irtkMedianFilter<VoxelType>::Run()
+template <class VoxelType> void irtkMedianFilter<VoxelType>::RunRow(int y, int z, int t, VoxelType *out)
 {
-  int x, y, z, t;
-
-  //int dim = 2*_kernelRadius + 1;
+  int x, xx, yy, zz, nx, ny, nz, offset;
+  VoxelType *in;
+  irtkRealPixel *mask;
+  vector<VoxelType> voxels;
+
+  nx   = this->_input->GetX();
+  ny   = this->_input->GetY();
+  nz   = this->_input->GetZ();
+  in   = this->_input->GetPointerToVoxels(0, 0, 0, t);
+  mask = _mask->GetPointerToVoxels(0, 0, 0, (t < _mask->GetT()) ? t : 0);
+
+  // Copy the input for rows which lie entirely within the boundary
+  if ((y < _kernelRadius) || (y > ny - 1 - _kernelRadius) ||
+      (z < _kernelRadius) || (z > nz - 1 - _kernelRadius)) {
+    memcpy(out, in + (z*ny + y)*nx, nx*sizeof(VoxelType));
+    return;
+  }
 
-  // Do the initial set up
-  this->Initialize();
-
-  multiset<VoxelType> voxels;
-
-  for (t = 0; t < this->_input->GetT(); t++) {
-    for (z = 0; z < this->_input->GetZ(); z++) {
-      for (y = 0; y < this->_input->GetY(); y++) {
-        for (x = 0; x < this->_input->GetX(); x++) {
-          if ((x < _kernelRadius) || (x > this->_input->GetX() - 1 - _kernelRadius) ||
-              (y < _kernelRadius) || (y > this->_input->GetY() - 1 - _kernelRadius) ||
-              (z < _kernelRadius) || (z > this->_input->GetZ() - 1 - _kernelRadius)) {
-            this->_output->Put(x, y, z, t, this->_input->Get(x, y, z, t));
-          } else {
-        	  vector<VoxelType> voxels;
-        	  for( int zz = z - _kernelRadius; zz <= z + _kernelRadius; ++zz )
-        	  {
-        		  for( int yy = y - _kernelRadius; yy <= y + _kernelRadius; ++yy )
-        		  {
-        			  for( int xx = x - _kernelRadius; xx <= x + _kernelRadius; ++xx )
-        			  {
-        				  if( this->_mask->Get(xx,yy,zz,t) ) {
-        					  voxels.push_back( this->_input->Get(xx,yy,zz,t) );
-        				  }
-        			  }
-        		  }
-        	  }
-        	  if( voxels.size() )
-        	  {
-        		  sort(voxels.begin(), voxels.end());
-        		  this->_output->Put(x, y, z, t, voxels[voxels.size()/2]);
-        	  }
+  voxels.reserve((2*_kernelRadius+1)*(2*_kernelRadius+1)*(2*_kernelRadius+1));
+
+  for (x = 0; x < nx; x++) {
+    if ((x < _kernelRadius) || (x > nx - 1 - _kernelRadius)) {
+      out[x] = in[(z*ny + y)*nx + x];
+    } else {
+      voxels.clear();
+      for (zz = z - _kernelRadius; zz <= z + _kernelRadius; ++zz) {
+        for (yy = y - _kernelRadius; yy <= y + _kernelRadius; ++yy) {
+          offset = (zz*ny + yy)*nx;
+          for (xx = x - _kernelRadius; xx <= x + _kernelRadius; ++xx) {
+            if (mask[offset + xx]) {
+              voxels.push_back(in[offset + xx]);
+            }
           }
         }
       }
+      if (voxels.size()) {
+        nth_element(voxels.begin(), voxels.begin() + voxels.size()/2, voxels.end());
+        out[x] = voxels[voxels.size()/2];
+      } else {
+        out[x] = 0;
+      }
     }
   }
+}
 
-  // Do the final cleaning up
-  this->Finalize();
+template <class VoxelType> void irtkMedianFilter<VoxelType>::Run()
+{
+  this->irtkImageToImage<VoxelType>::Run();
 }
 
 template class irtkMedianFilter<irtkBytePixel>;
@@ -43,6 +43,19 @@ template <class VoxelType> const char *irtkNoise<VoxelType>::NameOfClass()
   return "irtkNoise";
 }
 
+template <class VoxelType> unsigned int irtkNoise<VoxelType>::Seed(int x, int y, int z, int t)
+{
+  // Mix initialization and voxel index (splitmix64 finalizer)
+  unsigned long long h = (unsigned long long)this->_Init;
+  h ^= ((((unsigned long long)t * this->_input->GetZ() + z) * this->_input->GetY() + y) * this->_input->GetX() + x) * 0x9e3779b97f4a7c15ULL;
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return (unsigned int)(h % 2147483646) + 1;
+}
+
 template class irtkNoise<irtkBytePixel>;
 template class irtkNoise<irtkGreyPixel>;
 template class irtkNoise<irtkRealPixel>;
@@ -61,11 +61,39 @@ template <class VoxelType> const char *irtkNonLocalMedianFilter<VoxelType>::Name
 }
 
 template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::Run(int x, int y, int z, int t){
-  double distancev,currentv,sumofweight;
-  int x1,y1,z1,x2,y2,z2,i,j,k,i1,j1,k1,index;
+  return this->RunVoxel(x, y, z, t, _localweight, _localneighbor);
+}
+
+template <class VoxelType> void irtkNonLocalMedianFilter<VoxelType>::RunRow(int y, int z, int t, VoxelType *out){
+  int x;
+
+  // The member buffers are shared, use local ones as rows run concurrently
+  vector<float> localweight(_Sigma*_Sigma*_Sigma+1);
+  vector<float> localneighbor(_Sigma*_Sigma*_Sigma*2+2);
+
+  for(x = 0; x < this->_input->GetX(); x++){
+    out[x] = this->ToVoxelType(this->RunVoxel(x, y, z, t, &localweight[0], &localneighbor[0]));
+  }
+}
+
+template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::RunVoxel(int x, int y, int z, int t,
+  float *localweight, float *localneighbor){
+  double distancev,currentv,centers,sumofweight;
+  int x1,y1,z1,x2,y2,z2,i,j,k,i1,j1,k1,nx,ny,nz,offset,index;
+  VoxelType *input;
+  irtkGreyPixel *input2;
+  irtkRealPixel *input3;
+
+  nx = this->_input->GetX();
+  ny = this->_input->GetY();
+  nz = this->_input->GetZ();
+  input  = this->_input->GetPointerToVoxels(0, 0, 0, t);
+  input2 = (this->_input2 != NULL) ? this->_input2->GetPointerToVoxels() : NULL;
+  input3 = (this->_input3 != NULL) ? this->_input3->GetPointerToVoxels() : NULL;
+  offset = (z*ny + y)*nx + x;
 
   // if edge use orignal size or use smaller window size
-  if(_edge->Get(x,y,z,t) > 0){
+  if(_edge->GetPointerToVoxels(0, 0, 0, t)[offset] > 0){
     // intialize range
     x1 = x - _Sigma/2;
     x2 = x + _Sigma/2;
@@ -83,15 +111,17 @@ template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::Run(int x
     z2 = z + _Sigma/4;
   }
 
-  if(this->_input->GetZ() == 1){
+  if(nz == 1){
     z1 = z;
     z2 = z;
   }
 
   if(this->_input4 == NULL)
-    currentv = this->_input->GetAsDouble(x,y,z,t);
+    currentv = input[offset];
   else
-    currentv = this->_input4->GetAsDouble(x,y,z,t);
+    currentv = this->_input4->GetPointerToVoxels(0, 0, 0, t)[offset];
+
+  centers = (input2 != NULL) ? input2[(z*ny + y)*nx + x] : 0;
 
   index = 1;
   sumofweight = 0;
@@ -102,43 +132,43 @@ template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::Run(int x
         // check if within image
         // mirror the image around boundary according to Deqing Sun's matlab code;
         i1 = i; j1 = j; k1 = k;
-        if(i < 0) 
+        if(i < 0)
           i1 = abs(i);
-        else if(i>=this->_input->GetX())
-          i1 = 2*this->_input->GetX() - i - 2;
+        else if(i>=nx)
+          i1 = 2*nx - i - 2;
 
         if(j < 0)
           j1 = abs(j);
-        else if(j>=this->_input->GetY())
-          j1 = 2*this->_input->GetY() - j - 2;
+        else if(j>=ny)
+          j1 = 2*ny - j - 2;
 
         if(k < 0)
           k1 = abs(k);
-        else if(k>=this->_input->GetZ())
-          k1 = 2*this->_input->GetZ() - k - 2;
+        else if(k>=nz)
+          k1 = 2*nz - k - 2;
 
-        if(i1>=0 && i1 < this->_input->GetX()
-          && j1>=0 && j1 < this->_input->GetY()
-          && k1>=0 && k1 < this->_input->GetZ()){
+        if(i1>=0 && i1 < nx
+          && j1>=0 && j1 < ny
+          && k1>=0 && k1 < nz){
             // Now down to business
             distancev = (i-x)*(i-x)*_dx*_dx
               + (j-y)*(j-y)*_dy*_dy + (k-z)*(k-z)*_dz*_dz;
-            if(this->_input2 != NULL)
-              distancev += (this->_input2->GetAsDouble(i1,j1,k1)-this->_input2->GetAsDouble(x,y,z))
-              * (this->_input2->GetAsDouble(i1,j1,k1)-this->_input2->GetAsDouble(x,y,z))*_ds;
+            if(input2 != NULL)
+              distancev += (input2[(k1*ny + j1)*nx + i1]-centers)
+              * (input2[(k1*ny + j1)*nx + i1]-centers)*_ds;
 
             distancev = this->EvaluateWeight(distancev);
 
             if(distancev > 0 && distancev < 1){
-              _localneighbor[index] = this->_input->GetAsDouble(i1,j1,k1,t);
+              localneighbor[index] = input[(k1*ny + j1)*nx + i1];
 
-              _localweight[index] = distancev;
+              localweight[index] = distancev;
 
-              if(this->_input3 != NULL)
-                _localweight[index] = _localweight[index]*this->_input3->GetAsDouble(i1,j1,k1);
+              if(input3 != NULL)
+                localweight[index] = localweight[index]*input3[(k1*ny + j1)*nx + i1];
 
               //accumulate sum of weight
-              sumofweight += _localweight[index];
+              sumofweight += localweight[index];
               //index
               index++;
             }
@@ -149,13 +179,13 @@ template <class VoxelType> double irtkNonLocalMedianFilter<VoxelType>::Run(int x
 
   // normalize weight
   for(i = 1; i < index; i++){
-    _localweight[i] /= sumofweight;
+    localweight[i] /= sumofweight;
   }
 
   if(index > 1)
-    return weightedmedian(index,_Lambda,currentv,_localneighbor,_localweight);
+    return weightedmedian(index,_Lambda,currentv,localneighbor,localweight);
   else
-    return this->_input->GetAsDouble(x,y,z,t);
+    return input[offset];
 
 }
 
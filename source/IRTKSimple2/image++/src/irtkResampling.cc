@@ -14,44 +14,239 @@
 
 #include <irtkResampling.h>
 
-#ifdef HAS_TBB
+#include <typeinfo>
+
+/// Interpolation through the virtual interface of any image function
+class irtkResamplingGenericKernel
+{
+
+  /// Interpolator
+  irtkImageFunction *_interpolator;
+
+  /// Time frame to interpolate
+  double _t;
+
+public:
+
+  irtkResamplingGenericKernel(irtkImageFunction *interpolator, int t) {
+    _interpolator = interpolator;
+    _t = t;
+  }
+
+  inline double operator()(double x, double y, double z) const {
+    return _interpolator->Evaluate(x, y, z, _t);
+  }
+};
+
+/// Typed equivalent of irtkNearestNeighborInterpolateImageFunction::Evaluate
+template <class VoxelType> class irtkResamplingNearestNeighborKernel
+{
+
+  /// Pointer to first voxel of time frame
+  const VoxelType *_ptr;
+
+  /// Image dimensions
+  int _x, _y, _z;
+
+  /// Value outside of the image domain
+  double _DefaultValue;
+
+public:
+
+  irtkResamplingNearestNeighborKernel(irtkGenericImage<VoxelType> *image, int t, double value) {
+    _ptr = image->GetPointerToVoxels(0, 0, 0, t);
+    _x   = image->GetX();
+    _y   = image->GetY();
+    _z   = image->GetZ();
+    _DefaultValue = value;
+  }
+
+  inline double operator()(double x, double y, double z) const {
+    int i, j, k;
 
-template <class VoxelType> class irtkMultiThreadedResampling
+    i = round(x);
+    j = round(y);
+    k = round(z);
+
+    if ((i < 0) || (i >= _x) || (j < 0) || (j >= _y) || (k < 0) || (k >= _z)) {
+      return _DefaultValue;
+    } else {
+      return _ptr[(k*_y + j)*_x + i];
+    }
+  }
+};
+
+/// Typed equivalent of irtkLinearInterpolateImageFunction::Evaluate
+template <class VoxelType> class irtkResamplingLinearKernel
+{
+
+  /// Pointer to first voxel of time frame
+  const VoxelType *_ptr;
+
+  /// Image dimensions
+  int _x, _y, _z;
+
+  /// Whether to round the result as done for short images
+  bool _round;
+
+public:
+
+  irtkResamplingLinearKernel(irtkGenericImage<VoxelType> *image, int t) {
+    _ptr   = image->GetPointerToVoxels(0, 0, 0, t);
+    _x     = image->GetX();
+    _y     = image->GetY();
+    _z     = image->GetZ();
+    _round = (image->GetScalarType() == IRTK_VOXEL_SHORT) ||
+             (image->GetScalarType() == IRTK_VOXEL_UNSIGNED_SHORT);
+  }
+
+  inline double operator()(double x, double y, double z) const {
+    int i, j, k, l, m, n;
+    double val;
+
+    i = (int)floor(x);
+    j = (int)floor(y);
+    k = (int)floor(z);
+
+    val = 0;
+    for (l = i; l <= i+1; l++) {
+      if ((l >= 0) && (l < _x)) {
+        for (m = j; m <= j+1; m++) {
+          if ((m >= 0) && (m < _y)) {
+            for (n = k; n <= k+1; n++) {
+              if ((n >= 0) && (n < _z)) {
+                val += (1 - fabs(l - x))*(1 - fabs(m - y))*(1 - fabs(n - z))*_ptr[(n*_y + m)*_x + l];
+              }
+            }
+          }
+        }
+      }
+    }
+    if (_round) val = round(val);
+    return val;
+  }
+};
+
+/**
+ * Resamples rows of the output image. The input coordinates along each row
+ * are stepped incrementally using the index map of the filter, and the
+ * interpolation kernel is a template parameter so that it can be inlined.
+ */
+template <class VoxelType, class Kernel> class irtkMultiThreadedResampling
 {
 
   /// Time frame to transform
   int _t;
 
-  /// Pointer to image transformation class
-  irtkResampling<VoxelType> *_filter;
+  /// Output image
+  irtkGenericImage<VoxelType> *_output;
+
+  /// Affine map from output to input voxel coordinates
+  const double (*_map)[4];
+
+  /// Interpolation kernel
+  Kernel _kernel;
 
 public:
 
-  irtkMultiThreadedResampling(irtkResampling<VoxelType> *filter, int t) {
+  irtkMultiThreadedResampling(irtkGenericImage<VoxelType> *output, const double (*map)[4], const Kernel &kernel, int t) : _kernel(kernel) {
     _t = t;
-    _filter = filter;
+    _output = output;
+    _map = map;
   }
 
   void operator()(const blocked_range<int> &r) const {
-    int i, j, k;
+    int i, j, k, n;
     double x, y, z;
+    VoxelType *ptr;
 
+    n = _output->GetX();
     for (k = r.begin(); k != r.end(); k++) {
-      for (j = 0; j < _filter->_output->GetY(); j++) {
-        for (i = 0; i < _filter->_output->GetX(); i++) {
-          x = i;
-          y = j;
-          z = k;
-          _filter->_output->ImageToWorld(x, y, z);
-          _filter->_input ->WorldToImage(x, y, z);
-          _filter->_output->PutAsDouble(i, j, k, _t, _filter->_Interpolator->Evaluate(x, y, z, _t));
+      for (j = 0; j < _output->GetY(); j++) {
+        // Input coordinates of the first voxel of the row
+        x = _map[0][1] * j + _map[0][2] * k + _map[0][3];
+        y = _map[1][1] * j + _map[1][2] * k + _map[1][3];
+        z = _map[2][1] * j + _map[2][2] * k + _map[2][3];
+        ptr = _output->GetPointerToVoxels(0, j, k, _t);
+        for (i = 0; i < n; i++) {
+          ptr[i] = irtkImageToImage<VoxelType>::ToVoxelType(_kernel(x + i * _map[0][0], y + i * _map[1][0], z + i * _map[2][0]));
         }
       }
     }
   }
 };
 
-#endif
+/// Linear interpolation weights of one output index along an axis
+struct irtkResamplingWeights
+{
+  int _lo, _hi;
+  double _wlo, _whi;
+};
+
+/**
+ * Linear interpolation along one axis of an image which is stored with x
+ * varying fastest. Source and destination only differ in their size along
+ * the interpolated axis.
+ */
+template <class SourceType, class DestinationType> class irtkMultiThreadedSeparableResampling
+{
+
+  /// Source and destination
+  const SourceType *_src;
+  DestinationType  *_dst;
+
+  /// Destination dimensions
+  int _dim[3];
+
+  /// Strides of the source
+  int _stride[3];
+
+  /// Interpolated axis
+  int _axis;
+
+  /// Weights for each destination index along the interpolated axis
+  const irtkResamplingWeights *_weights;
+
+  /// Whether to round the result as done for short images
+  bool _round;
+
+public:
+
+  irtkMultiThreadedSeparableResampling(const SourceType *src, DestinationType *dst, const int *srcdim, const int *dstdim, int axis, const irtkResamplingWeights *weights, bool rounding) {
+    _src = src;
+    _dst = dst;
+    _dim[0] = dstdim[0];
+    _dim[1] = dstdim[1];
+    _dim[2] = dstdim[2];
+    _stride[0] = 1;
+    _stride[1] = srcdim[0];
+    _stride[2] = srcdim[0] * srcdim[1];
+    _axis = axis;
+    _weights = weights;
+    _round = rounding;
+  }
+
+  void operator()(const blocked_range<int> &r) const {
+    int i[3], offset, stride;
+    double val;
+    DestinationType *ptr;
+
+    stride = _stride[_axis];
+    for (i[2] = r.begin(); i[2] != r.end(); i[2]++) {
+      for (i[1] = 0; i[1] < _dim[1]; i[1]++) {
+        ptr = _dst + (i[2] * _dim[1] + i[1]) * _dim[0];
+        for (i[0] = 0; i[0] < _dim[0]; i[0]++) {
+          const irtkResamplingWeights &w = _weights[i[_axis]];
+          // Source offset of the voxel with index zero along the axis
+          offset = i[0] * _stride[0] + i[1] * _stride[1] + i[2] * _stride[2] - i[_axis] * stride;
+          val = w._wlo * _src[offset + w._lo * stride] + w._whi * _src[offset + w._hi * stride];
+          if (_round) val = round(val);
+          ptr[i[0]] = irtkImageToImage<DestinationType>::ToVoxelType(val);
+        }
+      }
+    }
+  }
+};
 
 template <class VoxelType> irtkResampling<VoxelType>::irtkResampling(double new_xsize, double new_ysize, double new_zsize)
 {
@@ -131,46 +326,134 @@ template <class VoxelType> void irtkResampling<VoxelType>::Initialize()
   this->_output->PutOrigin(this->_input->GetOrigin());
 }
 
+template <class VoxelType> void irtkResampling<VoxelType>::InitializeIndexMap()
+{
+  int a;
+  double x, y, z;
+
+  // Input coordinates of the first output voxel
+  x = 0;
+  y = 0;
+  z = 0;
+  this->_output->ImageToWorld(x, y, z);
+  this->_input ->WorldToImage(x, y, z);
+  _IndexMap[0][3] = x;
+  _IndexMap[1][3] = y;
+  _IndexMap[2][3] = z;
+
+  // Increments of the input coordinates for a step along each output axis
+  for (a = 0; a < 3; a++) {
+    x = (a == 0) ? 1 : 0;
+    y = (a == 1) ? 1 : 0;
+    z = (a == 2) ? 1 : 0;
+    this->_output->ImageToWorld(x, y, z);
+    this->_input ->WorldToImage(x, y, z);
+    _IndexMap[0][a] = x - _IndexMap[0][3];
+    _IndexMap[1][a] = y - _IndexMap[1][3];
+    _IndexMap[2][a] = z - _IndexMap[2][3];
+  }
+
+  _AxisAligned = (fabs(_IndexMap[0][1]) < 1e-9) && (fabs(_IndexMap[0][2]) < 1e-9) &&
+                 (fabs(_IndexMap[1][0]) < 1e-9) && (fabs(_IndexMap[1][2]) < 1e-9) &&
+                 (fabs(_IndexMap[2][0]) < 1e-9) && (fabs(_IndexMap[2][1]) < 1e-9);
+}
+
+template <class VoxelType> void irtkResampling<VoxelType>::RunSeparableLinear(int l)
+{
+  int a, i, lo, srcdim[3], dstdim[3], tmpdim1[3], tmpdim2[3];
+  double x;
+  bool rounding;
+
+  srcdim[0] = this->_input ->GetX();
+  srcdim[1] = this->_input ->GetY();
+  srcdim[2] = this->_input ->GetZ();
+  dstdim[0] = this->_output->GetX();
+  dstdim[1] = this->_output->GetY();
+  dstdim[2] = this->_output->GetZ();
+
+  // Precompute the weights of both neighbours along each axis. Neighbours
+  // outside of the input get zero weight as in irtkLinearInterpolateImageFunction
+  vector<irtkResamplingWeights> weights[3];
+  for (a = 0; a < 3; a++) {
+    weights[a].resize(dstdim[a]);
+    for (i = 0; i < dstdim[a]; i++) {
+      irtkResamplingWeights &w = weights[a][i];
+      x  = _IndexMap[a][a] * i + _IndexMap[a][3];
+      lo = (int)floor(x);
+      if ((lo >= 0) && (lo < srcdim[a])) {
+        w._lo  = lo;
+        w._wlo = 1 - fabs(lo - x);
+      } else {
+        w._lo  = 0;
+        w._wlo = 0;
+      }
+      if ((lo+1 >= 0) && (lo+1 < srcdim[a])) {
+        w._hi  = lo+1;
+        w._whi = 1 - fabs(lo + 1 - x);
+      } else {
+        w._hi  = 0;
+        w._whi = 0;
+      }
+    }
+  }
+
+  // Interpolate along x, then along y, then along z
+  tmpdim1[0] = dstdim[0];
+  tmpdim1[1] = srcdim[1];
+  tmpdim1[2] = srcdim[2];
+  tmpdim2[0] = dstdim[0];
+  tmpdim2[1] = dstdim[1];
+  tmpdim2[2] = srcdim[2];
+  vector<double> tmp1(tmpdim1[0] * tmpdim1[1] * tmpdim1[2]);
+  vector<double> tmp2(tmpdim2[0] * tmpdim2[1] * tmpdim2[2]);
+
+  rounding = (this->_input->GetScalarType() == IRTK_VOXEL_SHORT) ||
+          (this->_input->GetScalarType() == IRTK_VOXEL_UNSIGNED_SHORT);
+
+  irtkParallelFor(blocked_range<int>(0, tmpdim1[2], 1),
+                  irtkMultiThreadedSeparableResampling<VoxelType, double>(this->_input->GetPointerToVoxels(0, 0, 0, l), &tmp1[0],
+                      srcdim, tmpdim1, 0, &weights[0][0], false));
+  irtkParallelFor(blocked_range<int>(0, tmpdim2[2], 1),
+                  irtkMultiThreadedSeparableResampling<double, double>(&tmp1[0], &tmp2[0],
+                      tmpdim1, tmpdim2, 1, &weights[1][0], false));
+  irtkParallelFor(blocked_range<int>(0, dstdim[2], 1),
+                  irtkMultiThreadedSeparableResampling<double, VoxelType>(&tmp2[0], this->_output->GetPointerToVoxels(0, 0, 0, l),
+                      tmpdim2, dstdim, 2, &weights[2][0], rounding));
+}
+
 template <class VoxelType> void irtkResampling<VoxelType>::Run()
 {
-#ifdef HAS_TBB
   int l;
-#else
-  int i, j, k, l;
-  double x, y, z;
-#endif
 
   // Do the initial set up
   this->Initialize();
+  this->InitializeIndexMap();
 
 #ifdef HAS_TBB
-  task_scheduler_init init(tbb_no_threads);
 #if USE_TIMING
   tick_count t_start = tick_count::now();
 #endif
 #endif
 
-  for (l = 0; l < this->_output->GetT(); l++) {
+  blocked_range<int> range(0, this->_output->GetZ(), 1);
 
-#ifdef HAS_TBB
-    parallel_for(blocked_range<int>(0, this->_output->GetZ(), 1), irtkMultiThreadedResampling<VoxelType>(this, l));
-#else
-
-    for (k = 0; k < this->_output->GetZ(); k++) {
-      for (j = 0; j < this->_output->GetY(); j++) {
-        for (i = 0; i < this->_output->GetX(); i++) {
-          x = i;
-          y = j;
-          z = k;
-          this->_output->ImageToWorld(x, y, z);
-          this->_input ->WorldToImage(x, y, z);
-          this->_output->PutAsDouble(i, j, k, l, this->_Interpolator->Evaluate(x, y, z, l));
-        }
+  for (l = 0; l < this->_output->GetT(); l++) {
+    // Use typed kernels for the interpolators we know and resample separably
+    // if the output grid is a scaled version of the input grid
+    if (typeid(*_Interpolator) == typeid(irtkLinearInterpolateImageFunction)) {
+      if (_AxisAligned) {
+        this->RunSeparableLinear(l);
+      } else {
+        irtkParallelFor(range, irtkMultiThreadedResampling<VoxelType, irtkResamplingLinearKernel<VoxelType> >(
+                          this->_output, _IndexMap, irtkResamplingLinearKernel<VoxelType>(this->_input, l), l));
       }
+    } else if (typeid(*_Interpolator) == typeid(irtkNearestNeighborInterpolateImageFunction)) {
+      irtkParallelFor(range, irtkMultiThreadedResampling<VoxelType, irtkResamplingNearestNeighborKernel<VoxelType> >(
+                        this->_output, _IndexMap, irtkResamplingNearestNeighborKernel<VoxelType>(this->_input, l, _Interpolator->GetDefaultValue()), l));
+    } else {
+      irtkParallelFor(range, irtkMultiThreadedResampling<VoxelType, irtkResamplingGenericKernel>(
+                        this->_output, _IndexMap, irtkResamplingGenericKernel(_Interpolator, l), l));
     }
-
-#endif
-
   }
 
 #ifdef HAS_TBB
@@ -178,8 +461,6 @@ template <class VoxelType> void irtkResampling<VoxelType>::Run()
   tick_count t_end = tick_count::now();
   if (tbb_debug) cout << this->NameOfClass() << " = " << (t_end - t_start).seconds() << " secs." << endl;
 #endif
-  init.terminate();
-
 #endif
 
   // Do the final cleaning up
@@ -14,38 +14,61 @@
 
 #include <irtkResampling.h>
 
-#ifdef HAS_TBB
-
+/**
+ * Resamples rows of the output image by trilinear interpolation which ignores
+ * padded voxels. The input coordinates along each row are stepped
+ * incrementally, and neighbours outside of the image or with the padding
+ * value are masked out instead of branched around.
+ */
 template <class VoxelType> class irtkMultiThreadedResamplingWithPadding
 {
 
   /// Time frame to transform
   int _t;
 
-  /// Pointer to image transformation class
-  irtkResamplingWithPadding<VoxelType> *_filter;
+  /// Input and output image
+  irtkGenericImage<VoxelType> *_input;
+  irtkGenericImage<VoxelType> *_output;
+
+  /// Affine map from output to input voxel coordinates
+  const double (*_map)[4];
+
+  /// Padding value
+  VoxelType _PaddingValue;
 
 public:
 
-  irtkMultiThreadedResamplingWithPadding(irtkResamplingWithPadding<VoxelType> *filter, int t) {
+  irtkMultiThreadedResamplingWithPadding(irtkGenericImage<VoxelType> *input, irtkGenericImage<VoxelType> *output, const double (*map)[4], VoxelType padding, int t) {
     _t = t;
-    _filter = filter;
+    _input = input;
+    _output = output;
+    _map = map;
+    _PaddingValue = padding;
   }
 
   void operator()(const blocked_range<int> &r) const {
-    int i, j, k, l, u, v, w, pad;
-    double val, sum;
-    double w1, w2, w3, w4, w5, w6, w7, w8, dx, dy, dz, x, y, z;
+    int i, j, k, a, b, c, u, v, w, nx, ny, nz, pad, inside, use;
+    int index[2][3], valid[2][3];
+    double x0, y0, z0, x, y, z, dx, dy, dz, val, sum, weight;
+    double weights[2][3];
+    VoxelType value, *in, *out;
+
+    nx = _input->GetX();
+    ny = _input->GetY();
+    nz = _input->GetZ();
+    in = _input->GetPointerToVoxels(0, 0, 0, _t);
 
-    l = _t;
     for (k = r.begin(); k != r.end(); k++) {
-      for (j = 0; j < _filter->_output->GetY(); j++) {
-        for (i = 0; i < _filter->_output->GetX(); i++) {
-          x = i;
-          y = j;
-          z = k;
-          _filter->_output->ImageToWorld(x, y, z);
-          _filter->_input ->WorldToImage(x, y, z);
+      for (j = 0; j < _output->GetY(); j++) {
+        // Input coordinates of the first voxel of the row
+        x0 = _map[0][1] * j + _map[0][2] * k + _map[0][3];
+        y0 = _map[1][1] * j + _map[1][2] * k + _map[1][3];
+        z0 = _map[2][1] * j + _map[2][2] * k + _map[2][3];
+        out = _output->GetPointerToVoxels(0, j, k, _t);
+        for (i = 0; i < _output->GetX(); i++) {
+          x = x0 + i * _map[0][0];
+          y = y0 + i * _map[1][0];
+          z = z0 + i * _map[2][0];
 
           // Calculate integer fraction of points
           u = (int)floor(x);
@@ -57,121 +80,52 @@ public:
           dy = y - v;
           dz = z - w;
 
-          // Calculate weights for trilinear interpolation
-          w1 = (1 - dx) * (1 - dy) * (1 - dz);
-          w2 = (1 - dx) * (1 - dy) * dz;
-          w3 = (1 - dx) * dy * (1 - dz);
-          w4 = (1 - dx) * dy * dz;
-          w5 = dx * (1 - dy) * (1 - dz);
-          w6 = dx * (1 - dy) * dz;
-          w7 = dx * dy * (1 - dz);
-          w8 = dx * dy * dz;
-
-          // Calculate trilinear interpolation, ignoring padded values
+          // Calculate weights for trilinear interpolation along each axis
+          weights[0][0] = 1 - dx;
+          weights[1][0] = dx;
+          weights[0][1] = 1 - dy;
+          weights[1][1] = dy;
+          weights[0][2] = 1 - dz;
+          weights[1][2] = dz;
+
+          // Neighbour indices clamped to the image, and whether they are inside
+          valid[0][0] = (u   >= 0) & (u   < nx);
+          valid[1][0] = (u+1 >= 0) & (u+1 < nx);
+          valid[0][1] = (v   >= 0) & (v   < ny);
+          valid[1][1] = (v+1 >= 0) & (v+1 < ny);
+          valid[0][2] = (w   >= 0) & (w   < nz);
+          valid[1][2] = (w+1 >= 0) & (w+1 < nz);
+          index[0][0] = valid[0][0] ? u   : 0;
+          index[1][0] = valid[1][0] ? u+1 : 0;
+          index[0][1] = valid[0][1] ? v   : 0;
+          index[1][1] = valid[1][1] ? v+1 : 0;
+          index[0][2] = valid[0][2] ? w   : 0;
+          index[1][2] = valid[1][2] ? w+1 : 0;
+
+          // Calculate trilinear interpolation, ignoring padded values. As
+          // before, neighbours outside of the image count as not padded.
           val = 0;
           pad = 8;
           sum = 0;
-          if ((u >= 0) && (u < _filter->_input->GetX()) &&
-              (v >= 0) && (v < _filter->_input->GetY()) &&
-              (w >= 0) && (w < _filter->_input->GetZ())) {
-            if (_filter->_input->Get(u, v, w, l) != _filter->_PaddingValue) {
-              pad--;
-              val += _filter->_input->Get(u, v, w, l) * w1;
-              sum += w1;
-            }
-          } else {
-            pad--;
-          }
-          if ((u >= 0)   && (u < _filter->_input->GetX()) &&
-              (v >= 0)   && (v < _filter->_input->GetY()) &&
-              (w+1 >= 0) && (w+1 < _filter->_input->GetZ())) {
-            if (_filter->_input->Get(u, v, w+1, l) != _filter->_PaddingValue) {
-              pad--;
-              val += _filter->_input->Get(u, v, w+1, l) * w2;
-              sum += w2;
-            }
-          } else {
-            pad--;
-          }
-          if ((u >= 0)   && (u < _filter->_input->GetX()) &&
-              (v+1 >= 0) && (v+1 < _filter->_input->GetY()) &&
-              (w >= 0)   && (w < _filter->_input->GetZ())) {
-            if (_filter->_input->Get(u, v+1, w, l) != _filter->_PaddingValue) {
-              pad--;
-              val += _filter->_input->Get(u, v+1, w, l) * w3;
-              sum += w3;
-            }
-          } else {
-            pad--;
-          }
-          if ((u >= 0)   && (u < _filter->_input->GetX()) &&
-              (v+1 >= 0) && (v+1 < _filter->_input->GetY()) &&
-              (w+1 >= 0) && (w+1 < _filter->_input->GetZ())) {
-            if (_filter->_input->Get(u, v+1, w+1, l) != _filter->_PaddingValue) {
-              pad--;
-              val += _filter->_input->Get(u, v+1, w+1, l) * w4;
-              sum += w4;
-            }
-          } else {
-            pad--;
-          }
-          if ((u+1 >= 0) && (u+1 < _filter->_input->GetX()) &&
-              (v >= 0)   && (v < _filter->_input->GetY()) &&
-              (w >= 0)   && (w < _filter->_input->GetZ())) {
-            if (_filter->_input->Get(u+1, v, w, l) != _filter->_PaddingValue) {
-              pad--;
-              val += _filter->_input->Get(u+1, v, w, l) * w5;
-              sum += w5;
-            }
-          } else {
-            pad--;
-          }
-          if ((u+1 >= 0) && (u+1 < _filter->_input->GetX()) &&
-              (v >= 0)   && (v < _filter->_input->GetY()) &&
-              (w+1 >= 0) && (w+1 < _filter->_input->GetZ())) {
-            if (_filter->_input->Get(u+1, v, w+1, l) != _filter->_PaddingValue) {
-              pad--;
-              val += _filter->_input->Get(u+1, v, w+1, l) * w6;
-              sum += w6;
-            }
-          } else {
-            pad--;
-          }
-          if ((u+1 >= 0) && (u+1 < _filter->_input->GetX()) &&
-              (v+1 >= 0) && (v+1 < _filter->_input->GetY()) &&
-              (w >= 0)   && (w < _filter->_input->GetZ())) {
-            if (_filter->_input->Get(u+1, v+1, w, l) != _filter->_PaddingValue) {
-              pad--;
-              val += _filter->_input->Get(u+1, v+1, w, l) * w7;
-              sum += w7;
-            }
-          } else {
-            pad--;
-          }
-          if ((u+1 >= 0) && (u+1 < _filter->_input->GetX()) &&
-              (v+1 >= 0) && (v+1 < _filter->_input->GetY()) &&
-              (w+1 >= 0) && (w+1 < _filter->_input->GetZ())) {
-            if (_filter->_input->Get(u+1, v+1, w+1, l) != _filter->_PaddingValue) {
-              pad--;
-              val += _filter->_input->Get(u+1, v+1, w+1, l) * w8;
-              sum += w8;
+          for (a = 0; a < 2; a++) {
+            for (b = 0; b < 2; b++) {
+              for (c = 0; c < 2; c++) {
+                inside = valid[a][0] & valid[b][1] & valid[c][2];
+                value  = in[(index[c][2] * ny + index[b][1]) * nx + index[a][0]];
+                use    = inside & (value != _PaddingValue);
+                weight = weights[a][0] * weights[b][1] * weights[c][2];
+                pad   -= (1 - inside) | use;
+                val   += use * (value * weight);
+                sum   += use * weight;
+              }
             }
-          } else {
-            pad--;
           }
-          if (pad < 4) {
-            if (sum > 0) {
-              _filter->_output->PutAsDouble(i, j, k, l, val / sum);
-            } else {
-              // Special case: Point lies on edge of padded voxels.
-              _filter->_output->Put(i, j, k, l, _filter->_PaddingValue);
-              // Rather than:
-              // cerr << _filter->NameOfClass();
-              // cerr << "::Run: _filter should never happen" << endl;
-              // exit(1);
-            }
+
+          if ((pad < 4) && (sum > 0)) {
+            out[i] = irtkImageToImage<VoxelType>::ToVoxelType(val / sum);
           } else {
-            _filter->_output->Put(i, j, k, l, _filter->_PaddingValue);
+            // Special case: Point lies on edge of padded voxels.
+            out[i] = _PaddingValue;
           }
         }
       }
@@ -179,8 +133,6 @@ public:
   }
 };
 
-#endif
-
 template <class VoxelType>
 irtkResamplingWithPadding<VoxelType>::irtkResamplingWithPadding(double new_xsize, double new_ysize, double new_zsize, VoxelType PaddingValue) : irtkResampling<VoxelType>(new_xsize, new_ysize, new_zsize)
 {
@@ -254,171 +206,21 @@ void irtkResamplingWithPadding<VoxelType>::Initialize()
 
 template <class VoxelType> void irtkResamplingWithPadding<VoxelType>::Run()
 {
-#ifdef HAS_TBB
   int l;
-#else
-  int i, j, k, l, u, v, w, pad;
-  double val, sum;
-  double w1, w2, w3, w4, w5, w6, w7, w8, dx, dy, dz, x, y, z;
-#endif
 
   // Do the initial set up
   this->Initialize();
+  this->InitializeIndexMap();
 
 #ifdef HAS_TBB
-  task_scheduler_init init(tbb_no_threads);
 #if USE_TIMING
   tick_count t_start = tick_count::now();
 #endif
 #endif
 
   for (l = 0; l < this->_output->GetT(); l++) {
-
-#ifdef HAS_TBB
-    parallel_for(blocked_range<int>(0, this->_output->GetZ(), 1), irtkMultiThreadedResamplingWithPadding<VoxelType>(this, l));
-#else
-
-    for (k = 0; k < this->_output->GetZ(); k++) {
-      for (j = 0; j < this->_output->GetY(); j++) {
-        for (i = 0; i < this->_output->GetX(); i++) {
-          x = i;
-          y = j;
-          z = k;
-          this->_output->ImageToWorld(x, y, z);
-          this->_input ->WorldToImage(x, y, z);
-
-          // Calculate integer fraction of points
-          u = (int)floor(x);
-          v = (int)floor(y);
-          w = (int)floor(z);
-
-          // Calculate floating point fraction of points
-          dx = x - u;
-          dy = y - v;
-          dz = z - w;
-
-          // Calculate weights for trilinear interpolation
-          w1 = (1 - dx) * (1 - dy) * (1 - dz);
-          w2 = (1 - dx) * (1 - dy) * dz;
-          w3 = (1 - dx) * dy * (1 - dz);
-          w4 = (1 - dx) * dy * dz;
-          w5 = dx * (1 - dy) * (1 - dz);
-          w6 = dx * (1 - dy) * dz;
-          w7 = dx * dy * (1 - dz);
-          w8 = dx * dy * dz;
-
-          // Calculate trilinear interpolation, ignoring padded values
-          val = 0;
-          pad = 8;
-          sum = 0;
-          if ((u >= 0) && (u < this->_input->GetX()) &&
-              (v >= 0) && (v < this->_input->GetY()) &&
-              (w >= 0) && (w < this->_input->GetZ())) {
-            if (this->_input->Get(u, v, w, l) != this->_PaddingValue) {
-              pad--;
-              val += this->_input->Get(u, v, w, l) * w1;
-              sum += w1;
-            }
-          } else {
-            pad--;
-          }
-          if ((u >= 0)   && (u < this->_input->GetX()) &&
-              (v >= 0)   && (v < this->_input->GetY()) &&
-              (w+1 >= 0) && (w+1 < this->_input->GetZ())) {
-            if (this->_input->Get(u, v, w+1, l) != this->_PaddingValue) {
-              pad--;
-              val += this->_input->Get(u, v, w+1, l) * w2;
-              sum += w2;
-            }
-          } else {
-            pad--;
-          }
-          if ((u >= 0)   && (u < this->_input->GetX()) &&
-              (v+1 >= 0) && (v+1 < this->_input->GetY()) &&
-              (w >= 0)   && (w < this->_input->GetZ())) {
-            if (this->_input->Get(u, v+1, w, l) != this->_PaddingValue) {
-              pad--;
-              val += this->_input->Get(u, v+1, w, l) * w3;
-              sum += w3;
-            }
-          } else {
-            pad--;
-          }
-          if ((u >= 0)   && (u < this->_input->GetX()) &&
-              (v+1 >= 0) && (v+1 < this->_input->GetY()) &&
-              (w+1 >= 0) && (w+1 < this->_input->GetZ())) {
-            if (this->_input->Get(u, v+1, w+1, l) != this->_PaddingValue) {
-              pad--;
-              val += this->_input->Get(u, v+1, w+1, l) * w4;
-              sum += w4;
-            }
-          } else {
-            pad--;
-          }
-          if ((u+1 >= 0) && (u+1 < this->_input->GetX()) &&
-              (v >= 0)   && (v < this->_input->GetY()) &&
-              (w >= 0)   && (w < this->_input->GetZ())) {
-            if (this->_input->Get(u+1, v, w, l) != this->_PaddingValue) {
-              pad--;
-              val += this->_input->Get(u+1, v, w, l) * w5;
-              sum += w5;
-            }
-          } else {
-            pad--;
-          }
-          if ((u+1 >= 0) && (u+1 < this->_input->GetX()) &&
-              (v >= 0)   && (v < this->_input->GetY()) &&
-              (w+1 >= 0) && (w+1 < this->_input->GetZ())) {
-            if (this->_input->Get(u+1, v, w+1, l) != this->_PaddingValue) {
-              pad--;
-              val += this->_input->Get(u+1, v, w+1, l) * w6;
-              sum += w6;
-            }
-          } else {
-            pad--;
-          }
-          if ((u+1 >= 0) && (u+1 < this->_input->GetX()) &&
-              (v+1 >= 0) && (v+1 < this->_input->GetY()) &&
-              (w >= 0)   && (w < this->_input->GetZ())) {
-            if (this->_input->Get(u+1, v+1, w, l) != this->_PaddingValue) {
-              pad--;
-              val += this->_input->Get(u+1, v+1, w, l) * w7;
-              sum += w7;
-            }
-          } else {
-            pad--;
-          }
-          if ((u+1 >= 0) && (u+1 < this->_input->GetX()) &&
-              (v+1 >= 0) && (v+1 < this->_input->GetY()) &&
-              (w+1 >= 0) && (w+1 < this->_input->GetZ())) {
-            if (this->_input->Get(u+1, v+1, w+1, l) != this->_PaddingValue) {
-              pad--;
-              val += this->_input->Get(u+1, v+1, w+1, l) * w8;
-              sum += w8;
-            }
-          } else {
-            pad--;
-          }
-          if (pad < 4) {
-            if (sum > 0) {
-              this->_output->PutAsDouble(i, j, k, l, val / sum);
-            } else {
-              // Special case: Point lies on edge of padded voxels.
-              this->_output->Put(i, j, k, l, this->_PaddingValue);
-              // Rather than:
-              // cerr << this->NameOfClass();
-              // cerr << "::Run: This should never happen" << endl;
-              // exit(1);
-            }
-          } else {
-            this->_output->Put(i, j, k, l, this->_PaddingValue);
-          }
-        }
-      }
-    }
-
-#endif
-
+    irtkParallelFor(blocked_range<int>(0, this->_output->GetZ(), 1),
+                    irtkMultiThreadedResamplingWithPadding<VoxelType>(this->_input, this->_output, this->_IndexMap, this->_PaddingValue, l));
   }
 
 #ifdef HAS_TBB
@@ -426,8 +228,6 @@ template <class VoxelType> void irtkResamplingWithPadding<VoxelType>::Run()
   tick_count t_end = tick_count::now();
   if (tbb_debug) cout << this->NameOfClass() << " = " << (t_end - t_start).seconds() << " secs." << endl;
 #endif
-  init.terminate();
-
 #endif
 
   // Do the final cleaning up
@@ -39,11 +39,11 @@ template <class VoxelType> const char *irtkUniformNoise<VoxelType>::NameOfClass(
 
 template <class VoxelType> double irtkUniformNoise<VoxelType>::Run(int x, int y, int z, int t)
 {
-  boost::mt19937 rng;
-  rng.seed(this->_Init);
+  // Seeded per voxel, the filter may run the voxels in any order and in parallel
+  boost::minstd_rand rng(this->Seed(x, y, z, t));
 
   boost::uniform_int<> ud(0, this->_Amplitude);
-  boost::variate_generator<boost::mt19937&,
+  boost::variate_generator<boost::minstd_rand&,
 			   boost::uniform_int<> > uni_engine(rng, ud);
   return double(this->_input->Get(x, y, z, t)) + uni_engine();
 }
@@ -472,7 +472,6 @@ void irtkImageRegistration::Run()
     }
 
 #ifdef HAS_TBB
-    task_scheduler_init init(tbb_no_threads);
 #if USE_TIMING
     tick_count t_start = tick_count::now();
 #endif
@@ -510,8 +509,6 @@ void irtkImageRegistration::Run()
     tick_count t_end = tick_count::now();
     if (tbb_debug) cout << this->NameOfClass() << " = " << (t_end - t_start).seconds() << " secs." << endl;
 #endif
-    init.terminate();
-
 #endif
 
     // Do the final cleaning up for this level
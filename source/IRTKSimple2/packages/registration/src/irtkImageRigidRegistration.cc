@@ -319,7 +319,7 @@ double irtkImageRigidRegistration::Evaluate()
 
 #ifdef HAS_TBB
   irtkMultiThreadedImageRigidRegistrationEvaluate evaluate(this);
-  parallel_reduce(blocked_range<int>(0, _target->GetZ(), 20), evaluate);
+  irtkParallelReduce(blocked_range<int>(0, _target->GetZ(), 20), evaluate);
 #else
 
   for (t = 0; t < _target->GetT(); t++) {
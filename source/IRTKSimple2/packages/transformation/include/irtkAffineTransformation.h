@@ -370,6 +370,7 @@ inline const char *irtkAffineTransformation::NameOfClass()
 inline void irtkAffineTransformation::PutMatrix(const irtkMatrix &matrix)
 {
   _matrix = matrix;
+  this->UpdateAffine();
   this->UpdateParameter();
 }
 
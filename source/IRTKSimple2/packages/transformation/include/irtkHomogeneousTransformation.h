@@ -38,6 +38,13 @@ protected:
   /// 4 x 4 transformation matrix for homogeneous coordinates
   irtkMatrix _matrix;
 
+  /// Copy of the first three rows of _matrix for fast point transforms
+  double _affine[3][4];
+
+  /** Updates _affine from _matrix. Must be called whenever _matrix has
+   *  been modified. */
+  void UpdateAffine();
+
 public:
 
   /// Constructor (default)
@@ -67,9 +74,21 @@ public:
   /// Puts the transformation matrix (Argument is not checked)
   virtual void      PutMatrix(const irtkMatrix &);
 
+  /// Gets the transformation matrix into a fixed size array
+  void GetMatrix4x4(double [4][4]) const;
+
+  /// Puts the transformation matrix from a fixed size array
+  virtual void PutMatrix4x4(const double [4][4]);
+
+  /// Post-multiplies the transformation matrix with the one of another transformation
+  void PostMultiply(const irtkHomogeneousTransformation &);
+
   /// Transforms a single point
   virtual void Transform(double &, double &, double &, double = 0);
 
+  /// Transforms n points in place
+  virtual void Transform(int, double *, double *, double *, double = 0);
+
   /// Transforms a point using the global transformation component only
   virtual void GlobalTransform(double &, double &, double &, double = 0);
 
@@ -143,6 +162,7 @@ inline irtkHomogeneousTransformation::irtkHomogeneousTransformation()
 
   // Initialize to identity
   _matrix.Ident();
+  this->UpdateAffine();
 
   // Allocate memory for DOF status
   _status = new _Status[this->NumberOfDOFs()];
@@ -158,6 +178,7 @@ inline irtkHomogeneousTransformation::irtkHomogeneousTransformation(const irtkMa
   int i;
 
   _matrix = matrix;
+  this->UpdateAffine();
 
   // Allocate memory for DOF status
   _status = new _Status[this->NumberOfDOFs()];
@@ -173,6 +194,7 @@ inline irtkHomogeneousTransformation::irtkHomogeneousTransformation(const irtkHo
   int i;
 
   _matrix = t._matrix;
+  this->UpdateAffine();
 
   // Allocate memory for DOF status
   _status = new _Status[this->NumberOfDOFs()];
@@ -187,9 +209,21 @@ inline irtkHomogeneousTransformation::~irtkHomogeneousTransformation()
 {
 }
 
+inline void irtkHomogeneousTransformation::UpdateAffine()
+{
+  int i, j;
+
+  for (i = 0; i < 3; i++) {
+    for (j = 0; j < 4; j++) {
+      _affine[i][j] = _matrix(i, j);
+    }
+  }
+}
+
 inline void irtkHomogeneousTransformation::PutMatrix(const irtkMatrix &matrix)
 {
   _matrix = matrix;
+  this->UpdateAffine();
 }
 
 inline irtkMatrix irtkHomogeneousTransformation::GetMatrix() const
@@ -197,6 +231,32 @@ inline irtkMatrix irtkHomogeneousTransformation::GetMatrix() const
   return _matrix;
 }
 
+inline void irtkHomogeneousTransformation::GetMatrix4x4(double m[4][4]) const
+{
+  int i, j;
+
+  for (i = 0; i < 4; i++) {
+    for (j = 0; j < 4; j++) {
+      m[i][j] = _matrix(i, j);
+    }
+  }
+}
+
+inline void irtkHomogeneousTransformation::Transform(double &x, double &y, double &z, double)
+{
+  double a, b, c;
+
+  // Pre-multiply point with transformation matrix
+  a = _affine[0][0]*x+_affine[0][1]*y+_affine[0][2]*z+_affine[0][3];
+  b = _affine[1][0]*x+_affine[1][1]*y+_affine[1][2]*z+_affine[1][3];
+  c = _affine[2][0]*x+_affine[2][1]*y+_affine[2][2]*z+_affine[2][3];
+
+  // Copy result back
+  x = a;
+  y = b;
+  z = c;
+}
+
 inline void irtkHomogeneousTransformation::GlobalTransform(double &x, double &y, double &z, double t)
 {
   this->Transform(x, y, z, t);
@@ -169,6 +169,9 @@ public:
   /// Puts the transformation matrix (transformation parameters are updated)
   virtual void PutMatrix(const irtkMatrix &);
 
+  /// Puts the transformation matrix from a fixed size array (transformation parameters are updated)
+  virtual void PutMatrix4x4(const double [4][4]);
+
   /// Updates transformation matrix
   virtual void UpdateMatrix();
 
@@ -312,6 +315,13 @@ inline double irtkRigidTransformation::GetTranslationZ()
 inline void irtkRigidTransformation::PutMatrix(const irtkMatrix &matrix)
 {
   _matrix = matrix;
+  this->UpdateAffine();
+  this->UpdateParameter();
+}
+
+inline void irtkRigidTransformation::PutMatrix4x4(const double matrix[4][4])
+{
+  this->irtkHomogeneousTransformation::PutMatrix4x4(matrix);
   this->UpdateParameter();
 }
 
@@ -35,6 +35,8 @@ void irtkAffineTransformation::UpdateMatrix()
   scale(1, 1) = _sy / 100.0;
   scale(2, 2) = _sz / 100.0;
   _matrix *= scale;
+
+  this->UpdateAffine();
 }
 
 /// Construct a matrix based on parameters passed in the array.
@@ -34,6 +34,7 @@ void irtkHomogeneousTransformation::Put(int index, double x)
     i = index/4;
     j = index%4;
     _matrix(i, j) = x;
+    this->UpdateAffine();
   } else {
     cerr << "irtkHomogeneousTransformation::Put: No such dof" << endl;
     exit(1);
@@ -75,19 +76,56 @@ void irtkHomogeneousTransformation::Print()
   _matrix.Print();
 }
 
-void irtkHomogeneousTransformation::Transform(double &x, double &y, double &z, double)
+void irtkHomogeneousTransformation::Transform(int n, double *x, double *y, double *z, double)
 {
+  int i;
   double a, b, c;
 
-  // Pre-multiply point with transformation matrix
-  a = (_matrix(0, 0)*x+_matrix(0, 1)*y+_matrix(0, 2)*z+_matrix(0, 3));
-  b = (_matrix(1, 0)*x+_matrix(1, 1)*y+_matrix(1, 2)*z+_matrix(1, 3));
-  c = (_matrix(2, 0)*x+_matrix(2, 1)*y+_matrix(2, 2)*z+_matrix(2, 3));
+  // Copy matrix to locals so that the loop does not reload it
+  const double m00 = _affine[0][0], m01 = _affine[0][1], m02 = _affine[0][2], m03 = _affine[0][3];
+  const double m10 = _affine[1][0], m11 = _affine[1][1], m12 = _affine[1][2], m13 = _affine[1][3];
+  const double m20 = _affine[2][0], m21 = _affine[2][1], m22 = _affine[2][2], m23 = _affine[2][3];
+
+  for (i = 0; i < n; i++) {
+    a = m00*x[i]+m01*y[i]+m02*z[i]+m03;
+    b = m10*x[i]+m11*y[i]+m12*z[i]+m13;
+    c = m20*x[i]+m21*y[i]+m22*z[i]+m23;
+    x[i] = a;
+    y[i] = b;
+    z[i] = c;
+  }
+}
 
-  // Copy result back
-  x = a;
-  y = b;
-  z = c;
+void irtkHomogeneousTransformation::PutMatrix4x4(const double m[4][4])
+{
+  int i, j;
+
+  // Write into the existing 4 x 4 matrix without reallocating it
+  if ((_matrix.Rows() != 4) || (_matrix.Cols() != 4)) _matrix.Initialize(4, 4);
+  for (i = 0; i < 4; i++) {
+    for (j = 0; j < 4; j++) {
+      _matrix(i, j) = m[i][j];
+    }
+  }
+  this->UpdateAffine();
+}
+
+void irtkHomogeneousTransformation::PostMultiply(const irtkHomogeneousTransformation &t)
+{
+  int i, j, k;
+  double a[4][4], b[4][4], c[4][4];
+
+  this->GetMatrix4x4(a);
+  t.GetMatrix4x4(b);
+  for (i = 0; i < 4; i++) {
+    for (j = 0; j < 4; j++) {
+      c[i][j] = 0;
+      for (k = 0; k < 4; k++) {
+        c[i][j] += a[i][k] * b[k][j];
+      }
+    }
+  }
+  this->PutMatrix4x4(c);
 }
 
 void irtkHomogeneousTransformation::Displacement(double &x, double &y, double &z, double)
@@ -95,9 +133,9 @@ void irtkHomogeneousTransformation::Displacement(double &x, double &y, double &z
   double a, b, c;
 
   // Pre-multiply point with transformation matrix
-  a = (_matrix(0, 0)*x+_matrix(0, 1)*y+_matrix(0, 2)*z+_matrix(0, 3));
-  b = (_matrix(1, 0)*x+_matrix(1, 1)*y+_matrix(1, 2)*z+_matrix(1, 3));
-  c = (_matrix(2, 0)*x+_matrix(2, 1)*y+_matrix(2, 2)*z+_matrix(2, 3));
+  a = _affine[0][0]*x+_affine[0][1]*y+_affine[0][2]*z+_affine[0][3];
+  b = _affine[1][0]*x+_affine[1][1]*y+_affine[1][2]*z+_affine[1][3];
+  c = _affine[2][0]*x+_affine[2][1]*y+_affine[2][2]*z+_affine[2][3];
 
   // Copy result back
   x = a - x;
@@ -147,6 +185,7 @@ void irtkHomogeneousTransformation::Invert()
 {
   // Invert transformation
   _matrix.Invert();
+  this->UpdateAffine();
 }
 
 void irtkHomogeneousTransformation::Jacobian(irtkMatrix &jac, double, double, double, double)
@@ -145,7 +145,6 @@ void irtkImageHomogeneousTransformation::Run()
   iterator((irtkHomogeneousTransformation *)this->_transformation);
 
 #ifdef HAS_TBB
-  task_scheduler_init init(tbb_no_threads);
 #if USE_TIMING
   tick_count t_start = tick_count::now();
 #endif
@@ -157,7 +156,7 @@ void irtkImageHomogeneousTransformation::Run()
     if ((t >= 0) && (t < this->_input->GetT())) {
 
 #ifdef HAS_TBB
-      parallel_for(blocked_range<int>(0, this->_output->GetZ(), 1), irtkMultiThreadedImageHomogeneousTransformation(this, l, t));
+      irtkParallelFor(blocked_range<int>(0, this->_output->GetZ(), 1), irtkMultiThreadedImageHomogeneousTransformation(this, l, t));
 #else
 
     	// Initialize iterator
@@ -202,8 +201,6 @@ void irtkImageHomogeneousTransformation::Run()
   tick_count t_end = tick_count::now();
   if (tbb_debug) cout << "irtkImageHomogeneousTransformation = " << (t_end - t_start).seconds() << " secs." << endl;
 #endif
-  init.terminate();
-
 #endif
 
   // Invert transformation
@@ -243,7 +243,6 @@ void irtkImageTransformation::Run()
   _interpolator->Initialize();
 
 #ifdef HAS_TBB
-  task_scheduler_init init(tbb_no_threads);
 #if USE_TIMING
   tick_count t_start = tick_count::now();
 #endif
@@ -256,7 +255,7 @@ void irtkImageTransformation::Run()
     if ((t >= 0) && (t < this->_input->GetT())) {
 
 #ifdef HAS_TBB
-      parallel_for(blocked_range<int>(0, _output->GetZ(), 1), irtkMultiThreadedImageTransformation(this, l, t));
+      irtkParallelFor(blocked_range<int>(0, _output->GetZ(), 1), irtkMultiThreadedImageTransformation(this, l, t));
 #else
 
       double time = this->_output->ImageToTime(l);
@@ -317,8 +316,6 @@ void irtkImageTransformation::Run()
   tick_count t_end = tick_count::now();
   if (tbb_debug) cout << "irtkImageTransformation = " << (t_end - t_start).seconds() << " secs." << endl;
 #endif
-  init.terminate();
-
 #endif
 
 }
@@ -50,6 +50,8 @@ void irtkRigidTransformation::UpdateMatrix()
   _matrix(2,2) = _cosrx*_cosry;
   _matrix(2,3) = _tz;
   _matrix(3,3) = 1.0;
+
+  this->UpdateAffine();
 }
 
 /// Construct a matrix based on parameters passed in the array.
@@ -238,9 +240,9 @@ void irtkRigidTransformation::Rotate(double& x, double& y, double& z)
   double a, b, c;
 
   // Pre-multiply point with transformation matrix
-  a = _matrix(0, 0)*x+_matrix(0, 1)*y+_matrix(0, 2)*z;
-  b = _matrix(1, 0)*x+_matrix(1, 1)*y+_matrix(1, 2)*z;
-  c = _matrix(2, 0)*x+_matrix(2, 1)*y+_matrix(2, 2)*z;
+  a = _affine[0][0]*x+_affine[0][1]*y+_affine[0][2]*z;
+  b = _affine[1][0]*x+_affine[1][1]*y+_affine[1][2]*z;
+  c = _affine[2][0]*x+_affine[2][1]*y+_affine[2][2]*z;
 
   // Copy result back
   x = a;
@@ -0,0 +1,357 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+// Accuracy guard for changes of the CPU reconstruction path. A small
+// synthetic case is reconstructed and the volume, slice weights and slice
+// transformations are compared with stored references, next to the wall
+// time of the run and of the reference run.
+
+#include <irtkImage.h>
+#include <irtkTransformation.h>
+#include <irtkReconstructionGPU.h>
+#include <irtkSyntheticPhantom.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#include <boost/program_options.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+namespace po = boost::program_options;
+namespace pt = boost::posix_time;
+
+using namespace std;
+
+/// The bundled case: stacks, slices per stack, stack resolution, volume
+/// resolution, motion, noise, seed and registration-reconstruction iterations
+const double CASE[] = { 3, 30, 2, 2, 1, 20, 1, 3 };
+const int CASE_SIZE = sizeof(CASE) / sizeof(CASE[0]);
+
+/// Reconstruction iterations of the first and the last iteration
+const int REC_ITERATIONS_FIRST = 3;
+const int REC_ITERATIONS_LAST = 5;
+
+struct Result
+{
+  irtkRealImage reconstructed;
+  irtkRealImage mask;
+  vector<double> weights;
+  vector<irtkRigidTransformation> transformations;
+  double seconds;
+};
+
+/// The CPU path of reconstruction.cc with its default parameters
+static void reconstruct(Result &result)
+{
+  vector<irtkRealImage> stacks;
+  vector<irtkRigidTransformation> stack_transformations;
+  vector<double> thickness;
+  irtkSyntheticPhantom phantom((int)CASE[0], (int)CASE[1], CASE[2], CASE[4], CASE[5], (int)CASE[6]);
+  phantom.Simulate(stacks, stack_transformations, thickness);
+  int iterations = (int)CASE[7];
+  const double delta = 150, lambda = 0.02, lastIterLambda = 0.01;
+  const int levels = 3;
+
+  pt::ptime start = pt::microsec_clock::local_time();
+
+  irtkReconstruction reconstruction(vector<int>(), true);
+  reconstruction.CreateTemplate(stacks[0], CASE[3]);
+  irtkRealImage mask = reconstruction.GetReconstructed();
+  irtkSyntheticPhantom::Sample(mask, true);
+  reconstruction.SetMask(&mask, 4);
+  reconstruction.MatchStackIntensitiesWithMasking(stacks, stack_transformations, 700);
+  reconstruction.CreateSlicesAndTransformations(stacks, stack_transformations, thickness);
+  reconstruction.MaskSlices();
+  reconstruction.SetSigma(12);
+  reconstruction.CropSlices();
+  reconstruction.GlobalBiasCorrectionOff();
+  reconstruction.InitializeEM();
+
+  for (int iter = 0; iter < iterations; iter++) {
+    if (iter > 0)
+      reconstruction.SliceToVolumeRegistration();
+
+    if (iter == (iterations - 1))
+      reconstruction.SetSmoothingParameters(delta, lastIterLambda);
+    else
+    {
+      double l = lambda;
+      for (int i = 0; i < levels; i++)
+      {
+        if (iter == iterations*(levels - i - 1) / levels)
+          reconstruction.SetSmoothingParameters(delta, l);
+        l *= 2;
+      }
+    }
+    if (iter < (iterations - 1))
+      reconstruction.SpeedupOn();
+    else
+      reconstruction.SpeedupOff();
+
+    reconstruction.InitializeEMValues();
+    reconstruction.CoeffInit();
+    reconstruction.GaussianReconstruction();
+    reconstruction.SimulateSlices();
+    reconstruction.InitializeRobustStatistics();
+    reconstruction.EStep();
+
+    int rec_iterations = (iter == (iterations - 1)) ? REC_ITERATIONS_LAST : REC_ITERATIONS_FIRST;
+    for (int i = 0; i < rec_iterations; i++) {
+      reconstruction.Bias();
+      reconstruction.Scale();
+      reconstruction.Superresolution(i + 1);
+      reconstruction.NormaliseBias(i);
+      reconstruction.SimulateSlices();
+      reconstruction.MStep(i + 1);
+      reconstruction.EStep();
+    }
+    reconstruction.MaskVolume();
+  }
+  reconstruction.RestoreSliceIntensities();
+  reconstruction.ScaleVolume();
+
+  result.seconds = (pt::microsec_clock::local_time() - start).total_microseconds() / 1e6;
+  result.reconstructed = reconstruction.GetReconstructed();
+  result.mask = reconstruction.GetMask();
+  reconstruction.GetSliceWeights(result.weights);
+  reconstruction.GetTransformations(result.transformations);
+}
+
+/// PSNR (peak of the reference) and normalised cross-correlation inside the mask
+static void compare(const irtkRealImage &image, const irtkRealImage &reference, const irtkRealImage &mask,
+  double &psnr, double &ncc)
+{
+  double peak = 0, sse = 0, sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+  int n = 0;
+  const irtkRealPixel *pi = image.GetPointerToVoxels();
+  const irtkRealPixel *pr = reference.GetPointerToVoxels();
+  const irtkRealPixel *pm = mask.GetPointerToVoxels();
+  for (int i = 0; i < image.GetNumberOfVoxels(); i++) {
+    if (pm[i] <= 0) continue;
+    double x = pi[i], y = pr[i];
+    if (y > peak) peak = y;
+    sse += (x - y) * (x - y);
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    syy += y * y;
+    sxy += x * y;
+    n++;
+  }
+  if (n == 0) {
+    psnr = ncc = 0;
+    return;
+  }
+  //identical volumes are reported as 200 dB
+  psnr = (sse > 0) ? min(20 * log10(peak) - 10 * log10(sse / n), 200.0) : 200;
+  double vx = sxx - sx * sx / n, vy = syy - sy * sy / n;
+  ncc = ((vx > 0) && (vy > 0)) ? (sxy - sx * sy / n) / sqrt(vx * vy) : 1;
+}
+
+static void writeReference(const string &dir, const Result &result)
+{
+  irtkGenericImage<float> reconstructed(result.reconstructed);
+  reconstructed.Write((dir + "/reconstructed.nii.gz").c_str());
+
+  string name = dir + "/reference.txt";
+  ofstream out(name.c_str());
+  if (!out) {
+    cerr << "Can't open file " << name << endl;
+    exit(1);
+  }
+  out << setprecision(10);
+  out << "accuracyReconstruction 1" << endl << "case";
+  for (int i = 0; i < CASE_SIZE; i++) out << " " << CASE[i];
+  out << endl << "seconds " << result.seconds << endl;
+  out << "slices " << result.weights.size() << endl;
+  for (size_t i = 0; i < result.weights.size(); i++) {
+    const irtkRigidTransformation &t = result.transformations[i];
+    out << result.weights[i] << " " << t.GetTranslationX() << " " << t.GetTranslationY() << " " << t.GetTranslationZ()
+      << " " << t.GetRotationX() << " " << t.GetRotationY() << " " << t.GetRotationZ() << endl;
+  }
+}
+
+static void readReference(const string &dir, Result &result)
+{
+  result.reconstructed.Read((dir + "/reconstructed.nii.gz").c_str());
+
+  string name = dir + "/reference.txt", word;
+  ifstream in(name.c_str());
+  int version = 0, slices = 0;
+  in >> word >> version;
+  if (!in || (word != "accuracyReconstruction") || (version != 1)) {
+    cerr << name << " is not a reference of accuracyReconstruction" << endl;
+    exit(1);
+  }
+  in >> word;
+  for (int i = 0; i < CASE_SIZE; i++) {
+    double value;
+    in >> value;
+    if (!in || (fabs(value - CASE[i]) > 1e-9)) {
+      cerr << name << " was created for a different case, run with --update" << endl;
+      exit(1);
+    }
+  }
+  in >> word >> result.seconds >> word >> slices;
+  result.weights.resize(slices);
+  result.transformations.resize(slices);
+  for (int i = 0; i < slices; i++) {
+    double tx, ty, tz, rx, ry, rz;
+    in >> result.weights[i] >> tx >> ty >> tz >> rx >> ry >> rz;
+    result.transformations[i].PutTranslationX(tx);
+    result.transformations[i].PutTranslationY(ty);
+    result.transformations[i].PutTranslationZ(tz);
+    result.transformations[i].PutRotationX(rx);
+    result.transformations[i].PutRotationY(ry);
+    result.transformations[i].PutRotationZ(rz);
+  }
+  if (!in) {
+    cerr << "Error reading " << name << endl;
+    exit(1);
+  }
+}
+
+static bool check(ostream &out, const char *name, double value, const char *op, double tolerance, bool passed)
+{
+  out << "  " << left << setw(22) << name << right << setw(12) << value << "  " << op << " " << setw(8) << tolerance
+    << (passed ? "  ok" : "  FAILED") << endl;
+  return passed;
+}
+
+int main(int argc, char **argv)
+{
+  string referenceDir, outputName, logName;
+  bool update = false;
+  int threads = -1;
+  double minPSNR, minNCC, maxWeight, maxTranslation, maxRotation;
+
+  po::options_description desc("Options");
+  desc.add_options()
+    ("help,h", "Print usage messages")
+    ("reference,r", po::value<string>(&referenceDir)->required(), "Folder of the references (data/golden in the repository).")
+    ("update", po::bool_switch(&update)->default_value(false), "Write the references instead of comparing with them.")
+    ("output,o", po::value<string>(&outputName), "JSON file for the results.")
+    ("threads", po::value<int>(&threads), "Number of threads. [Default: all cores]")
+    ("log", po::value<string>(&logName)->default_value("log-accuracy.txt"), "File for the output of the reconstruction.")
+    ("minPSNR", po::value<double>(&minPSNR)->default_value(40), "Minimum PSNR of the volume in dB.")
+    ("minNCC", po::value<double>(&minNCC)->default_value(0.999), "Minimum normalised cross-correlation of the volume.")
+    ("maxWeight", po::value<double>(&maxWeight)->default_value(0.05), "Maximum difference of the slice weights.")
+    ("maxTranslation", po::value<double>(&maxTranslation)->default_value(0.5), "Maximum difference of the slice translations in mm.")
+    ("maxRotation", po::value<double>(&maxRotation)->default_value(0.5), "Maximum difference of the slice rotations in degrees.");
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help"))
+    {
+      cout << "Compare the CPU reconstruction of a synthetic case with stored references." << endl << desc << endl;
+      return EXIT_SUCCESS;
+    }
+    po::notify(vm);
+  }
+  catch (po::error& e)
+  {
+    cerr << "ERROR: " << e.what() << endl << endl << desc << endl;
+    return EXIT_FAILURE;
+  }
+  irtkInitializeParallel(threads);
+
+  //the reconstruction is verbose, keep the report readable
+  ofstream log(logName.c_str());
+  streambuf *strm_buffer = cout.rdbuf();
+  cout.rdbuf(log.rdbuf());
+  Result result;
+  reconstruct(result);
+  cout.rdbuf(strm_buffer);
+
+  if (update) {
+    writeReference(referenceDir, result);
+    cout << "References written to " << referenceDir << " (" << result.seconds << " s)" << endl;
+    return EXIT_SUCCESS;
+  }
+
+  Result reference;
+  readReference(referenceDir, reference);
+  if (!(reference.reconstructed.GetImageAttributes() == result.reconstructed.GetImageAttributes())) {
+    cerr << "The reference volume has a different geometry" << endl;
+    return EXIT_FAILURE;
+  }
+  if (reference.weights.size() != result.weights.size()) {
+    cerr << "The reference has " << reference.weights.size() << " slices instead of " << result.weights.size() << endl;
+    return EXIT_FAILURE;
+  }
+
+  double psnr, ncc, weight = 0, translation = 0, rotation = 0;
+  compare(result.reconstructed, reference.reconstructed, result.mask, psnr, ncc);
+  for (size_t i = 0; i < result.weights.size(); i++) {
+    const irtkRigidTransformation &t = result.transformations[i], &r = reference.transformations[i];
+    weight = max(weight, fabs(result.weights[i] - reference.weights[i]));
+    translation = max(translation, fabs(t.GetTranslationX() - r.GetTranslationX()));
+    translation = max(translation, fabs(t.GetTranslationY() - r.GetTranslationY()));
+    translation = max(translation, fabs(t.GetTranslationZ() - r.GetTranslationZ()));
+    rotation = max(rotation, fabs(t.GetRotationX() - r.GetRotationX()));
+    rotation = max(rotation, fabs(t.GetRotationY() - r.GetRotationY()));
+    rotation = max(rotation, fabs(t.GetRotationZ() - r.GetRotationZ()));
+  }
+
+  //distance to the ground truth, for information
+  irtkRealImage truth = result.reconstructed;
+  irtkSyntheticPhantom::Sample(truth);
+  double psnrTruth, nccTruth, psnrTruthReference, nccTruthReference;
+  compare(result.reconstructed, truth, result.mask, psnrTruth, nccTruth);
+  compare(reference.reconstructed, truth, result.mask, psnrTruthReference, nccTruthReference);
+
+  bool passed = true;
+  cout << "Accuracy against the reference:" << endl;
+  passed &= check(cout, "volume PSNR (dB)", psnr, ">=", minPSNR, psnr >= minPSNR);
+  passed &= check(cout, "volume NCC", ncc, ">=", minNCC, ncc >= minNCC);
+  passed &= check(cout, "slice weights", weight, "<=", maxWeight, weight <= maxWeight);
+  passed &= check(cout, "translations (mm)", translation, "<=", maxTranslation, translation <= maxTranslation);
+  passed &= check(cout, "rotations (deg)", rotation, "<=", maxRotation, rotation <= maxRotation);
+  cout << "Against the phantom: PSNR " << psnrTruth << " dB (reference " << psnrTruthReference << " dB), NCC "
+    << nccTruth << " (reference " << nccTruthReference << ")" << endl;
+  cout << "Wall time: " << result.seconds << " s (reference " << reference.seconds << " s, speedup x"
+    << reference.seconds / result.seconds << ")" << endl;
+  cout << (passed ? "PASSED" : "FAILED") << endl;
+
+  if (!outputName.empty()) {
+    ofstream json(outputName.c_str());
+    json << "{\n  \"passed\": " << (passed ? "true" : "false") << ",\n"
+      << "  \"seconds\": " << result.seconds << ",\n"
+      << "  \"reference_seconds\": " << reference.seconds << ",\n"
+      << "  \"psnr\": " << psnr << ",\n"
+      << "  \"ncc\": " << ncc << ",\n"
+      << "  \"max_weight_difference\": " << weight << ",\n"
+      << "  \"max_translation_difference\": " << translation << ",\n"
+      << "  \"max_rotation_difference\": " << rotation << ",\n"
+      << "  \"psnr_phantom\": " << psnrTruth << ",\n"
+      << "  \"ncc_phantom\": " << nccTruth << "\n}" << endl;
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,137 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+// Microbenchmark of the scalar and batch trilinear interpolation paths of
+// irtkLinearInterpolateImageFunction.
+
+#include <irtkImage.h>
+#include <irtkImageFunction.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+namespace pt = boost::posix_time;
+
+void usage()
+{
+  cerr << "Usage: benchmarkInterpolation [size] [points] [repetitions]\n\n";
+  cerr << "  size         Edge length of the random test volume (default 128)\n";
+  cerr << "  points       Number of random sample locations (default 1000000)\n";
+  cerr << "  repetitions  Number of passes over the locations (default 10)\n";
+  exit(1);
+}
+
+static double seconds(const pt::ptime &start)
+{
+  return (pt::microsec_clock::local_time() - start).total_microseconds() / 1e6;
+}
+
+template <class VoxelType>
+void benchmark(const char *name, int size, int points, int repetitions)
+{
+  irtkGenericImage<VoxelType> image(size, size, size);
+  VoxelType *ptr = image.GetPointerToVoxels();
+  for (int i = 0; i < image.GetNumberOfVoxels(); i++) {
+    ptr[i] = static_cast<VoxelType>(rand() % 1000);
+  }
+
+  // Random locations, about 10% of them outside the field of view
+  std::vector<double> x(points), y(points), z(points);
+  for (int i = 0; i < points; i++) {
+    x[i] = (rand() / (double)RAND_MAX) * (size + 0.1 * size) - 0.05 * size - 0.5;
+    y[i] = (rand() / (double)RAND_MAX) * (size - 1);
+    z[i] = (rand() / (double)RAND_MAX) * (size - 1);
+  }
+
+  irtkLinearInterpolateImageFunction interpolator;
+  interpolator.SetInput(&image);
+  interpolator.Initialize();
+  interpolator.SetDefaultValue(-1);
+
+  // The scalar path as used by the filters: FOV test, then virtual Evaluate
+  irtkImageFunction *function = &interpolator;
+  std::vector<double> scalar(points), batch(points), row(points);
+  double xmax = size - 0.5;
+  pt::ptime start = pt::microsec_clock::local_time();
+  for (int r = 0; r < repetitions; r++) {
+    for (int i = 0; i < points; i++) {
+      if ((x[i] > -0.5) && (x[i] < xmax) && (y[i] > -0.5) && (y[i] < xmax) && (z[i] > -0.5) && (z[i] < xmax)) {
+        scalar[i] = function->Evaluate(x[i], y[i], z[i]);
+      } else {
+        scalar[i] = -1;
+      }
+    }
+  }
+  double t_scalar = seconds(start);
+
+  start = pt::microsec_clock::local_time();
+  for (int r = 0; r < repetitions; r++) {
+    interpolator.EvaluateBatch(points, &x[0], &y[0], &z[0], &batch[0]);
+  }
+  double t_batch = seconds(start);
+
+  // Rows of the volume sampled with a small oblique step
+  int rows = points / size;
+  start = pt::microsec_clock::local_time();
+  for (int r = 0; r < repetitions; r++) {
+    for (int j = 0; j < rows; j++) {
+      interpolator.EvaluateRow(size, -0.3, j % size, (j / size) % size, 1.01, 0.003, 0.002, &row[j * size]);
+    }
+  }
+  double t_row = seconds(start);
+
+  double error = 0;
+  for (int i = 0; i < points; i++) {
+    error = max(error, fabs(scalar[i] - batch[i]));
+  }
+
+  double mpoints = double(points) * repetitions / 1e6;
+  double mrows = double(rows) * size * repetitions / 1e6;
+  cout << name << ":" << endl;
+  cout << "  scalar Evaluate : " << mpoints / t_scalar << " Mpoints/s" << endl;
+  cout << "  EvaluateBatch   : " << mpoints / t_batch << " Mpoints/s (x" << t_scalar / t_batch << ")" << endl;
+  cout << "  EvaluateRow     : " << mrows / t_row << " Mpoints/s" << endl;
+  cout << "  max |scalar - batch| = " << error << endl;
+}
+
+int main(int argc, char **argv)
+{
+  int size = 128, points = 1000000, repetitions = 10;
+
+  if (argc > 4) usage();
+  if (argc > 1) size = atoi(argv[1]);
+  if (argc > 2) points = atoi(argv[2]);
+  if (argc > 3) repetitions = atoi(argv[3]);
+  if ((size < 2) || (points < 1) || (repetitions < 1)) usage();
+
+  srand(0);
+  benchmark<irtkRealPixel>("double", size, points, repetitions);
+  benchmark<irtkGreyPixel>("short", size, points, repetitions);
+  benchmark<float>("float", size, points, repetitions);
+
+  return 0;
+}
@@ -0,0 +1,250 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+// Stage-level benchmark of the CPU reconstruction path on a synthetic
+// fetal-like phantom. The acquisitions are simulated with slice-wise rigid
+// motion and Rician noise and are reproducible for a given seed, so no GPU
+// and no input data is needed.
+
+#include <irtkImage.h>
+#include <irtkTransformation.h>
+#include <irtkReconstructionGPU.h>
+#include <irtkSyntheticPhantom.h>
+#include <perfstats.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+#include <boost/program_options.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+namespace po = boost::program_options;
+namespace pt = boost::posix_time;
+
+using namespace std;
+
+struct Settings
+{
+  int stacks;
+  double resolution;
+  double reconResolution;
+  double motion;
+  double noise;
+  int seed;
+  int repetitions;
+  bool pinThreads;
+  string numaPolicy;
+};
+
+static double seconds(const pt::ptime &start)
+{
+  return (pt::microsec_clock::local_time() - start).total_microseconds() / 1e6;
+}
+
+/// Time each stage of one reconstruction iteration, the best of the
+/// repetitions is reported
+static void benchmark(const Settings &s, int slices, int threads, ofstream &json, bool first)
+{
+  vector<irtkRealImage> stacks;
+  vector<irtkRigidTransformation> stack_transformations;
+  vector<double> thickness;
+  irtkSyntheticPhantom phantom(s.stacks, slices, s.resolution, s.motion, s.noise, s.seed);
+  phantom.Simulate(stacks, stack_transformations, thickness);
+
+  irtkInitializeParallel(threads, s.pinThreads, s.numaPolicy.c_str());
+
+  const char *names[] = { "CoeffInit", "GaussianReconstruction", "SimulateSlices", "EStep",
+    "Bias", "Superresolution", "MStep", "SliceToVolumeRegistration" };
+  //PerfStats keys of the load imbalance of the stages with per-slice loops
+  const char *imbalanceKeys[] = { "CoeffInit", "", "SimulateSlices", "EStep",
+    "Bias", "Superresolution", "MStep", "Registration/SliceToVolume" };
+  const int stages = sizeof(names) / sizeof(names[0]);
+  vector<double> best(stages, -1), imbalance(stages, 0);
+  int sliceCount = 0, voxels = 0;
+
+  for (int r = 0; r < s.repetitions; r++) {
+    PerfStats::instance().reset();
+    irtkReconstruction reconstruction(vector<int>(), true);
+    reconstruction.SetSmoothingParameters(150, 0.02);
+    reconstruction.CreateTemplate(stacks[0], s.reconResolution);
+
+    irtkRealImage mask = reconstruction.GetReconstructed();
+    irtkSyntheticPhantom::Sample(mask, true);
+    reconstruction.SetMask(&mask, 4);
+    reconstruction.CreateSlicesAndTransformations(stacks, stack_transformations, thickness);
+    reconstruction.MaskSlices();
+    reconstruction.SetSigma(12);
+    reconstruction.CropSlices();
+    reconstruction.InitializeEM();
+    reconstruction.InitializeEMValues();
+
+    double t[stages];
+    pt::ptime start = pt::microsec_clock::local_time();
+    reconstruction.CoeffInit();
+    t[0] = seconds(start);
+    start = pt::microsec_clock::local_time();
+    reconstruction.GaussianReconstruction();
+    t[1] = seconds(start);
+    start = pt::microsec_clock::local_time();
+    reconstruction.SimulateSlices();
+    t[2] = seconds(start);
+    reconstruction.InitializeRobustStatistics();
+    start = pt::microsec_clock::local_time();
+    reconstruction.EStep();
+    t[3] = seconds(start);
+    start = pt::microsec_clock::local_time();
+    reconstruction.Bias();
+    t[4] = seconds(start);
+    reconstruction.Scale();
+    start = pt::microsec_clock::local_time();
+    reconstruction.Superresolution(1);
+    t[5] = seconds(start);
+    reconstruction.SimulateSlices();
+    start = pt::microsec_clock::local_time();
+    reconstruction.MStep(1);
+    t[6] = seconds(start);
+    start = pt::microsec_clock::local_time();
+    reconstruction.SliceToVolumeRegistration();
+    t[7] = seconds(start);
+
+    for (int i = 0; i < stages; i++) {
+      if ((best[i] < 0) || (t[i] < best[i])) {
+        best[i] = t[i];
+        if (imbalanceKeys[i][0] != '\0')
+          imbalance[i] = PerfStats::instance().get(string(imbalanceKeys[i]) + "/imbalance").max();
+      }
+    }
+    irtkRealImage reconstructed = reconstruction.GetReconstructed();
+    voxels = reconstructed.GetNumberOfVoxels();
+    sliceCount = 0;
+    for (size_t i = 0; i < stacks.size(); i++) sliceCount += stacks[i].GetZ();
+  }
+
+  json << (first ? "" : ",\n") << "    {\"slices\": " << slices << ", \"threads\": " << threads
+    << ", \"total_slices\": " << sliceCount << ", \"volume_voxels\": " << voxels << ", \"seconds\": {";
+  double total = 0;
+  for (int i = 0; i < stages; i++) {
+    json << (i ? ", " : "") << "\"" << names[i] << "\": " << best[i];
+    total += best[i];
+  }
+  json << ", \"total\": " << total << "}, \"imbalance\": {";
+  bool firstStage = true;
+  for (int i = 0; i < stages; i++) {
+    if (imbalanceKeys[i][0] == '\0') continue;
+    json << (firstStage ? "" : ", ") << "\"" << names[i] << "\": " << imbalance[i];
+    firstStage = false;
+  }
+  json << "}}";
+  cerr << "slices " << slices << " threads " << threads << ": " << total << " s" << endl;
+}
+
+int main(int argc, char **argv)
+{
+  Settings s;
+  vector<int> sizes, threads;
+  string outputName, logName;
+
+  po::options_description desc("Options");
+  desc.add_options()
+    ("help,h", "Print usage messages")
+    ("output,o", po::value<string>(&outputName)->default_value("benchmark.json"), "JSON file for the timings.")
+    ("sizes", po::value< vector<int> >(&sizes)->multitoken(), "[n_1] .. [n_N] Problem sizes as number of slices per stack. [Default: 30 60]")
+    ("threads", po::value< vector<int> >(&threads)->multitoken(), "[t_1] .. [t_N] Thread counts. [Default: 1 and all cores]")
+    ("stacks", po::value<int>(&s.stacks)->default_value(3), "Number of simulated stacks.")
+    ("resolution", po::value<double>(&s.resolution)->default_value(1.5), "In-plane resolution of the stacks in mm.")
+    ("reconResolution", po::value<double>(&s.reconResolution)->default_value(1.5), "Isotropic resolution of the reconstructed volume in mm.")
+    ("motion", po::value<double>(&s.motion)->default_value(2), "Standard deviation of the slice motion in mm and degrees.")
+    ("noise", po::value<double>(&s.noise)->default_value(20), "Amplitude of the Rician noise, 0 for none.")
+    ("seed", po::value<int>(&s.seed)->default_value(1), "Seed of the simulated motion and noise.")
+    ("repetitions", po::value<int>(&s.repetitions)->default_value(1), "Repetitions of each configuration, the fastest is reported.")
+    ("pinThreads", po::bool_switch(&s.pinThreads)->default_value(false), "Pin the threads to cores.")
+    ("numa", po::value<string>(&s.numaPolicy), "[default|interleave|first-touch] Memory placement on NUMA systems.")
+    ("log", po::value<string>(&logName)->default_value("log-benchmark.txt"), "File for the output of the reconstruction.");
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help"))
+    {
+      cout << "Benchmark of the CPU reconstruction stages on a synthetic phantom." << endl << desc << endl;
+      return EXIT_SUCCESS;
+    }
+    po::notify(vm);
+  }
+  catch (po::error& e)
+  {
+    cerr << "ERROR: " << e.what() << endl << endl << desc << endl;
+    return EXIT_FAILURE;
+  }
+  irtkInitializeParallel(0, s.pinThreads, s.numaPolicy.c_str());
+
+  if (sizes.empty()) {
+    sizes.push_back(30);
+    sizes.push_back(60);
+  }
+  if (threads.empty()) {
+    threads.push_back(1);
+    if (task_scheduler_init::default_num_threads() > 1)
+      threads.push_back(task_scheduler_init::default_num_threads());
+  }
+  if ((s.stacks < 1) || (s.resolution <= 0) || (s.reconResolution <= 0) || (s.repetitions < 1)) {
+    cerr << desc << endl;
+    return EXIT_FAILURE;
+  }
+
+  ofstream json(outputName.c_str());
+  if (!json) {
+    cerr << "Can't open file " << outputName << endl;
+    return EXIT_FAILURE;
+  }
+  json << "{\n  \"benchmark\": \"reconstruction\",\n"
+    << "  \"phantom\": {\"stacks\": " << s.stacks << ", \"resolution\": " << s.resolution
+    << ", \"reconResolution\": " << s.reconResolution << ", \"motion\": " << s.motion
+    << ", \"noise\": " << s.noise << ", \"seed\": " << s.seed << ", \"repetitions\": " << s.repetitions << "},\n"
+    << "  \"pinThreads\": " << (tbb_pin_threads ? "true" : "false") << ", \"numa\": \""
+    << ((tbb_numa_policy == NUMA_Interleave) ? "interleave" : (tbb_numa_policy == NUMA_FirstTouch) ? "first-touch" : "default") << "\",\n"
+    << "  \"runs\": [\n";
+
+  //the reconstruction is verbose, keep the timings readable
+  ofstream log(logName.c_str());
+  streambuf *strm_buffer = cout.rdbuf();
+  cout.rdbuf(log.rdbuf());
+
+  bool first = true;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    for (size_t j = 0; j < threads.size(); j++) {
+      benchmark(s, sizes[i], threads[j], json, first);
+      first = false;
+    }
+  }
+
+  cout.rdbuf(strm_buffer);
+  json << "\n  ]\n}" << endl;
+  cout << "Timings written to " << outputName << endl;
+
+  return EXIT_SUCCESS;
+}
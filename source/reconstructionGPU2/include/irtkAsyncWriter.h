@@ -0,0 +1,173 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+#ifndef _irtkAsyncWriter_H
+#define _irtkAsyncWriter_H
+
+#include <irtkImage.h>
+#include <irtkTransformation.h>
+
+#include <deque>
+#include <vector>
+
+#if !USE_BOOST
+//use c++11 in std in case of VS 2012
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#else
+#include <boost/thread.hpp>
+#include <boost/thread/condition_variable.hpp>
+#endif
+
+/*
+
+Background writer for intermediate and debug outputs
+
+Write() takes a snapshot of an image or transformation (or ownership of a
+heap allocated image) and returns immediately; the files are written by
+the writer threads while computation continues. Snapshots are released
+once written. If the snapshots in the queue exceed the memory limit,
+Write() blocks until enough of them have been written (backpressure).
+Flush() waits until all queued files have been written. With zero threads
+all files are written synchronously.
+
+*/
+
+class irtkAsyncWriter
+{
+#if !USE_BOOST
+  typedef std::mutex Mutex;
+  typedef std::unique_lock<std::mutex> Lock;
+  typedef std::condition_variable Condition;
+  typedef std::thread Thread;
+#else
+  typedef boost::mutex Mutex;
+  typedef boost::unique_lock<boost::mutex> Lock;
+  typedef boost::condition_variable Condition;
+  typedef boost::thread Thread;
+#endif
+
+  /// Pending write of a single file
+  class Job
+  {
+  public:
+    string _filename;
+    Job(const char *filename) : _filename(filename) { }
+    virtual ~Job() { }
+    virtual void Write() = 0;
+    virtual size_t Size() const = 0;
+  };
+
+  template <class VoxelType> class ImageJob : public Job
+  {
+    irtkGenericImage<VoxelType> *_image;
+  public:
+    ImageJob(irtkGenericImage<VoxelType> *image, const char *filename) : Job(filename), _image(image) { }
+    ~ImageJob() { delete _image; }
+    void Write() { _image->Write(this->_filename.c_str()); }
+    size_t Size() const { return _image->GetNumberOfVoxels() * sizeof(VoxelType); }
+  };
+
+  class TransformationJob : public Job
+  {
+    irtkRigidTransformation _transformation;
+  public:
+    TransformationJob(const irtkRigidTransformation &transformation, const char *filename) : Job(filename), _transformation(transformation) { }
+    void Write() { _transformation.irtkTransformation::Write((char *)this->_filename.c_str()); }
+    size_t Size() const { return sizeof(irtkRigidTransformation); }
+  };
+
+  /// Jobs waiting to be written
+  std::deque<Job *> _queue;
+
+  /// Memory held by queued and active jobs
+  size_t _queuedBytes;
+
+  /// Memory limit for queued jobs before Write() blocks
+  size_t _maxQueuedBytes;
+
+  /// Number of jobs currently written
+  int _active;
+
+  /// Number of files which could not be written
+  int _failed;
+
+  /// Set to terminate the writer threads
+  bool _stop;
+
+  Mutex _mutex;
+  Condition _jobAvailable, _spaceAvailable, _idle;
+  std::vector<Thread *> _threads;
+
+  /// Writes and deletes job, returns false if the file could not be written
+  static bool Execute(Job *);
+
+  /// Adds job to the queue, or writes it directly without threads
+  void Enqueue(Job *);
+
+  /// Main loop of the writer threads
+  void Run();
+
+public:
+
+  ///Constructor (0 threads: write synchronously)
+  irtkAsyncWriter(int threads = 1, size_t maxQueuedBytes = size_t(1024) * 1024 * 1024);
+  ///Destructor, writes all queued files
+  ~irtkAsyncWriter();
+
+  ///Write copy of image in the background
+  template <class VoxelType> void Write(const irtkGenericImage<VoxelType> &image, const char *filename);
+
+  ///Write image in the background, taking ownership of the image
+  template <class VoxelType> void Write(irtkGenericImage<VoxelType> *image, const char *filename);
+
+  ///Write copy of transformation in the background
+  void Write(const irtkRigidTransformation &transformation, const char *filename);
+
+  ///Wait until all queued files have been written
+  void Flush();
+
+  ///Return number of files which could not be written
+  int GetNumberOfFailedWrites();
+};
+
+template <class VoxelType> inline void irtkAsyncWriter::Write(const irtkGenericImage<VoxelType> &image, const char *filename)
+{
+  this->Enqueue(new ImageJob<VoxelType>(new irtkGenericImage<VoxelType>(image), filename));
+}
+
+template <class VoxelType> inline void irtkAsyncWriter::Write(irtkGenericImage<VoxelType> *image, const char *filename)
+{
+  this->Enqueue(new ImageJob<VoxelType>(image, filename));
+}
+
+inline void irtkAsyncWriter::Write(const irtkRigidTransformation &transformation, const char *filename)
+{
+  this->Enqueue(new TransformationJob(transformation, filename));
+}
+
+#endif
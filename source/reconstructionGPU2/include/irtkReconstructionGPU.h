@@ -33,11 +33,14 @@
 #include <irtkGaussianBlurring.h>
 
 #include "reconstruction_cuda2.cuh"
+#include "irtkSliceArena.h"
 
 
 #include <vector>
 using namespace std;
 
+class irtkAsyncWriter;
+
 /*
 
 Reconstruction of volume from 2D slices
@@ -64,6 +67,9 @@ protected:
   std::vector<SLICECOEFFS> _volcoeffs;
 
   //SLICES
+  /// Contiguous storage of the per-slice images used by the CPU EM, declared
+  /// before them such that it outlives their views
+  irtkSliceArena _slice_arena;
   /// Slices
   vector<irtkRealImage> _slices;
   vector<irtkRealImage> _simulated_slices;
@@ -71,6 +77,10 @@ protected:
   vector<irtkRealImage> _simulated_inside;
 
   vector<irtkRealImage> _slices_resampled;
+  /// Geometry of the slices before CropSlices and offset of the crop
+  vector<irtkImageAttributes> _uncropped_attr;
+  vector<int> _crop_x;
+  vector<int> _crop_y;
 
   vector<double> _slices_regCertainty;
   std::vector<Matrix4> _transf;
@@ -81,6 +91,11 @@ protected:
   /// Indicator whether slice has an overlap with volumetric mask
   vector<bool> _slice_inside_cpu;
   vector<bool> _slice_inside_gpu;
+  /// Estimated work of each slice in CoeffInit and the EM stages: PSF
+  /// coefficients of the last CoeffInit, valid pixels before the first
+  vector<double> _slice_cost;
+  /// Time of the last registration of each slice, valid pixels before the first
+  vector<double> _registration_cost;
 
   //VOLUME
   /// Reconstructed volume
@@ -180,6 +195,15 @@ protected:
   //slices identify as too small to be used
   vector<int> _small_slices;
 
+  /// Valid (unpadded) pixels of each slice as offsets i + j * x, in the
+  /// order of the per-pixel loops (i outer, j inner)
+  vector<vector<int> > _active_pixels;
+  /// Slices processed by the EM stages: neither force-excluded nor small
+  vector<size_t> _em_slices;
+  /// EM slices contributing to the volume: overlap with the mask and
+  /// positive slice weight
+  vector<size_t> _active_slices;
+
   /// use adaptive or non-adaptive regularisation (default:false)
   bool _adaptive;
 
@@ -187,6 +211,19 @@ protected:
   ///Debug mode
   bool _debug;
 
+  ///Background writer for saved slices, weights, bias fields and transformations (NULL: write directly)
+  irtkAsyncWriter *_writer;
+
+  ///Folder of the slice-volume matrix cache (empty: no cache)
+  string _coeff_cache;
+
+  ///Hash of everything the slice-volume matrix depends on
+  unsigned long long CoeffCacheKey();
+  ///Load slice-volume matrix from cache file, returns false if it does not match
+  bool ReadCoeffCache(const char *filename);
+  ///Save slice-volume matrix to cache file
+  void WriteCoeffCache(const char *filename);
+
 
   //Probability density functions
   ///Zero-mean Gaussian PDF
@@ -305,6 +342,13 @@ public:
   ///Mask all slices
   void MaskSlices();
 
+  ///Crop slices to the bounding box of their valid pixels plus the margin of
+  ///the bias field blurring, call after MaskSlices and SetSigma (CPU only)
+  void CropSlices();
+
+  ///Slice with the geometry it had before CropSlices, padded with -1
+  irtkRealImage GetUncroppedSlice(int inputIndex) const;
+
   ///Calculate transformation matrix between slices and voxels
   void CoeffInit();
 
@@ -314,6 +358,9 @@ public:
   ///Initialise variables and parameters for EM
   void InitializeEM();
 
+  ///Update the lists of slices processed by the EM stages
+  void UpdateActiveSlices();
+
   ///Initialise values of variables and parameters for EM
   void InitializeEMValues();
 
@@ -356,14 +403,20 @@ public:
 
   ///Save slices
   void SaveSlices();
+  ///Save slices packed into one 4D image
+  void SaveSlices(const char *filename);
   void SlicesInfo(const char* filename);
 
   ///Save weights
   void SaveWeights();
+  void SaveWeights(const char *filename);
 
   ///Save transformations
   void SaveTransformations();
+  ///Save slice geometry, stack index and transformations into one slice table
+  void SaveTransformations(const char *filename);
   void GetTransformations(vector<irtkRigidTransformation> &transformations);
+  void GetSliceWeights(vector<double> &weights);
   void SetTransformations(vector<irtkRigidTransformation> &transformations);
 
   ///Save confidence map
@@ -415,6 +468,12 @@ public:
 
   inline void setUseNMI();
 
+  ///Write outputs in the background with the given writer (NULL: write directly)
+  inline void SetAsyncWriter(irtkAsyncWriter *writer);
+
+  ///Cache the slice-volume matrix of CoeffInit in the given folder
+  inline void SetCoeffCache(const char *folder);
+
   inline void UseAdaptiveRegularisation();
 
   ///Write included/excluded/outside slices
@@ -423,9 +482,25 @@ public:
 
   /// Read Transformations
   void ReadTransformation(char* folder);
+  /// Read Transformations from slice table
+  void ReadTransformationTable(const char* filename);
+
+  /// Print current and predicted memory of the CPU reconstruction structures
+  /// for the EM iterations with the given number of threads, returns the
+  /// predicted total and the current total in bytes
+  double MemoryReport(ostream &out, int threads, double &current);
+
+  /// Write state at the end of outer iteration (iteration - 1) to binary checkpoint:
+  /// slice transformations, mask and volume. The EM state is not saved, as
+  /// every iteration initialises it again from these.
+  void WriteCheckpoint(const char *filename, int iteration);
+  /// Restore state from binary checkpoint, returns the iteration to continue with
+  int ReadCheckpoint(const char *filename);
 
   /// Read and replace Slices
   void replaceSlices(string folder);
+  /// Replace slices, stack indices and transformations with packed slices and slice table
+  void replaceSlices(const char* filename, const char* table);
 
   /// transforms a manual slice-by-slice stack 
   /// segmetnation into reconstruction space
@@ -512,6 +587,7 @@ public:
   friend class ParallelStackRegistrations;
   friend class ParallelSliceToVolumeRegistration;
   friend class ParallelCoeffInit;
+  friend class ParallelCoeffCacheLoad;
   friend class ParallelSuperresolution;
   friend class ParallelMStep;
   friend class ParallelEStep;
@@ -519,6 +595,7 @@ public:
   friend class ParallelScale;
   friend class ParallelNormaliseBias;
   friend class ParallelSimulateSlices;
+  friend class ParallelSliceInside;
   friend class ParallelAverage;
   friend class ParallelSliceAverage;
   friend class ParallelAdaptiveRegularization1;
@@ -558,6 +635,16 @@ inline void irtkReconstruction::setUseNMI()
   cout << "Going to use NMI for slice to volume registration!" << endl;
 }
 
+inline void irtkReconstruction::SetAsyncWriter(irtkAsyncWriter *writer)
+{
+  _writer = writer;
+}
+
+inline void irtkReconstruction::SetCoeffCache(const char *folder)
+{
+  _coeff_cache = folder;
+}
+
 inline void irtkReconstruction::UseAdaptiveRegularisation()
 {
   _adaptive = true;
@@ -0,0 +1,108 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+#ifndef _irtkSliceArena_H
+#define _irtkSliceArena_H
+
+#include <irtkImage.h>
+
+#include <vector>
+
+/*
+
+Structure-of-arrays storage of per-slice images
+
+All slices of one field (slices, weights, bias fields, ...) are stored in
+one contiguous, 64 byte aligned block, with slice l at the offset of entry
+l of a side table shared by all fields. The irtkRealImage objects of the
+fields become views of the blocks (see irtkGenericImage::View), such that
+existing code keeps working on them, while assigning an image of the same
+size writes into the block instead of reallocating. Slices are copied into
+the blocks in parallel, which places their pages on the NUMA node of the
+thread working on them under a first-touch policy.
+
+*/
+
+class irtkSliceArena
+{
+public:
+
+  /// Side table entry of one slice
+  struct Entry
+  {
+    /// Offset of the first voxel in the block of a field
+    size_t offset;
+    /// Geometry of the slice
+    irtkImageAttributes attr;
+  };
+
+  irtkSliceArena();
+
+  ~irtkSliceArena();
+
+  /** Moves the images of all fields into one block per field and makes
+   *  them views of it. All fields must have the same number of slices
+   *  and slice sizes. Previously attached images must either be attached
+   *  again or have been reallocated, as the old blocks are freed. */
+  void Attach(const std::vector<std::vector<irtkRealImage> *> &fields);
+
+  /// Frees all blocks, attached images must not be used afterwards
+  void Clear();
+
+  /// Number of fields
+  int NumberOfFields() const { return (int)_blocks.size(); }
+
+  /// Number of slices
+  int NumberOfSlices() const { return (int)_table.size(); }
+
+  /// Side table entry of a slice
+  const Entry &GetEntry(int slice) const { return _table[slice]; }
+
+  /// Bytes allocated for all fields
+  size_t Size() const { return _size * sizeof(irtkRealPixel) * _blocks.size(); }
+
+private:
+
+  /// Voxels of one field including alignment padding
+  size_t _size;
+
+  /// Side table of all slices
+  std::vector<Entry> _table;
+
+  /// Block of each field
+  std::vector<irtkRealPixel *> _blocks;
+
+  /// Bytes of the blocks counted by irtkMemoryStatistics
+  long _countedSize;
+
+  /// Images are views of the blocks, copies are not supported
+  irtkSliceArena(const irtkSliceArena &);
+  irtkSliceArena &operator=(const irtkSliceArena &);
+
+  friend class ParallelSliceArenaCopy;
+};
+
+#endif
@@ -0,0 +1,96 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+#ifndef _irtkSliceContainer_H
+#define _irtkSliceContainer_H
+
+#include <irtkImage.h>
+#include <irtkTransformation.h>
+
+#include <vector>
+
+/*
+
+Packed container for per-slice outputs
+
+Instead of one file per slice, all slices of an artefact type (slices or
+weights) are packed into the frames of one 4D image (frame l
+holds slice l, zero padded to the largest slice), and the geometry, stack
+index and transformations of all slices are stored in one binary table of
+fixed size records. Slices can be read back individually by index. Reading
+all slices is done in parallel if the image is uncompressed or an indexed
+gzip file (see irtkCofstream::SetCompressionIndex).
+
+*/
+
+class irtkSliceContainer
+{
+public:
+
+  /// Table entry of one slice
+  struct Record
+  {
+    int stackIndex;
+    int x, y;
+    int reserved;
+    double dx, dy, dz;
+    double xorigin, yorigin, zorigin;
+    double xaxis[3], yaxis[3], zaxis[3];
+    /// Slice transformation (tx, ty, tz, rx, ry, rz)
+    double dofs[6];
+    /// Slice voxel to reconstructed voxel matrix (row major)
+    double sliceToVolume[16];
+  };
+
+  ///Create table entry of a slice
+  static Record MakeRecord(const irtkRealImage &slice, int stackIndex, irtkRigidTransformation &transformation, const irtkMatrix &sliceToVolume);
+
+  ///Image attributes of slice
+  static irtkImageAttributes GetImageAttributes(const Record &record);
+
+  ///Slice transformation
+  static irtkRigidTransformation GetTransformation(const Record &record);
+
+  ///Write table
+  static void WriteTable(const char *filename, const std::vector<Record> &records);
+
+  ///Read table
+  static void ReadTable(const char *filename, std::vector<Record> &records);
+
+  ///Read table entry of a single slice
+  static Record ReadRecord(const char *filename, int index);
+
+  ///Pack slices into the frames of a 4D image (full precision, as the per-slice files)
+  static irtkRealImage *Pack(const std::vector<irtkRealImage> &images);
+
+  ///Read all slices of a packed 4D image
+  static void ReadImages(const char *filename, const std::vector<Record> &records, std::vector<irtkRealImage> &images);
+
+  ///Read a single slice of a packed 4D image
+  static void ReadImage(const char *filename, const Record &record, int index, irtkRealImage &image);
+};
+
+#endif
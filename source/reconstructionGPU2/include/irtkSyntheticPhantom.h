@@ -0,0 +1,82 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+#ifndef _irtkSyntheticPhantom_H
+#define _irtkSyntheticPhantom_H
+
+#include <irtkImage.h>
+#include <irtkTransformation.h>
+
+#include <vector>
+
+/*
+
+Synthetic fetal-like head phantom
+
+The phantom is an analytic T2-like head (extra-axial CSF, cortex, white
+matter, cerebellum, two lateral ventricles and a few lesions) centred at
+the origin. Acquisitions are
+simulated as stacks of thick slices in axial, coronal and sagittal
+orientation with a random rigid motion per slice and Rician noise. The
+result only depends on the parameters and the seed.
+
+*/
+
+class irtkSyntheticPhantom
+{
+  int _stacks;
+  int _slices;
+  double _resolution;
+  double _motion;
+  double _noise;
+  int _seed;
+
+public:
+
+  /// Field of view of the simulated stacks in mm
+  static const double FOV;
+
+  /// stacks of the given number of slices and in-plane resolution (mm),
+  /// motion is the standard deviation of the slice motion (mm and degrees)
+  /// and noise the amplitude of the Rician noise
+  irtkSyntheticPhantom(int stacks = 3, int slices = 30, double resolution = 1.5,
+    double motion = 2, double noise = 20, int seed = 1);
+
+  /// Intensity of the phantom at a world position (mm)
+  static double Value(double x, double y, double z);
+
+  /// Sample the phantom on the grid of image, or its support if mask is set
+  static void Sample(irtkRealImage &image, bool mask = false);
+
+  /// Simulate the stacks with identity stack transformations, the slice
+  /// motion is returned in motion if given
+  void Simulate(std::vector<irtkRealImage> &stacks,
+    std::vector<irtkRigidTransformation> &stack_transformations,
+    std::vector<double> &thickness,
+    std::vector<irtkRigidTransformation> *motion = NULL) const;
+};
+
+#endif
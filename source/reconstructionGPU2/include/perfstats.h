@@ -41,71 +41,374 @@
 #include <boost/format.hpp>
 namespace pt = boost::posix_time;
 
+#ifdef HAS_TBB
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/spin_mutex.h>
+#endif
+
+/**
+ * Timers and counters of the reconstruction stages.
+ *
+ * Keys are paths like "SliceToVolumeRegistration/slice". Scoped timers
+ * (PerfStats::Timer) nest in the scopes of their thread; timers and counters
+ * of TBB worker threads are nested in the current scope of the thread that
+ * called start(). Every thread records into its own buffer, the buffers are
+ * merged when the statistics are printed or exported.
+ *
+ * Memory gauges (e.g. resident set size) registered with memory() are sampled
+ * with every stage sample and printed as a table of the stages.
+ *
+ * With trace(true) the timers and stage samples are also kept as events of a
+ * timeline, which writeTrace() exports in the Chrome trace event format
+ * (chrome://tracing, Perfetto).
+ */
 struct PerfStats {
-  enum Type { TIME, COUNT, PERCENTAGE };
+  enum Type { TIME, COUNT, PERCENTAGE, COUNTER, MEMORY };
+
+  /// Returns a current value, e.g. a memory size in bytes
+  typedef double (*Gauge)();
   struct Stats {
     std::vector<double> data;
     Type type;
     double sum() const { return std::accumulate(data.begin(), data.end(), 0.0); }
     double average() const { return sum() / std::max(data.size(), size_t(1)); }
-    double max() const { return *std::max_element(data.begin(), data.end()); }
-    double min() const { return *std::min_element(data.begin(), data.end()); }
+    double max() const { return data.empty() ? 0 : *std::max_element(data.begin(), data.end()); }
+    double min() const { return data.empty() ? 0 : *std::min_element(data.begin(), data.end()); }
+  };
+
+  /// Timeline event, times in microseconds since the epoch
+  struct Event {
+    std::string name;
+    long index;
+    double begin, end;
+  };
+
+  /// Samples, open scopes and timeline events of one thread
+  struct Buffer {
+    std::map<std::string, Stats> stats;
+    std::vector<std::string> scopes;
+    std::vector<Event> events;
+    int tid;
+    Buffer() : tid(0) { }
+  };
+
+  /// Times the lifetime of the object as a nested scope. Timers with an index
+  /// (e.g. the slice processed by a TBB task, shown in the trace) are tasks,
+  /// which never become the parent of the timers of other threads
+  class Timer {
+    PerfStats &_perf;
+    pt::ptime _start;
+    long _index;
+  public:
+    Timer(const std::string &name, long index = -1, PerfStats &perf = PerfStats::instance()) : _perf(perf), _start(get_time()), _index(index) { _perf.push(name, index >= 0); }
+    ~Timer() { _perf.pop((get_time() - _start).total_microseconds() / 1000000.0, _index); }
   };
 
-  std::map<std::string, Stats> stats;
+#ifdef HAS_TBB
+  tbb::enumerable_thread_specific<Buffer> buffers;
+  tbb::spin_mutex mutex;
+#else
+  Buffer buffer;
+#endif
+  Buffer *owner;
+  std::string root;
   pt::ptime last;
+  int threads;
+  bool tracing;
+  double traceStart;
+  std::vector<std::pair<std::string, Gauge> > gauges;
+
+  PerfStats() : owner(NULL), threads(0), tracing(false), traceStart(0) { }
+
+  /// Statistics shared by the application and the reconstruction library
+  static PerfStats &instance() {
+    static PerfStats perf;
+    return perf;
+  }
 
   static pt::ptime get_time() {
     return pt::microsec_clock::local_time();
   }
 
+  /// Time of timeline events, microseconds since the epoch (UTC like gettimeofday)
+  static double trace_time() {
+    static const pt::ptime epoch(boost::gregorian::date(1970, 1, 1));
+    return double((pt::microsec_clock::universal_time() - epoch).total_microseconds());
+  }
+
   void sample(const std::string& key, double t, Type type = COUNT) {
-    Stats& s = stats[key];
+    Stats& s = local().stats[path(key)];
     s.data.push_back(t);
     s.type = type;
   }
   pt::ptime start(void){
+    owner = &local();
     last = get_time();
     return last;
   }
   pt::ptime sample(const std::string &key){
     const pt::ptime now = get_time();
     pt::time_duration diff = now - last;
-    sample(key, diff.total_milliseconds() / 1000.0, TIME);
+    sample(key, diff.total_microseconds() / 1000000.0, TIME);
+    for (size_t i = 0; i < gauges.size(); i++)
+      sample(key + "/" + gauges[i].first, gauges[i].second(), MEMORY);
+    if (tracing) {
+      double end = trace_time();
+      event(path(key), end - diff.total_microseconds(), end);
+    }
     last = now;
     return now;
   }
-  const Stats& get(const std::string& key) const { return stats.find(key)->second; }
-  void reset(void) { stats.clear(); }
+  /// Adds n to a counter which is reported as total, e.g. voxels or calls
+  void count(const std::string &key, double n = 1) {
+    Stats& s = local().stats[path(key)];
+    if (s.data.empty()) s.data.push_back(0);
+    s.data[0] += n;
+    s.type = COUNTER;
+  }
+  /// Registers a memory size in bytes sampled at the end of each stage
+  void memory(const std::string &name, Gauge gauge) {
+    gauges.push_back(std::make_pair(name, gauge));
+  }
+  /// Switches recording of timeline events on or off
+  void trace(bool on) {
+    if (on && !tracing) traceStart = trace_time();
+    tracing = on;
+  }
+  /// Adds an event of the calling thread to the timeline
+  void event(const std::string &name, double begin, double end, long index = -1) {
+    if (!tracing) return;
+    Event e;
+    e.name = name;
+    e.index = index;
+    e.begin = begin;
+    e.end = end;
+    local().events.push_back(e);
+  }
+  void push(const std::string &name, bool task = false);
+  void pop(double t, long index = -1);
+  std::map<std::string, Stats> merged() const;
+  Stats get(const std::string& key) const;
+  void reset(void);
   void reset(const std::string & key);
   void print(std::ostream& out = std::cout) const;
+  void writeJSON(std::ostream& out) const;
+  void writeCSV(std::ostream& out) const;
+  void writeTrace(std::ostream& out) const;
+
+private:
+  Buffer &local() {
+#ifdef HAS_TBB
+    bool exists;
+    Buffer &b = buffers.local(exists);
+    if (!exists) {
+      tbb::spin_mutex::scoped_lock lock(mutex);
+      b.tid = ++threads;
+    }
+    return b;
+#else
+    buffer.tid = 1;
+    return buffer;
+#endif
+  }
+  std::string path(const std::string &key) {
+    Buffer &b = local();
+    if (!b.scopes.empty()) return b.scopes.back() + "/" + key;
+    if (&b == owner) return key;
+#ifdef HAS_TBB
+    tbb::spin_mutex::scoped_lock lock(mutex);
+#endif
+    return root.empty() ? key : root + "/" + key;
+  }
+  static const char *typeName(Type type) {
+    switch (type) {
+    case TIME: return "time";
+    case PERCENTAGE: return "percentage";
+    case COUNTER: return "counter";
+    case MEMORY: return "memory";
+    default: return "count";
+    }
+  }
 };
 
+inline void PerfStats::push(const std::string &name, bool task){
+  std::string p = path(name);
+  Buffer &b = local();
+  b.scopes.push_back(p);
+  if (&b == owner && !task) {
+#ifdef HAS_TBB
+    tbb::spin_mutex::scoped_lock lock(mutex);
+#endif
+    root = p;
+  }
+}
+
+inline void PerfStats::pop(double t, long index){
+  Buffer &b = local();
+  if (b.scopes.empty()) return;
+  Stats& s = b.stats[b.scopes.back()];
+  s.data.push_back(t);
+  s.type = TIME;
+  if (tracing) {
+    double end = trace_time();
+    event(b.scopes.back(), end - t * 1000000.0, end, index);
+  }
+  b.scopes.pop_back();
+  if (&b == owner && index < 0) {
+#ifdef HAS_TBB
+    tbb::spin_mutex::scoped_lock lock(mutex);
+#endif
+    root = b.scopes.empty() ? std::string() : b.scopes.back();
+  }
+}
+
+inline std::map<std::string, PerfStats::Stats> PerfStats::merged() const {
+  std::map<std::string, Stats> all;
+#ifdef HAS_TBB
+  for (tbb::enumerable_thread_specific<Buffer>::const_iterator b = buffers.begin(); b != buffers.end(); ++b){
+#else
+  for (const Buffer *b = &buffer; b != &buffer + 1; ++b){
+#endif
+    for (std::map<std::string, Stats>::const_iterator it = b->stats.begin(); it != b->stats.end(); it++){
+      Stats& s = all[it->first];
+      s.type = it->second.type;
+      if (s.type == COUNTER && !s.data.empty())
+        s.data[0] += it->second.sum();
+      else
+        s.data.insert(s.data.end(), it->second.data.begin(), it->second.data.end());
+    }
+  }
+  return all;
+}
+
+inline PerfStats::Stats PerfStats::get(const std::string& key) const {
+  return merged()[key];
+}
+
+inline void PerfStats::reset(void){
+#ifdef HAS_TBB
+  for (tbb::enumerable_thread_specific<Buffer>::iterator b = buffers.begin(); b != buffers.end(); ++b){
+#else
+  for (Buffer *b = &buffer; b != &buffer + 1; ++b){
+#endif
+    b->stats.clear();
+    b->events.clear();
+  }
+}
+
 inline void PerfStats::reset(const std::string & key){
-  std::map<std::string, Stats>::iterator s = stats.find(key);
-  if (s != stats.end())
-    s->second.data.clear();
+#ifdef HAS_TBB
+  for (tbb::enumerable_thread_specific<Buffer>::iterator b = buffers.begin(); b != buffers.end(); ++b){
+#else
+  for (Buffer *b = &buffer; b != &buffer + 1; ++b){
+#endif
+    std::map<std::string, Stats>::iterator s = b->stats.find(key);
+    if (s != b->stats.end())
+      s->second.data.clear();
+  }
 }
 
 inline void PerfStats::print(std::ostream& out) const {
-  std::cout.precision(10);
+  std::map<std::string, Stats> stats = merged();
+  out.precision(10);
   for (std::map<std::string, Stats>::const_iterator it = stats.begin(); it != stats.end(); it++){
-    out << it->first << ":";
-    out << std::string("\t\t\t").substr(0, 3 - ((it->first.size() + 1) >> 3));
+    if (it->second.type == MEMORY) continue;
+    //children are indented below their parent stage
+    size_t depth = std::count(it->first.begin(), it->first.end(), '/');
+    std::string name = std::string(2 * depth, ' ') + it->first.substr(it->first.rfind('/') + 1);
+    out << name << ":";
+    out << std::string("\t\t\t").substr(0, 3 - std::min(size_t(3), (name.size() + 1) >> 3));
     switch (it->second.type){
     case TIME: {
-      out << it->second.average()*1000.0 << " ms" << "\t(max = " << it->second.max() * 1000 << " ms" << ")\n";
+      out << it->second.average()*1000.0 << " ms" << "\t(max = " << it->second.max() * 1000 << " ms, n = " << it->second.data.size() << ")\n";
     } break;
     case COUNT: {
-      out << it->second.average() << " ms" << "\t(max = " << it->second.max() << " ms" << " )\n";
+      out << it->second.average() << "\t(max = " << it->second.max() << ")\n";
     } break;
     case PERCENTAGE: {
-      out << it->second.average()*100.0 << " ms" << "%\t(max = " << it->second.max() * 100 << " ms" << " %)\n";
+      out << it->second.average()*100.0 << " %" << "\t(max = " << it->second.max() * 100 << " %)\n";
+    } break;
+    case COUNTER: {
+      out << it->second.sum() << "\n";
     } break;
+    default: break;
     }
   }
+
+  //table of the maximum of each gauge at the end of each stage
+  if (gauges.empty()) return;
+  out << "\nmemory (MB) at the end of the stages\nstage";
+  for (size_t i = 0; i < gauges.size(); i++) out << "\t" << gauges[i].first;
+  out << "\n";
+  std::map<std::string, bool> rows;
+  for (std::map<std::string, Stats>::const_iterator it = stats.begin(); it != stats.end(); it++)
+    if (it->second.type == MEMORY) rows[it->first.substr(0, it->first.rfind('/'))] = true;
+  out.precision(6);
+  for (std::map<std::string, bool>::const_iterator row = rows.begin(); row != rows.end(); row++){
+    out << row->first;
+    for (size_t i = 0; i < gauges.size(); i++){
+      std::map<std::string, Stats>::const_iterator it = stats.find(row->first + "/" + gauges[i].first);
+      out << "\t" << (it != stats.end() ? it->second.max() / 1048576.0 : 0.0);
+    }
+    out << "\n";
+  }
+}
+
+/// Writes all stages as JSON, times in seconds
+inline void PerfStats::writeJSON(std::ostream& out) const {
+  std::map<std::string, Stats> stats = merged();
+  out.precision(10);
+  out << "{\n  \"stages\": [";
+  for (std::map<std::string, Stats>::const_iterator it = stats.begin(); it != stats.end(); it++){
+    if (it != stats.begin()) out << ",";
+    out << "\n    { \"name\": \"" << it->first << "\", \"type\": \"" << typeName(it->second.type) << "\""
+        << ", \"samples\": " << it->second.data.size()
+        << ", \"sum\": " << it->second.sum()
+        << ", \"average\": " << it->second.average()
+        << ", \"min\": " << it->second.min()
+        << ", \"max\": " << it->second.max() << " }";
+  }
+  out << "\n  ]\n}\n";
 }
 
-extern PerfStats Stats;
+/// Writes all stages as CSV, times in seconds
+inline void PerfStats::writeCSV(std::ostream& out) const {
+  std::map<std::string, Stats> stats = merged();
+  out.precision(10);
+  out << "name,type,samples,sum,average,min,max\n";
+  for (std::map<std::string, Stats>::const_iterator it = stats.begin(); it != stats.end(); it++){
+    out << "\"" << it->first << "\"," << typeName(it->second.type) << "," << it->second.data.size() << ","
+        << it->second.sum() << "," << it->second.average() << "," << it->second.min() << "," << it->second.max() << "\n";
+  }
+}
+
+/// Writes the timeline as Chrome trace events, one complete event per timer
+inline void PerfStats::writeTrace(std::ostream& out) const {
+  out.precision(15);
+  out << "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [";
+  bool first = true;
+#ifdef HAS_TBB
+  for (tbb::enumerable_thread_specific<Buffer>::const_iterator b = buffers.begin(); b != buffers.end(); ++b){
+#else
+  for (const Buffer *b = &buffer; b != &buffer + 1; ++b){
+#endif
+    out << (first ? "" : ",") << "\n    { \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << b->tid
+        << ", \"args\": { \"name\": \"" << (&*b == owner ? "main" : "worker") << "\" } }";
+    first = false;
+    for (std::vector<Event>::const_iterator e = b->events.begin(); e != b->events.end(); ++e){
+      //names are stage paths and file names, escape the characters special to JSON
+      std::string name;
+      for (std::string::const_iterator c = e->name.begin(); c != e->name.end(); ++c){
+        if (*c == '"' || *c == '\\') name += '\\';
+        name += *c;
+      }
+      out << ",\n    { \"name\": \"" << name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << b->tid
+          << ", \"ts\": " << e->begin - traceStart << ", \"dur\": " << e->end - e->begin;
+      if (e->index >= 0) out << ", \"args\": { \"index\": " << e->index << " }";
+      out << " }";
+    }
+  }
+  out << "\n  ]\n}\n";
+}
 
 #endif // PERFSTATS_H
@@ -0,0 +1,147 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+#include "irtkAsyncWriter.h"
+
+irtkAsyncWriter::irtkAsyncWriter(int threads, size_t maxQueuedBytes)
+{
+  _queuedBytes = 0;
+  _maxQueuedBytes = maxQueuedBytes;
+  _active = 0;
+  _failed = 0;
+  _stop = false;
+  for (int i = 0; i < threads; i++)
+  {
+    _threads.push_back(new Thread(&irtkAsyncWriter::Run, this));
+  }
+}
+
+irtkAsyncWriter::~irtkAsyncWriter()
+{
+  Flush();
+  {
+    Lock lock(_mutex);
+    _stop = true;
+  }
+  _jobAvailable.notify_all();
+  for (unsigned int i = 0; i < _threads.size(); i++)
+  {
+    _threads[i]->join();
+    delete _threads[i];
+  }
+  _threads.clear();
+}
+
+bool irtkAsyncWriter::Execute(Job *job)
+{
+  bool ok = true;
+  try {
+    job->Write();
+  }
+  catch (irtkException &) {
+    // Message has been printed by the writer
+    ok = false;
+  }
+  catch (std::exception &e) {
+    cerr << "irtkAsyncWriter: Cannot write " << job->_filename << ": " << e.what() << endl;
+    ok = false;
+  }
+  catch (...) {
+    cerr << "irtkAsyncWriter: Cannot write " << job->_filename << endl;
+    ok = false;
+  }
+  delete job;
+  return ok;
+}
+
+void irtkAsyncWriter::Enqueue(Job *job)
+{
+  size_t size = job->Size();
+
+  if (_threads.empty())
+  {
+    if (!Execute(job)) _failed++;
+    return;
+  }
+
+  {
+    Lock lock(_mutex);
+    // Backpressure: wait for pending writes unless the queue is empty
+    while ((_queuedBytes > 0) && (_queuedBytes + size > _maxQueuedBytes))
+    {
+      _spaceAvailable.wait(lock);
+    }
+    _queue.push_back(job);
+    _queuedBytes += size;
+  }
+  _jobAvailable.notify_one();
+}
+
+void irtkAsyncWriter::Run()
+{
+  while (true)
+  {
+    Job *job;
+    {
+      Lock lock(_mutex);
+      while (_queue.empty() && !_stop)
+      {
+        _jobAvailable.wait(lock);
+      }
+      if (_queue.empty()) return;
+      job = _queue.front();
+      _queue.pop_front();
+      _active++;
+    }
+
+    size_t size = job->Size();
+    bool failed = !Execute(job);
+
+    {
+      Lock lock(_mutex);
+      _queuedBytes -= size;
+      _active--;
+      if (failed) _failed++;
+    }
+    _spaceAvailable.notify_all();
+    _idle.notify_all();
+  }
+}
+
+void irtkAsyncWriter::Flush()
+{
+  Lock lock(_mutex);
+  while (!_queue.empty() || (_active > 0))
+  {
+    _idle.wait(lock);
+  }
+}
+
+int irtkAsyncWriter::GetNumberOfFailedWrites()
+{
+  Lock lock(_mutex);
+  return _failed;
+}
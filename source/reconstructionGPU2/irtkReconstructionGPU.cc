@@ -28,6 +28,9 @@
 #define _USE_MATH_DEFINES
 
 #include <irtkReconstructionGPU.h>
+#include <irtkAsyncWriter.h>
+#include <irtkSliceContainer.h>
+#include <perfstats.h>
 #include <irtkResampling.h>
 #include <irtkRegistration.h>
 #include <irtkImageRigidRegistration.h>
@@ -40,6 +43,16 @@
 #include <stdlib.h>
 #include <irtkDilation.h>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/atomic.h>
+
 #include <boost/filesystem.hpp>
 using namespace boost::filesystem;
 
@@ -160,6 +173,9 @@ irtkReconstruction::irtkReconstruction(std::vector<int> dev, bool useCPUReg)
 {
   _step = 0.0001;
   _debug = false;
+  _debugGPU = false;
+  _writer = NULL;
+  _coeff_cache = "";
   _quality_factor = 2;
   _sigma_bias = 12;
   _sigma_s_cpu = 0.025f;
@@ -215,6 +231,13 @@ irtkReconstruction::irtkReconstruction(std::vector<int> dev, bool useCPUReg)
   }
   else
   {*/
+  //an empty device list gives a CPU-only reconstruction (no CUDA context),
+  //only the CPU code paths may be used then
+  if (dev.empty())
+  {
+    reconstructionGPU = NULL;
+    return;
+  }
     reconstructionGPU = new Reconstruction(dev, true); //to produce the error for CPUReg and multithreaded GPUs
   //}
     reconstructionGPU->_useCPUReg = _useCPUReg;
@@ -227,14 +250,16 @@ irtkReconstruction::~irtkReconstruction(){ }
 void irtkReconstruction::Set_debugGPU(bool val)
 {
   _debugGPU = val;
-  reconstructionGPU->_debugGPU = val;
+  if (reconstructionGPU != NULL)
+    reconstructionGPU->_debugGPU = val;
 }
 
 
 void irtkReconstruction::disableBiasCorrection()
 {
   _disableBiasC = true;
-  reconstructionGPU->_disableBiasC = _disableBiasC;
+  if (reconstructionGPU != NULL)
+    reconstructionGPU->_disableBiasC = _disableBiasC;
 }
 
 
@@ -242,7 +267,8 @@ void irtkReconstruction::disableBiasCorrection()
 //GPU helpers
 void irtkReconstruction::updateStackSizes(std::vector<uint3> stack_sizes_)
 {
-  reconstructionGPU->updateStackSizes(stack_sizes_);
+  if (reconstructionGPU != NULL)
+    reconstructionGPU->updateStackSizes(stack_sizes_);
 }
 
 
@@ -462,77 +488,106 @@ class ParallelAverage{
 
   bool linear;
 
-public:
-  irtkRealImage average;
-  irtkRealImage weights;
+  // Per stack: reconstructed voxel index -> stack voxel index
+  // (image-to-world, rigid transformation, world-to-image fused)
+  vector<irtkMatrix> index_maps;
+
+  double Sample(const irtkRealImage &stack, double x, double y, double z) const {
+    int dx = stack.GetX();
+    int dy = stack.GetY();
+    int dz = stack.GetZ();
+    const irtkRealPixel *ps = stack.GetPointerToVoxels();
+
+    if (!linear) {
+      int i = round(x);
+      int j = round(y);
+      int k = round(z);
+      if ((i < 0) || (i >= dx) || (j < 0) || (j >= dy) || (k < 0) || (k >= dz))
+        return 0;
+      return ps[(k * dy + j) * dx + i];
+    }
 
-  void operator()(const blocked_range<size_t>& r) {
-    for (size_t i = r.begin(); i < r.end(); ++i) {
-      irtkImageTransformation imagetransformation;
-      irtkImageFunction *interpolator;
-      if (linear)
-        interpolator = new irtkLinearInterpolateImageFunction;
-      else
-        interpolator = new irtkNearestNeighborInterpolateImageFunction;
-
-      irtkRealImage s = stacks[i];
-      irtkRigidTransformation t = stack_transformations[i];
-      imagetransformation.SetInput(&s, &t);
-      irtkRealImage image(reconstructor->_reconstructed.GetImageAttributes());
-      image = 0;
-
-      imagetransformation.SetOutput(&image);
-      imagetransformation.PutTargetPaddingValue(targetPadding);
-      imagetransformation.PutSourcePaddingValue(sourcePadding);
-      imagetransformation.PutInterpolator(interpolator);
-      imagetransformation.Run();
-
-      irtkRealPixel *pa = average.GetPointerToVoxels();
-      irtkRealPixel *pi = image.GetPointerToVoxels();
-      irtkRealPixel *pw = weights.GetPointerToVoxels();
-      for (int p = 0; p < average.GetNumberOfVoxels(); p++) {
-        if (*pi != background) {
-          *pa += *pi;
-          *pw += 1;
+    int i = (int)floor(x);
+    int j = (int)floor(y);
+    int k = (int)floor(z);
+
+    double val = 0;
+    for (int n = k; n <= k + 1; n++) {
+      if ((n < 0) || (n >= dz)) continue;
+      double wz = 1 - fabs(n - z);
+      for (int m = j; m <= j + 1; m++) {
+        if ((m < 0) || (m >= dy)) continue;
+        double wyz = (1 - fabs(m - y)) * wz;
+        const irtkRealPixel *row = ps + (n * dy + m) * dx;
+        for (int l = i; l <= i + 1; l++) {
+          if ((l >= 0) && (l < dx))
+            val += (1 - fabs(l - x)) * wyz * row[l];
         }
-        pa++;
-        pi++;
-        pw++;
       }
-      delete interpolator;
     }
+    return val;
   }
 
-  ParallelAverage(ParallelAverage& x, split) :
-    reconstructor(x.reconstructor),
-    stacks(x.stacks),
-    stack_transformations(x.stack_transformations)
-  {
-    average.Initialize(reconstructor->_reconstructed.GetImageAttributes());
-    average = 0;
-    weights.Initialize(reconstructor->_reconstructed.GetImageAttributes());
-    weights = 0;
-    targetPadding = x.targetPadding;
-    sourcePadding = x.sourcePadding;
-    background = x.background;
-    linear = x.linear;
-  }
+  irtkRealImage &average;
+  irtkRealImage &weights;
 
-  void join(const ParallelAverage& y) {
-    average += y.average;
-    weights += y.weights;
+public:
+
+  void operator()(const blocked_range<size_t>& r) const {
+    int dx = average.GetX();
+    int dy = average.GetY();
+    // The target image of each warp used to be a fresh zero image
+    bool inside_target = 0 > targetPadding;
+
+    for (size_t k0 = r.begin(); k0 < r.end(); ++k0) {
+      for (int j0 = 0; j0 < dy; j0++) {
+        irtkRealPixel *pa = average.GetPointerToVoxels(0, j0, k0);
+        irtkRealPixel *pw = weights.GetPointerToVoxels(0, j0, k0);
+        for (unsigned int s = 0; s < stacks.size(); s++) {
+          const irtkMatrix &m = index_maps[s];
+          const irtkRealImage &stack = stacks[s];
+          double xmax = stack.GetX() - 0.5;
+          double ymax = stack.GetY() - 0.5;
+          double zmax = stack.GetZ() - 0.5;
+          // Index of (0, j0, k0) in the stack, stepped along x
+          double x = m(0, 1) * j0 + m(0, 2) * k0 + m(0, 3);
+          double y = m(1, 1) * j0 + m(1, 2) * k0 + m(1, 3);
+          double z = m(2, 1) * j0 + m(2, 2) * k0 + m(2, 3);
+          for (int i0 = 0; i0 < dx; i0++) {
+            double value = sourcePadding;
+            if (inside_target &&
+              (x > -0.5) && (x < xmax) &&
+              (y > -0.5) && (y < ymax) &&
+              (z > -0.5) && (z < zmax)) {
+              value = Sample(stack, x, y, z);
+            }
+            if (value != background) {
+              pa[i0] += value;
+              pw[i0] += 1;
+            }
+            x += m(0, 0);
+            y += m(1, 0);
+            z += m(2, 0);
+          }
+        }
+      }
+    }
   }
 
   ParallelAverage(irtkReconstruction *reconstructor,
     vector<irtkRealImage>& _stacks,
     vector<irtkRigidTransformation>& _stack_transformations,
+    irtkRealImage &_average,
+    irtkRealImage &_weights,
     double _targetPadding,
     double _sourcePadding,
     double _background,
     bool _linear = false) :
     reconstructor(reconstructor),
     stacks(_stacks),
-    stack_transformations(_stack_transformations)
+    stack_transformations(_stack_transformations),
+    average(_average),
+    weights(_weights)
   {
     average.Initialize(reconstructor->_reconstructed.GetImageAttributes());
     average = 0;
@@ -542,14 +597,18 @@ public:
     sourcePadding = _sourcePadding;
     background = _background;
     linear = _linear;
+
+    irtkMatrix i2w = average.GetImageToWorldMatrix();
+    for (unsigned int s = 0; s < stacks.size(); s++) {
+      index_maps.push_back(stacks[s].GetWorldToImageMatrix() *
+        stack_transformations[s].GetMatrix() * i2w);
+    }
   }
 
   // execute
-  void operator() () {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_reduce(blocked_range<size_t>(0, stacks.size()),
+  void operator() () const {
+    irtkParallelFor(blocked_range<size_t>(0, average.GetZ()),
       *this);
-    init.terminate();
   }
 };
 
@@ -616,10 +675,8 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, average.GetZ()),
+    irtkParallelFor(blocked_range<size_t>(0, average.GetZ()),
       *this);
-    init.terminate();
   }
 };
 
@@ -632,14 +689,14 @@ irtkRealImage irtkReconstruction::CreateAverage(vector<irtkRealImage>& stacks,
   }
 
   InvertStackTransformations(stack_transformations);
+  irtkRealImage average, weights;
   ParallelAverage parallelAverage(this,
     stacks,
     stack_transformations,
+    average, weights,
     -1, 0, 0, // target/source/background
     true);
   parallelAverage();
-  irtkRealImage average = parallelAverage.average;
-  irtkRealImage weights = parallelAverage.weights;
   average /= weights;
   InvertStackTransformations(stack_transformations);
   return average;
@@ -887,10 +944,7 @@ public:
       irtkGreyImage source = stacks[i];
 
       //include offset in trasformation   
-      irtkMatrix mo = offset.GetMatrix();
-      irtkMatrix m = stack_transformations[i].GetMatrix();
-      m = m*mo;
-      stack_transformations[i].PutMatrix(m);
+      stack_transformations[i].PostMultiply(offset);
 
       //perform rigid registration
       registration.SetInput(&target, &source);
@@ -906,10 +960,10 @@ public:
       registration.SetTargetPadding(0);
       registration.Run();
 
-      mo.Invert();
-      m = stack_transformations[i].GetMatrix();
-      m = m*mo;
-      stack_transformations[i].PutMatrix(m);
+      //offset is shared by all stacks, undo it with a copy
+      irtkHomogeneousTransformation undo(offset);
+      undo.Invert();
+      stack_transformations[i].PostMultiply(undo);
 
       //stack_transformations[i] = transformation;            
 
@@ -929,10 +983,8 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, stacks.size()),
+    irtkParallelFor(blocked_range<size_t>(0, stacks.size()),
       *this);
-    init.terminate();
   }
 
 };
@@ -1087,6 +1139,151 @@ void irtkReconstruction::ScaleVolumeGPU()
   reconstructionGPU->ScaleVolume();
 }
 
+/*
+
+Longest-first scheduling of the per-slice loops
+
+The work per slice varies a lot (slices outside the mask do almost nothing)
+and expensive slices are neighbours in index order, so splitting the slices
+by index leaves threads idle at the end of a stage. Instead, the slices are
+sorted by an estimate of their cost and each thread takes the most expensive
+remaining slice whenever it is done with the previous one (greedy list
+scheduling on top of TBB work stealing). The busy time of the threads is
+sampled as <key>/imbalance = max / mean, 1 is a perfect balance.
+
+*/
+class irtkSliceSchedule {
+  vector<size_t> _order;
+  mutable tbb::atomic<size_t> _next;
+  size_t _workers;
+  string _key;
+  mutable enumerable_thread_specific<double> _busy;
+
+  struct Compare {
+    const vector<double> &cost;
+    Compare(const vector<double> &_cost) : cost(_cost) { }
+    bool operator() (size_t a, size_t b) const { return cost[a] > cost[b]; }
+  };
+
+  void Initialize(const vector<irtkRealImage> &slices, vector<double> &cost) {
+    //valid pixels until the stage has measured a better estimate
+    if (cost.size() != slices.size()) {
+      cost.resize(slices.size());
+      for (size_t inputIndex = 0; inputIndex < slices.size(); ++inputIndex) {
+        const irtkRealPixel *ptr = slices[inputIndex].GetPointerToVoxels();
+        int valid = 0;
+        for (int i = 0; i < slices[inputIndex].GetNumberOfVoxels(); i++)
+          if (ptr[i] > -1) valid++;
+        cost[inputIndex] = valid;
+      }
+    }
+    stable_sort(_order.begin(), _order.end(), Compare(cost));
+    _workers = min(_order.size(), size_t(irtkParallelThreads()));
+  }
+
+public:
+  irtkSliceSchedule(const vector<irtkRealImage> &slices, vector<double> &cost, const string &key) :
+    _key(key), _busy(0.0) {
+    _next = 0;
+    _order.resize(slices.size());
+    for (size_t inputIndex = 0; inputIndex < _order.size(); ++inputIndex)
+      _order[inputIndex] = inputIndex;
+    Initialize(slices, cost);
+  }
+
+  /// Schedules only the given slices, e.g. the active slices of the EM
+  irtkSliceSchedule(const vector<irtkRealImage> &slices, vector<double> &cost, const vector<size_t> &subset, const string &key) :
+    _order(subset), _key(key), _busy(0.0) {
+    _next = 0;
+    Initialize(slices, cost);
+  }
+
+  /// Position of the next slice in the order, >= Size() when all are taken
+  size_t Next() const { return _next.fetch_and_increment(); }
+  size_t Size() const { return _order.size(); }
+  size_t Slice(size_t k) const { return _order[k]; }
+  void Busy(double t) const { _busy.local() += t; }
+
+  /// Runs a parallel_for body on single slice ranges in the order
+  template <class Body> void ParallelFor(const Body &body) const;
+  /// Runs a parallel_reduce body on single slice ranges in the order
+  template <class Body> void ParallelReduce(Body &body) const;
+
+  /// Samples the imbalance of the busy times of the threads
+  void Imbalance() const {
+    double total = 0, max = 0;
+    for (enumerable_thread_specific<double>::const_iterator t = _busy.begin(); t != _busy.end(); ++t) {
+      total += *t;
+      if (*t > max) max = *t;
+    }
+    if (total > 0)
+      PerfStats::instance().sample(_key.empty() ? "imbalance" : _key + "/imbalance", max / (total / _workers));
+  }
+};
+
+template <class Body>
+class irtkSliceScheduleFor {
+  const irtkSliceSchedule &schedule;
+  const Body &body;
+
+public:
+  irtkSliceScheduleFor(const irtkSliceSchedule &_schedule, const Body &_body) :
+    schedule(_schedule), body(_body) { }
+
+  void operator() (const blocked_range<size_t> &) const {
+    tick_count start = tick_count::now();
+    for (size_t k = schedule.Next(); k < schedule.Size(); k = schedule.Next()) {
+      size_t inputIndex = schedule.Slice(k);
+      body(blocked_range<size_t>(inputIndex, inputIndex + 1));
+    }
+    schedule.Busy((tick_count::now() - start).seconds());
+  }
+};
+
+template <class Body>
+class irtkSliceScheduleReduce {
+  const irtkSliceSchedule &schedule;
+  Body *body;
+  bool own;
+
+public:
+  irtkSliceScheduleReduce(const irtkSliceSchedule &_schedule, Body &_body) :
+    schedule(_schedule), body(&_body), own(false) { }
+
+  irtkSliceScheduleReduce(irtkSliceScheduleReduce &x, split) :
+    schedule(x.schedule), body(new Body(*x.body, split())), own(true) { }
+
+  ~irtkSliceScheduleReduce() {
+    if (own)
+      delete body;
+  }
+
+  void join(const irtkSliceScheduleReduce &y) {
+    body->join(*y.body);
+  }
+
+  void operator() (const blocked_range<size_t> &) {
+    tick_count start = tick_count::now();
+    for (size_t k = schedule.Next(); k < schedule.Size(); k = schedule.Next()) {
+      size_t inputIndex = schedule.Slice(k);
+      (*body)(blocked_range<size_t>(inputIndex, inputIndex + 1));
+    }
+    schedule.Busy((tick_count::now() - start).seconds());
+  }
+};
+
+//one task per thread, each pulls slices until none is left
+template <class Body> void irtkSliceSchedule::ParallelFor(const Body &body) const {
+  irtkParallelFor(blocked_range<size_t>(0, _workers, 1), irtkSliceScheduleFor<Body>(*this, body));
+  Imbalance();
+}
+
+template <class Body> void irtkSliceSchedule::ParallelReduce(Body &body) const {
+  irtkSliceScheduleReduce<Body> reduce(*this, body);
+  irtkParallelReduce(blocked_range<size_t>(0, _workers, 1), reduce);
+  Imbalance();
+}
+
 class ParallelSimulateSlices {
   irtkReconstruction *reconstructor;
 
@@ -1096,48 +1293,84 @@ public:
 
   void operator() (const blocked_range<size_t> &r) const {
     for (size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex) {
+      PerfStats::Timer timer("SimulateSlices/slice", inputIndex);
       //Calculate simulated slice
-      reconstructor->_simulated_slices[inputIndex].Initialize(reconstructor->_slices[inputIndex].GetImageAttributes());
+      reconstructor->_simulated_slices[inputIndex].Initialize(reconstructor->_slices[inputIndex].GetImageAttributes(), false);
       reconstructor->_simulated_slices[inputIndex] = 0;
 
-      reconstructor->_simulated_weights[inputIndex].Initialize(reconstructor->_slices[inputIndex].GetImageAttributes());
+      reconstructor->_simulated_weights[inputIndex].Initialize(reconstructor->_slices[inputIndex].GetImageAttributes(), false);
       reconstructor->_simulated_weights[inputIndex] = 0;
 
-      reconstructor->_simulated_inside[inputIndex].Initialize(reconstructor->_slices[inputIndex].GetImageAttributes());
+      reconstructor->_simulated_inside[inputIndex].Initialize(reconstructor->_slices[inputIndex].GetImageAttributes(), false);
       reconstructor->_simulated_inside[inputIndex] = 0;
 
       reconstructor->_slice_inside_cpu[inputIndex] = false;
 
+      const vector<int> &pixels = reconstructor->_active_pixels[inputIndex];
+      int x = reconstructor->_slices[inputIndex].GetX();
+      irtkRealPixel *sim = reconstructor->_simulated_slices[inputIndex].GetPointerToVoxels();
+      irtkRealPixel *simw = reconstructor->_simulated_weights[inputIndex].GetPointerToVoxels();
+      irtkRealPixel *simi = reconstructor->_simulated_inside[inputIndex].GetPointerToVoxels();
+
       POINT3D p;
-      for (int i = 0; i < reconstructor->_slices[inputIndex].GetX(); i++)
-        for (int j = 0; j < reconstructor->_slices[inputIndex].GetY(); j++)
-          if (reconstructor->_slices[inputIndex](i, j, 0) != -1) {
+      for (size_t l = 0; l < pixels.size(); l++) {
+        int i = pixels[l] % x, j = pixels[l] / x;
         double weight = 0;
         size_t n = reconstructor->_volcoeffs[inputIndex][i][j].size();
         for (int k = 0; k < n; k++) {
           p = reconstructor->_volcoeffs[inputIndex][i][j][k];
-          reconstructor->_simulated_slices[inputIndex](i, j, 0) += p.value * reconstructor->_reconstructed(p.x, p.y, p.z);
+          sim[pixels[l]] += p.value * reconstructor->_reconstructed(p.x, p.y, p.z);
           weight += p.value;
           if (reconstructor->_mask(p.x, p.y, p.z) == 1) {
-            reconstructor->_simulated_inside[inputIndex](i, j, 0) = 1;
+            simi[pixels[l]] = 1;
             reconstructor->_slice_inside_cpu[inputIndex] = true;
           }
         }
         if (weight > 0) {
-          reconstructor->_simulated_slices[inputIndex](i, j, 0) /= weight;
-          reconstructor->_simulated_weights[inputIndex](i, j, 0) = weight;
+          sim[pixels[l]] /= weight;
+          simw[pixels[l]] = weight;
         }
-          }
+      }
 
     }
   }
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_slice_cost, reconstructor->_em_slices, "SimulateSlices");
+    schedule.ParallelFor(*this);
+  }
+
+};
+
+class ParallelSliceInside {
+  irtkReconstruction *reconstructor;
+  const vector<size_t> &slices;
+
+public:
+  ParallelSliceInside(irtkReconstruction *_reconstructor, const vector<size_t> &_slices) :
+    reconstructor(_reconstructor), slices(_slices) { }
+
+  void operator() (const blocked_range<size_t> &r) const {
+    for (size_t s = r.begin(); s != r.end(); ++s) {
+      size_t inputIndex = slices[s];
+      //same test as ParallelSimulateSlices without simulating the slice
+      bool inside = false;
+      const vector<int> &pixels = reconstructor->_active_pixels[inputIndex];
+      int x = reconstructor->_slices[inputIndex].GetX();
+      for (size_t l = 0; (l < pixels.size()) && !inside; l++) {
+        int i = pixels[l] % x, j = pixels[l] / x;
+        const VOXELCOEFFS &coeffs = reconstructor->_volcoeffs[inputIndex][i][j];
+        for (size_t k = 0; (k < coeffs.size()) && !inside; k++)
+          inside = (reconstructor->_mask(coeffs[k].x, coeffs[k].y, coeffs[k].z) == 1);
+      }
+      reconstructor->_slice_inside_cpu[inputIndex] = inside;
+    }
+  }
+
+  // execute
+  void operator() () const {
+    irtkParallelFor(blocked_range<size_t>(0, slices.size()), *this);
   }
 
 };
@@ -1151,6 +1384,17 @@ void irtkReconstruction::SimulateSlices()
   ParallelSimulateSlices parallelSimulateSlices(this);
   parallelSimulateSlices();
 
+  //slices outside the EM are not simulated, but their overlap with the mask
+  //is still updated for the slice statistics
+  vector<size_t> excluded;
+  for (size_t inputIndex = 0, e = 0; inputIndex < _slices.size(); inputIndex++) {
+    if ((e < _em_slices.size()) && (_em_slices[e] == inputIndex)) e++;
+    else excluded.push_back(inputIndex);
+  }
+  ParallelSliceInside parallelSliceInside(this, excluded);
+  parallelSliceInside();
+  UpdateActiveSlices();
+
   if (_debug)
     cout << "done." << endl;
   if(_debugGPU)
@@ -1253,9 +1497,20 @@ void irtkReconstruction::SimulateStacks(vector<irtkRealImage>& stacks)
       z = 0;
     }
 
+    //cropped slices (see CropSlices) are placed at their offset in the stack
+    //slice, the pixels cropped away are simulated as 0
+    int x0 = 0, y0 = 0;
+    if (inputIndex < _uncropped_attr.size()) {
+      x0 = _crop_x[inputIndex];
+      y0 = _crop_y[inputIndex];
+      for (i = 0; i < _uncropped_attr[inputIndex]._x; i++)
+        for (j = 0; j < _uncropped_attr[inputIndex]._y; j++)
+          stacks[_stack_index[inputIndex]](i, j, z) = 0;
+    }
+
     for (i = 0; i < sim.GetX(); i++)
       for (j = 0; j < sim.GetY(); j++) {
-      stacks[_stack_index[inputIndex]](i, j, z) = sim(i, j, 0);
+      stacks[_stack_index[inputIndex]](x0 + i, y0 + j, z) = sim(i, j, 0);
       }
     //end of loop for a slice inputIndex
   }
@@ -1668,7 +1923,7 @@ void irtkReconstruction::CreateSlicesAndTransformationsPatchBased(int patchSize,
     estimatedBytes /= 1024;
     estimatedBytes /= 1024;
   }
-  reconstructionGPU->updateStackSizes(stack_sizes_);
+  updateStackSizes(stack_sizes_);
 
   cout << "Number of slices: " << _slices.size() << endl;
   std::cout << "new memory consumption: " << estimatedBytes << " MB" << std::endl;
@@ -1803,7 +2058,7 @@ void irtkReconstruction::CreateSlicesAndTransformationsSuperpixelBased(vector<ir
     estimatedBytes /= 1024;
     estimatedBytes /= 1024;
   }
-  reconstructionGPU->updateStackSizes(stack_sizes_);
+  updateStackSizes(stack_sizes_);
 
   cout << "Number of slices: " << _slices.size() << endl;
   std::cout << "new memory consumption: " << estimatedBytes << " MB" << std::endl;
@@ -1844,7 +2099,7 @@ void irtkReconstruction::CreateSlicesAndTransformations(vector<irtkRealImage> &s
       _transformations_gpu.push_back(stack_transformations[i]);
     }
   }
-  reconstructionGPU->updateStackSizes(stack_sizes_);
+  updateStackSizes(stack_sizes_);
 
   cout << "Number of slices: " << _slices.size() << endl;
 }
@@ -1987,8 +2242,95 @@ void irtkReconstruction::MaskSlices()
   cout << "done." << endl;
 }
 
+void irtkReconstruction::CropSlices()
+{
+  cout << "Cropping slices ... ";
+
+  long before = 0, after = 0;
+  _uncropped_attr.clear();
+  _crop_x.clear();
+  _crop_y.clear();
+
+  for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    irtkRealImage& slice = _slices[inputIndex];
+    irtkImageAttributes attr = slice.GetImageAttributes();
+
+    //bounding box of the valid pixels
+    int x1 = attr._x, y1 = attr._y, x2 = -1, y2 = -1;
+    for (int i = 0; i < attr._x; i++)
+      for (int j = 0; j < attr._y; j++)
+        if (slice(i, j, 0) != -1) {
+      x1 = min(x1, i);
+      x2 = max(x2, i);
+      y1 = min(y1, j);
+      y2 = max(y2, j);
+        }
+
+    if (x2 < 0) {
+      //no valid pixel, keep a single padding pixel
+      x1 = y1 = x2 = y2 = 0;
+    }
+    else {
+      //the bias field blurring reaches this far, a larger margin keeps the
+      //blurred values of the valid pixels unchanged
+      int mx = round(4 * _sigma_bias / attr._dx) + 1;
+      int my = round(4 * _sigma_bias / attr._dy) + 1;
+      x1 = max(0, x1 - mx);
+      y1 = max(0, y1 - my);
+      x2 = min(attr._x - 1, x2 + mx);
+      y2 = min(attr._y - 1, y2 + my);
+    }
+
+    _uncropped_attr.push_back(attr);
+    _crop_x.push_back(x1);
+    _crop_y.push_back(y1);
+    before += slice.GetNumberOfVoxels();
+
+    slice = slice.GetRegion(x1, y1, 0, x2 + 1, y2 + 1, 1);
+    after += slice.GetNumberOfVoxels();
+
+    //per-slice images have the geometry of the slice
+    if (inputIndex < _simulated_slices.size()) _simulated_slices[inputIndex] = slice;
+    if (inputIndex < _simulated_weights.size()) _simulated_weights[inputIndex] = slice;
+    if (inputIndex < _simulated_inside.size()) _simulated_inside[inputIndex] = slice;
+    if (inputIndex < _weights.size()) _weights[inputIndex] = _weights[inputIndex].GetRegion(x1, y1, 0, x2 + 1, y2 + 1, 1);
+    if (inputIndex < _bias.size()) _bias[inputIndex] = _bias[inputIndex].GetRegion(x1, y1, 0, x2 + 1, y2 + 1, 1);
+  }
+
+  cout << "done (" << after << " of " << before << " voxels)." << endl;
+}
+
+irtkRealImage irtkReconstruction::GetUncroppedSlice(int inputIndex) const
+{
+  const irtkRealImage& slice = _slices[inputIndex];
+  if (inputIndex >= (int)_uncropped_attr.size())
+    return slice;
+
+  irtkRealImage uncropped(_uncropped_attr[inputIndex]);
+  uncropped = -1;
+  for (int i = 0; i < slice.GetX(); i++)
+    for (int j = 0; j < slice.GetY(); j++)
+      uncropped(_crop_x[inputIndex] + i, _crop_y[inputIndex] + j, 0) = slice.Get(i, j, 0);
+  return uncropped;
+}
+
 
 //TODO implement non rigid registration and its evaluation in cuda...
+/// Rigid registration with padding counting the evaluations of the similarity
+class irtkCountedRigidRegistrationWithPadding : public irtkImageRigidRegistrationWithPadding
+{
+public:
+  long evaluations;
+
+  irtkCountedRigidRegistrationWithPadding() : evaluations(0) { }
+
+  virtual double Evaluate()
+  {
+    evaluations++;
+    return irtkImageRigidRegistrationWithPadding::Evaluate();
+  }
+};
+
 class ParallelSliceToVolumeRegistration {
 public:
   irtkReconstruction *reconstructor;
@@ -2001,16 +2343,20 @@ public:
     irtkImageAttributes attr = reconstructor->_reconstructed.GetImageAttributes();
 
     for (size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex) {
-      irtkImageRigidRegistrationWithPadding registration;
+      PerfStats::Timer timer("slice", inputIndex);
+      tick_count start = tick_count::now();
+      irtkCountedRigidRegistrationWithPadding registration;
       irtkGreyPixel smin, smax;
       irtkGreyImage target;
       irtkRealImage slice, w, b, t;
       irtkResamplingWithPadding<irtkRealPixel> resampling(attr._dx, attr._dx, attr._dx, -1);
       // irtkReconstruction dummy_reconstruction; // this also creats an unwanted instance of the GPU reconstruction
 
-      //target = _slices[inputIndex];
-      t = reconstructor->_slices[inputIndex];
-      resampling.SetInput(&reconstructor->_slices[inputIndex]);
+      //register the slice at its original extent, the resampling grid and
+      //the origin of the registration depend on it
+      slice = reconstructor->GetUncroppedSlice(inputIndex);
+      t = slice;
+      resampling.SetInput(&slice);
       resampling.SetOutput(&t);
       resampling.Run();
       target = t;
@@ -2022,10 +2368,7 @@ public:
         irtkRigidTransformation offset;
         //dummy_reconstruction.ResetOrigin(target,offset);
         irtkReconstruction::ResetOrigin(target, offset);
-        irtkMatrix mo = offset.GetMatrix();
-        irtkMatrix m = reconstructor->_transformations[inputIndex].GetMatrix();
-        m = m*mo;
-        reconstructor->_transformations[inputIndex].PutMatrix(m);
+        reconstructor->_transformations[inputIndex].PostMultiply(offset);
         //std::cout << " ofsMatrix: " << inputIndex << std::endl;
         //reconstructor->_transformations[inputIndex].GetMatrix().Print();
 
@@ -2035,25 +2378,24 @@ public:
         registration.GuessParameterSliceToVolume(reconstructor->_useNMI);
         registration.SetTargetPadding(-1);
         registration.Run();
+        PerfStats::instance().count("Evaluate calls", registration.evaluations);
 
         reconstructor->_slices_regCertainty[inputIndex] = registration.last_similarity;
         //undo the offset
-        mo.Invert();
-        m = reconstructor->_transformations[inputIndex].GetMatrix();
-        m = m*mo;
-        reconstructor->_transformations[inputIndex].PutMatrix(m);
+        offset.Invert();
+        reconstructor->_transformations[inputIndex].PostMultiply(offset);
       }
 
+      //cost estimate of the next registration
+      reconstructor->_registration_cost[inputIndex] = (tick_count::now() - start).seconds();
       printf(".");
     }
   }
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_registration_cost, "");
+    schedule.ParallelFor(*this);
   }
 
 };
@@ -2062,7 +2404,7 @@ public:
 void irtkReconstruction::setPatchBased(bool value, bool _cpu)
 {
   _patchBased = value;
-  if (_cpu)
+  if (_cpu && (reconstructionGPU != NULL))
   {
     reconstructionGPU->setPachBased(value);
   }
@@ -2074,7 +2416,7 @@ void irtkReconstruction::setSuperpixelBased(bool value, bool _cpu)
 {
   
   _superpixelBased = value;
-  if (_cpu)
+  if (_cpu && (reconstructionGPU != NULL))
   {
     reconstructionGPU->setSupepixelBased(value);
   }
@@ -2206,11 +2548,10 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(reconstructor->reconstructionGPU->devicesToUse.size());
-    //tbb_no_threads
-    parallel_for(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    // one thread per device in its own arena instead of the tbb_no_threads arena
+    task_arena arena(reconstructor->reconstructionGPU->devicesToUse.size());
+    blocked_range<size_t> range(0, reconstructor->_slices.size());
+    arena.execute(irtkArenaParallelFor<blocked_range<size_t>, ParallelSliceToVolumeRegistrationGPU>(range, *this));
   }
 
 };
@@ -2293,6 +2634,7 @@ void irtkReconstruction::SliceToVolumeRegistration()
   if (_slices_regCertainty.size() == 0) _slices_regCertainty.resize(_slices.size());
   if (_debug)
     cout << "SliceToVolumeRegistration" << endl;
+  PerfStats::Timer timer("Registration/SliceToVolume");
   ParallelSliceToVolumeRegistration registration(this);
   registration();
   if (_useCPUReg)
@@ -2312,6 +2654,7 @@ public:
   void operator() (const blocked_range<size_t> &r) const {
 
     for (size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex) {
+      PerfStats::Timer timer("CoeffInit/slice", inputIndex);
 
       bool slice_inside;
 
@@ -2447,6 +2790,8 @@ public:
       int nx, ny, nz;
       int l, m, n;
       double weight;
+      int psfIndex;
+      vector<double> psfX(xDim * yDim * zDim), psfY(xDim * yDim * zDim), psfZ(xDim * yDim * zDim);
       for (i = 0; i < slice.GetX(); i++)
         for (j = 0; j < slice.GetY(); j++)
           if (slice(i, j, 0) != -1) {
@@ -2467,7 +2812,9 @@ public:
             for (kk = 0; kk < dim; kk++)
               tPSF(ii, jj, kk) = 0;
 
-        //for each POINT3D of the PSF
+        //positions of all POINT3Ds of the PSF centred over the current
+        //slice voxel, in world coordinates
+        psfIndex = 0;
         for (ii = 0; ii < xDim; ii++)
           for (jj = 0; jj < yDim; jj++)
             for (kk = 0; kk < zDim; kk++) {
@@ -2505,9 +2852,25 @@ public:
           //convert from slice image coordinates to world coordinates
           slice.ImageToWorld(x, y, z);
 
-          //x+=(vx-cx); y+=(vy-cy); z+=(vz-cz);
-          //Transform to space of reconstructed volume
-          reconstructor->_transformations[inputIndex].Transform(x, y, z);
+          psfX[psfIndex] = x;
+          psfY[psfIndex] = y;
+          psfZ[psfIndex] = z;
+          psfIndex++;
+            }
+
+        //x+=(vx-cx); y+=(vy-cy); z+=(vz-cz);
+        //Transform to space of reconstructed volume
+        reconstructor->_transformations[inputIndex].Transform(psfIndex, &psfX[0], &psfY[0], &psfZ[0]);
+
+        //for each POINT3D of the PSF
+        psfIndex = 0;
+        for (ii = 0; ii < xDim; ii++)
+          for (jj = 0; jj < yDim; jj++)
+            for (kk = 0; kk < zDim; kk++) {
+          x = psfX[psfIndex];
+          y = psfY[psfIndex];
+          z = psfZ[psfIndex];
+          psfIndex++;
           //Change to image coordinates
           reconstructor->_reconstructed.WorldToImage(x, y, z);
 
@@ -2606,10 +2969,8 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_slice_cost, "CoeffInit");
+    schedule.ParallelFor(*this);
   }
 
 };
@@ -2627,10 +2988,25 @@ void irtkReconstruction::CoeffInit()
   _slice_inside_cpu.clear();
   _slice_inside_cpu.resize(_slices.size());
 
-  cout << "Initialising matrix coefficients...";
-  ParallelCoeffInit coeffinit(this);
-  coeffinit();
-  cout << " ... done." << endl;
+  //matrix is loaded from the cache if slices, transformations, volume and mask are unchanged
+  string cacheName;
+  if (!_coeff_cache.empty()) {
+    char key[32];
+    sprintf(key, "%016llx", CoeffCacheKey());
+    cacheName = _coeff_cache + "/coeffs_" + key + ".bin";
+  }
+
+  if (cacheName.empty() || !ReadCoeffCache(cacheName.c_str())) {
+    cout << "Initialising matrix coefficients...";
+    ParallelCoeffInit coeffinit(this);
+    coeffinit();
+    cout << " ... done." << endl;
+
+    if (!cacheName.empty()) WriteCoeffCache(cacheName.c_str());
+  }
+  else {
+    cout << "Matrix coefficients loaded from " << cacheName << endl;
+  }
 
   //prepare image for volume weights, will be needed for Gaussian Reconstruction
   _volume_weights.Initialize(_reconstructed.GetImageAttributes());
@@ -2638,16 +3014,29 @@ void irtkReconstruction::CoeffInit()
 
   int inputIndex, i, j, n, k;
   POINT3D p;
-  for (inputIndex = 0; inputIndex < _slices.size(); ++inputIndex) {
-    for (i = 0; i < _slices[inputIndex].GetX(); i++)
-      for (j = 0; j < _slices[inputIndex].GetY(); j++) {
-      n = _volcoeffs[inputIndex][i][j].size();
-      for (k = 0; k < n; k++) {
-        p = _volcoeffs[inputIndex][i][j][k];
-        _volume_weights(p.x, p.y, p.z) += p.value;
-      }
-      }
+  long voxels = 0, coefficients = 0;
+  {
+    PerfStats::Timer timer("CoeffInit/volume weights");
+    _slice_cost.resize(_slices.size());
+    for (inputIndex = 0; inputIndex < _slices.size(); ++inputIndex) {
+      long slice_coefficients = 0;
+      for (i = 0; i < _slices[inputIndex].GetX(); i++)
+        for (j = 0; j < _slices[inputIndex].GetY(); j++) {
+        n = _volcoeffs[inputIndex][i][j].size();
+        for (k = 0; k < n; k++) {
+          p = _volcoeffs[inputIndex][i][j][k];
+          _volume_weights(p.x, p.y, p.z) += p.value;
+        }
+        voxels++;
+        slice_coefficients += n;
+        }
+      coefficients += slice_coefficients;
+      //cost estimate of the EM stages and the next CoeffInit
+      _slice_cost[inputIndex] = slice_coefficients;
+    }
   }
+  PerfStats::instance().count("CoeffInit/slice voxels", voxels);
+  PerfStats::instance().count("CoeffInit/coefficients", coefficients);
   if (_debug || _debugGPU)
     _volume_weights.Write("volume_weightsCPU.nii");
 
@@ -2672,6 +3061,274 @@ void irtkReconstruction::CoeffInit()
 
 }  //end of CoeffInit()
 
+/* Cache of the slice-volume matrix */
+
+#define IRTK_COEFF_CACHE_MAGIC   "IRTKCOEF"
+#define IRTK_COEFF_CACHE_VERSION 1
+
+/// Header of the cache file, followed by the slice dimensions (2 x int), the
+/// slice inside flags (1 byte each), the number of coefficients of each slice
+/// voxel (int) and the coefficients (POINT3D), each section 8 byte aligned
+struct irtkCoeffCacheHeader
+{
+  char magic[8];
+  int version;
+  int slices;
+  unsigned long long key;
+  unsigned long long voxels;
+  unsigned long long points;
+};
+
+static inline size_t CoeffCacheAlign(size_t n)
+{
+  return (n + 7) & ~size_t(7);
+}
+
+static inline void CoeffCacheHash(unsigned long long &h, unsigned long long v)
+{
+  v ^= v >> 33;
+  v *= 0xff51afd7ed558ccdULL;
+  v ^= v >> 33;
+  h ^= v;
+  h *= 0x100000001b3ULL;
+}
+
+static inline void CoeffCacheHash(unsigned long long &h, double d)
+{
+  unsigned long long v;
+  memcpy(&v, &d, sizeof(v));
+  CoeffCacheHash(h, v);
+}
+
+static void CoeffCacheHash(unsigned long long &h, const irtkImageAttributes &attr)
+{
+  CoeffCacheHash(h, (unsigned long long)attr._x);
+  CoeffCacheHash(h, (unsigned long long)attr._y);
+  CoeffCacheHash(h, (unsigned long long)attr._z);
+  CoeffCacheHash(h, attr._dx);
+  CoeffCacheHash(h, attr._dy);
+  CoeffCacheHash(h, attr._dz);
+  CoeffCacheHash(h, attr._xorigin);
+  CoeffCacheHash(h, attr._yorigin);
+  CoeffCacheHash(h, attr._zorigin);
+  for (int i = 0; i < 3; i++) {
+    CoeffCacheHash(h, attr._xaxis[i]);
+    CoeffCacheHash(h, attr._yaxis[i]);
+    CoeffCacheHash(h, attr._zaxis[i]);
+  }
+}
+
+unsigned long long irtkReconstruction::CoeffCacheKey()
+{
+  unsigned long long h = 0xcbf29ce484222325ULL;
+
+  CoeffCacheHash(h, (unsigned long long)IRTK_COEFF_CACHE_VERSION);
+  CoeffCacheHash(h, _quality_factor);
+  CoeffCacheHash(h, _reconstructed.GetImageAttributes());
+
+  //only voxels inside the mask contribute
+  CoeffCacheHash(h, _mask.GetImageAttributes());
+  irtkRealPixel *pm = _mask.GetPointerToVoxels();
+  unsigned long long bits = 0;
+  int nbits = 0;
+  for (int i = 0; i < _mask.GetNumberOfVoxels(); i++) {
+    bits = (bits << 1) | (pm[i] == 1);
+    if (++nbits == 64) {
+      CoeffCacheHash(h, bits);
+      bits = 0;
+      nbits = 0;
+    }
+  }
+  CoeffCacheHash(h, bits);
+
+  //slice geometry, padding (-1) and transformations
+  CoeffCacheHash(h, (unsigned long long)_slices.size());
+  for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    CoeffCacheHash(h, _slices[inputIndex].GetImageAttributes());
+    for (int j = 0; j < 6; j++) {
+      CoeffCacheHash(h, _transformations[inputIndex].Get(j));
+    }
+    irtkRealPixel *ps = _slices[inputIndex].GetPointerToVoxels();
+    bits = 0;
+    nbits = 0;
+    for (int i = 0; i < _slices[inputIndex].GetNumberOfVoxels(); i++) {
+      bits = (bits << 1) | (ps[i] == -1);
+      if (++nbits == 64) {
+        CoeffCacheHash(h, bits);
+        bits = 0;
+        nbits = 0;
+      }
+    }
+    CoeffCacheHash(h, bits);
+  }
+  return h;
+}
+
+void irtkReconstruction::WriteCoeffCache(const char *filename)
+{
+  irtkCoeffCacheHeader header;
+  memcpy(header.magic, IRTK_COEFF_CACHE_MAGIC, 8);
+  header.version = IRTK_COEFF_CACHE_VERSION;
+  header.slices = _slices.size();
+  header.key = CoeffCacheKey();
+  header.voxels = 0;
+  header.points = 0;
+
+  vector<int> dims(2 * _slices.size());
+  vector<unsigned char> inside(CoeffCacheAlign(_slices.size()), 0);
+  for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    dims[2 * inputIndex] = _slices[inputIndex].GetX();
+    dims[2 * inputIndex + 1] = _slices[inputIndex].GetY();
+    inside[inputIndex] = _slice_inside_cpu[inputIndex];
+    header.voxels += dims[2 * inputIndex] * dims[2 * inputIndex + 1];
+  }
+
+  vector<int> counts;
+  counts.reserve(CoeffCacheAlign(header.voxels * sizeof(int)) / sizeof(int));
+  for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    for (unsigned int i = 0; i < _volcoeffs[inputIndex].size(); i++) {
+      for (unsigned int j = 0; j < _volcoeffs[inputIndex][i].size(); j++) {
+        counts.push_back(_volcoeffs[inputIndex][i][j].size());
+        header.points += counts.back();
+      }
+    }
+  }
+  if (counts.size() % 2 != 0) counts.push_back(0);
+
+  //written to a temporary file first, so that concurrent runs never read a partial cache
+  string tmpname = string(filename) + ".tmp";
+  FILE *fp = fopen(tmpname.c_str(), "wb");
+  if (fp == NULL) {
+    cerr << "Warning: Can't write matrix cache " << filename << endl;
+    return;
+  }
+  bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  if (dims.size() > 0) ok = ok && (fwrite(&dims[0], sizeof(int), dims.size(), fp) == dims.size());
+  if (inside.size() > 0) ok = ok && (fwrite(&inside[0], 1, inside.size(), fp) == inside.size());
+  if (counts.size() > 0) ok = ok && (fwrite(&counts[0], sizeof(int), counts.size(), fp) == counts.size());
+  for (unsigned int inputIndex = 0; ok && (inputIndex < _slices.size()); inputIndex++) {
+    for (unsigned int i = 0; i < _volcoeffs[inputIndex].size(); i++) {
+      for (unsigned int j = 0; j < _volcoeffs[inputIndex][i].size(); j++) {
+        size_t n = _volcoeffs[inputIndex][i][j].size();
+        if (n > 0) ok = ok && (fwrite(&_volcoeffs[inputIndex][i][j][0], sizeof(POINT3D), n, fp) == n);
+      }
+    }
+  }
+  if ((fclose(fp) != 0) || !ok || (rename(tmpname.c_str(), filename) != 0)) {
+    cerr << "Warning: Can't write matrix cache " << filename << endl;
+    remove(tmpname.c_str());
+  }
+}
+
+class ParallelCoeffCacheLoad {
+  irtkReconstruction *reconstructor;
+  const int *counts;
+  const POINT3D *points;
+  const vector<unsigned long long> &voxelStart;
+  const vector<unsigned long long> &pointStart;
+
+public:
+  ParallelCoeffCacheLoad(irtkReconstruction *_reconstructor, const int *_counts, const POINT3D *_points,
+    const vector<unsigned long long> &_voxelStart, const vector<unsigned long long> &_pointStart) :
+    reconstructor(_reconstructor), counts(_counts), points(_points), voxelStart(_voxelStart), pointStart(_pointStart) { }
+
+  void operator() (const blocked_range<size_t> &r) const {
+    for (size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex) {
+      irtkRealImage &slice = reconstructor->_slices[inputIndex];
+      const int *c = counts + voxelStart[inputIndex];
+      const POINT3D *p = points + pointStart[inputIndex];
+      SLICECOEFFS slicecoeffs(slice.GetX(), vector < VOXELCOEFFS >(slice.GetY()));
+      for (int i = 0; i < slice.GetX(); i++) {
+        for (int j = 0; j < slice.GetY(); j++) {
+          slicecoeffs[i][j].assign(p, p + *c);
+          p += *c;
+          c++;
+        }
+      }
+      reconstructor->_volcoeffs[inputIndex].swap(slicecoeffs);
+    }
+  }
+
+  // execute
+  void operator() () const {
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_slice_cost, "CoeffInit");
+    schedule.ParallelFor(*this);
+  }
+};
+
+bool irtkReconstruction::ReadCoeffCache(const char *filename)
+{
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) return false;
+
+  irtkCoeffCacheHeader header;
+  if ((fread(&header, sizeof(header), 1, fp) != 1) ||
+      (memcmp(header.magic, IRTK_COEFF_CACHE_MAGIC, 8) != 0) ||
+      (header.version != IRTK_COEFF_CACHE_VERSION) || (header.slices != (int)_slices.size()) ||
+      (header.key != CoeffCacheKey())) {
+    fclose(fp);
+    return false;
+  }
+
+  size_t dimsOffset = sizeof(header);
+  size_t insideOffset = dimsOffset + CoeffCacheAlign(2 * header.slices * sizeof(int));
+  size_t countsOffset = insideOffset + CoeffCacheAlign(header.slices);
+  size_t pointsOffset = countsOffset + CoeffCacheAlign(header.voxels * sizeof(int));
+  size_t size = pointsOffset + header.points * sizeof(POINT3D);
+
+  //the file is mapped and the coefficients are copied straight from the page cache
+  const char *data = NULL;
+  vector<char> buffer;
+#ifndef WIN32
+  struct stat buf;
+  void *region = MAP_FAILED;
+  if ((fstat(fileno(fp), &buf) == 0) && (size_t(buf.st_size) == size)) {
+    region = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(fp), 0);
+  }
+  fclose(fp);
+  if (region == MAP_FAILED) return false;
+  data = (const char *)region;
+#else
+  buffer.resize(size);
+  fseek(fp, 0, SEEK_SET);
+  bool ok = (fread(&buffer[0], 1, size, fp) == size) && (fgetc(fp) == EOF);
+  fclose(fp);
+  if (!ok) return false;
+  data = &buffer[0];
+#endif
+
+  const int *dims = (const int *)(data + dimsOffset);
+  const unsigned char *inside = (const unsigned char *)(data + insideOffset);
+  vector<unsigned long long> voxelStart(_slices.size()), pointStart(_slices.size());
+  unsigned long long voxels = 0, points = 0;
+  const int *counts = (const int *)(data + countsOffset);
+  bool valid = (header.voxels * sizeof(int) <= size);
+  for (unsigned int inputIndex = 0; valid && (inputIndex < _slices.size()); inputIndex++) {
+    valid = (dims[2 * inputIndex] == _slices[inputIndex].GetX()) && (dims[2 * inputIndex + 1] == _slices[inputIndex].GetY());
+    voxelStart[inputIndex] = voxels;
+    pointStart[inputIndex] = points;
+    unsigned long long n = (unsigned long long)dims[2 * inputIndex] * dims[2 * inputIndex + 1];
+    valid = valid && (voxels + n <= header.voxels);
+    for (unsigned long long v = voxels; valid && (v < voxels + n); v++) points += counts[v];
+    voxels += n;
+  }
+  valid = valid && (voxels == header.voxels) && (points == header.points);
+
+  if (valid) {
+    _volcoeffs.resize(_slices.size());
+    ParallelCoeffCacheLoad load(this, counts, (const POINT3D *)(data + pointsOffset), voxelStart, pointStart);
+    load();
+    for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+      _slice_inside_cpu[inputIndex] = (inside[inputIndex] != 0);
+    }
+  }
+
+#ifndef WIN32
+  munmap(region, size);
+#endif
+  return valid;
+}
+
 void irtkReconstruction::SyncCPU()
 {
   irtkGenericImage<float> trecon = _reconstructed_gpu;
@@ -2770,7 +3427,6 @@ void irtkReconstruction::GaussianReconstruction()
   cout << "Gaussian reconstruction ... ";
   unsigned int inputIndex;
   int i, j, k, n;
-  irtkRealImage slice;
   double scale;
   POINT3D p;
   vector<int> voxel_num;
@@ -2782,21 +3438,23 @@ void irtkReconstruction::GaussianReconstruction()
   //std::cout << "voxel_num CPU: ";
   //CPU
   for (inputIndex = 0; inputIndex < _slices.size(); ++inputIndex) {
-    //copy the current slice
-    slice = _slices[inputIndex];
-    //alias the current bias image
-    irtkRealImage& b = _bias[inputIndex];
+    //alias the current slice and bias image
+    const irtkRealPixel *ps = _slices[inputIndex].GetPointerToVoxels();
+    const irtkRealPixel *pb = _bias[inputIndex].GetPointerToVoxels();
+    const vector<int> &pixels = _active_pixels[inputIndex];
+    int x = _slices[inputIndex].GetX();
     //read current scale factor
     scale = _scale_cpu[inputIndex];
 
     slice_vox_num = 0;
 
     //Distribute slice intensities to the volume
-    for (i = 0; i < slice.GetX(); i++)
-      for (j = 0; j < slice.GetY(); j++)
-        if (slice(i, j, 0) != -1) {
+    for (size_t l = 0; l < pixels.size(); l++) {
+      i = pixels[l] % x;
+      j = pixels[l] / x;
       //biascorrect and scale the slice
-      slice(i, j, 0) *= exp(-b(i, j, 0)) * scale;
+      irtkRealPixel value = ps[pixels[l]];
+      value *= exp(-pb[pixels[l]]) * scale;
 
       //number of volume voxels with non-zero coefficients
       //for current slice voxel
@@ -2815,12 +3473,12 @@ void irtkReconstruction::GaussianReconstruction()
       //to which it contributes
       for (k = 0; k < n; k++) {
         p = _volcoeffs[inputIndex][i][j][k];
-        _reconstructed(p.x, p.y, p.z) += p.value * slice(i, j, 0);
+        _reconstructed(p.x, p.y, p.z) += p.value * value;
       }
       //debug
       //p = _volcoeffs[inputIndex][i][j][0];
-      //_reconstructed(p.x, p.y, p.z) += slice(i, j, 0);
-        }
+      //_reconstructed(p.x, p.y, p.z) += value;
+    }
     voxel_num.push_back(slice_vox_num);
     //std::cout << voxel_num[inputIndex] << " ";
     //end of loop for a slice inputIndex
@@ -2857,6 +3515,8 @@ void irtkReconstruction::GaussianReconstruction()
       cout << " " << _small_slices[i];
     cout << endl;
   }
+
+  UpdateActiveSlices();
 }
 
 void irtkReconstruction::InitializeEM()
@@ -2883,6 +3543,29 @@ void irtkReconstruction::InitializeEM()
     //_slice_weight_gpu.push_back(1);
   }
 
+  //move the per-slice images into one block per field, the parallel copy
+  //spreads them over the NUMA nodes of the threads
+  vector<vector<irtkRealImage> *> fields;
+  fields.push_back(&_slices);
+  fields.push_back(&_simulated_slices);
+  fields.push_back(&_simulated_weights);
+  fields.push_back(&_simulated_inside);
+  fields.push_back(&_weights);
+  fields.push_back(&_bias);
+  _slice_arena.Attach(fields);
+
+  //valid pixels of each slice, the slices do not change during the EM
+  _active_pixels.clear();
+  _active_pixels.resize(_slices.size());
+  for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    irtkRealImage &slice = _slices[inputIndex];
+    for (int i = 0; i < slice.GetX(); i++)
+      for (int j = 0; j < slice.GetY(); j++)
+        if (slice(i, j, 0) != -1)
+          _active_pixels[inputIndex].push_back(i + j * slice.GetX());
+  }
+  UpdateActiveSlices();
+
   //TODO CUDA
   //Find the range of intensities
   _max_intensity = voxel_limits<irtkRealPixel>::min();
@@ -2902,6 +3585,28 @@ void irtkReconstruction::InitializeEM()
   }
 }
 
+void irtkReconstruction::UpdateActiveSlices()
+{
+  //force-excluded and small slices always have zero weight
+  vector<bool> excluded(_slices.size(), false);
+  for (unsigned int i = 0; i < _force_excluded.size(); i++)
+    if ((_force_excluded[i] >= 0) && (_force_excluded[i] < (int)_slices.size()))
+      excluded[_force_excluded[i]] = true;
+  for (unsigned int i = 0; i < _small_slices.size(); i++)
+    excluded[_small_slices[i]] = true;
+
+  _em_slices.clear();
+  _active_slices.clear();
+  for (size_t inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    if (excluded[inputIndex])
+      continue;
+    _em_slices.push_back(inputIndex);
+    if ((inputIndex < _slice_inside_cpu.size()) && _slice_inside_cpu[inputIndex]
+      && (inputIndex < _slice_weight_cpu.size()) && (_slice_weight_cpu[inputIndex] > 0))
+      _active_slices.push_back(inputIndex);
+  }
+}
+
 void irtkReconstruction::InitializeEMValuesGPU()
 {
   if (_debug)
@@ -3025,33 +3730,34 @@ void irtkReconstruction::InitializeRobustStatistics()
     cout << "InitializeRobustStatistics" << endl;
 
   //Initialise parameter of EM robust statistics
-  int i, j;
-  irtkRealImage slice, sim;
   double sigma = 0;
   int num = 0;
 
-  //for each slice
-  for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
-    slice = _slices[inputIndex];
+  //for each slice of the EM
+  for (unsigned int l = 0; l < _em_slices.size(); l++) {
+    size_t inputIndex = _em_slices[l];
+    const irtkRealPixel *ps = _slices[inputIndex].GetPointerToVoxels();
+    const irtkRealPixel *sim = _simulated_slices[inputIndex].GetPointerToVoxels();
+    const irtkRealPixel *simw = _simulated_weights[inputIndex].GetPointerToVoxels();
+    const irtkRealPixel *simi = _simulated_inside[inputIndex].GetPointerToVoxels();
+    const vector<int> &pixels = _active_pixels[inputIndex];
 
     //Voxel-wise sigma will be set to stdev of volumetric errors
     //For each slice voxel
-    for (i = 0; i < slice.GetX(); i++)
-      for (j = 0; j < slice.GetY(); j++)
-        if (slice(i, j, 0) != -1) {
+    for (size_t k = 0; k < pixels.size(); k++) {
       //calculate stev of the errors
-      if ((_simulated_inside[inputIndex](i, j, 0) == 1)
-        && (_simulated_weights[inputIndex](i, j, 0) > 0.99)) {
-        slice(i, j, 0) -= _simulated_slices[inputIndex](i, j, 0);
-        sigma += slice(i, j, 0) * slice(i, j, 0);
+      if ((simi[pixels[k]] == 1) && (simw[pixels[k]] > 0.99)) {
+        irtkRealPixel e = ps[pixels[k]] - sim[pixels[k]];
+        sigma += e * e;
         num++;
       }
-        }
+    }
+  }
 
-    //if slice does not have an overlap with ROI, set its weight to zero
+  //if slice does not have an overlap with ROI, set its weight to zero
+  for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++)
     if (!_slice_inside_cpu[inputIndex])
       _slice_weight_cpu[inputIndex] = 0;
-  }
 
   //Force exclusion of slices predefined by user
   for (unsigned int i = 0; i < _force_excluded.size(); i++)
@@ -3071,6 +3777,8 @@ void irtkReconstruction::InitializeRobustStatistics()
   if (_debug || _debugGPU)
     cout << "Initializing robust statistics CPU: " << "sigma=" << sqrt(_sigma_cpu) << " " << "m=" << _m_cpu
     << " " << "mix=" << _mix_cpu << " " << "mix_s=" << _mix_s_cpu << endl;
+
+  UpdateActiveSlices();
 }
 
 class ParallelEStep {
@@ -3081,25 +3789,31 @@ public:
 
   void operator()(const blocked_range<size_t>& r) const {
     for (size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
-      // read the current slice
-      irtkRealImage slice = reconstructor->_slices[inputIndex];
+      PerfStats::Timer timer("EStep/slice", inputIndex);
+      // alias the current slice
+      const irtkRealPixel *ps = reconstructor->_slices[inputIndex].GetPointerToVoxels();
+      const vector<int> &pixels = reconstructor->_active_pixels[inputIndex];
+      int x = reconstructor->_slices[inputIndex].GetX();
 
       //read current weight image
       reconstructor->_weights[inputIndex] = 0;
+      irtkRealPixel *pw = reconstructor->_weights[inputIndex].GetPointerToVoxels();
 
-      //alias the current bias image
-      irtkRealImage& b = reconstructor->_bias[inputIndex];
+      //alias the current bias image and simulated slice
+      const irtkRealPixel *pb = reconstructor->_bias[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *sim = reconstructor->_simulated_slices[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *simw = reconstructor->_simulated_weights[inputIndex].GetPointerToVoxels();
 
       //identify scale factor
       double scale = reconstructor->_scale_cpu[inputIndex];
 
       double num = 0;
       //Calculate error, voxel weights, and slice potential
-      for (int i = 0; i < slice.GetX(); i++)
-        for (int j = 0; j < slice.GetY(); j++)
-          if (slice(i, j, 0) != -1) {
+      for (size_t l = 0; l < pixels.size(); l++) {
+        int i = pixels[l] % x, j = pixels[l] / x;
         //bias correct and scale the slice
-        slice(i, j, 0) *= exp(-b(i, j, 0)) * scale;
+        irtkRealPixel e = ps[pixels[l]];
+        e *= exp(-pb[pixels[l]]) * scale;
 
         //number of volumetric voxels to which
         // current slice voxel contributes
@@ -3108,30 +3822,27 @@ public:
         // if n == 0, slice voxel has no overlap with volumetric ROI,
         // do not process it
 
-        if ((n>0) &&
-          (reconstructor->_simulated_weights[inputIndex](i, j, 0) > 0)) {
-          slice(i, j, 0) -= reconstructor->_simulated_slices[inputIndex](i, j, 0);
+        if ((n>0) && (simw[pixels[l]] > 0)) {
+          e -= sim[pixels[l]];
 
           //calculate norm and voxel-wise weights
 
           //Gaussian distribution for inliers (likelihood)
-          double g = reconstructor->G(slice(i, j, 0), reconstructor->_sigma_cpu);
+          double g = reconstructor->G(e, reconstructor->_sigma_cpu);
           //Uniform distribution for outliers (likelihood)
           double m = reconstructor->M(reconstructor->_m_cpu);
 
           //voxel_wise posterior
           double weight = g * reconstructor->_mix_cpu / (g *reconstructor->_mix_cpu + m * (1 - reconstructor->_mix_cpu));
-          reconstructor->_weights[inputIndex].PutAsDouble(i, j, 0, weight);
+          pw[pixels[l]] = weight;
 
           //calculate slice potentials
-          if (reconstructor->_simulated_weights[inputIndex](i, j, 0) > 0.99) {
+          if (simw[pixels[l]] > 0.99) {
             slice_potential[inputIndex] += (1.0 - weight) * (1.0 - weight);
             num++;
           }
         }
-        else
-          reconstructor->_weights[inputIndex].PutAsDouble(i, j, 0, 0);
-          }
+      }
 
       //evaluate slice potential
       if (num > 0)
@@ -3151,10 +3862,8 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_slice_cost, reconstructor->_em_slices, "EStep");
+    schedule.ParallelFor(*this);
   }
 
 };
@@ -3692,6 +4401,7 @@ void irtkReconstruction::EStep()
     cout << endl;
   }
 
+  UpdateActiveSlices();
 }
 
 class ParallelScale {
@@ -3706,28 +4416,30 @@ public:
     for (size_t inputIndex = r.begin(); inputIndex != r.end(); ++inputIndex) {
 
       // alias the current slice
-      irtkRealImage& slice = reconstructor->_slices[inputIndex];
+      const irtkRealPixel *slice = reconstructor->_slices[inputIndex].GetPointerToVoxels();
+      const vector<int> &pixels = reconstructor->_active_pixels[inputIndex];
 
       //alias the current weight image
-      irtkRealImage& w = reconstructor->_weights[inputIndex];
+      const irtkRealPixel *w = reconstructor->_weights[inputIndex].GetPointerToVoxels();
 
-      //alias the current bias image
-      irtkRealImage& b = reconstructor->_bias[inputIndex];
+      //alias the current bias image and simulated slice
+      const irtkRealPixel *b = reconstructor->_bias[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *sim = reconstructor->_simulated_slices[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *simw = reconstructor->_simulated_weights[inputIndex].GetPointerToVoxels();
 
       //initialise calculation of scale
       double scalenum = 0;
       double scaleden = 0;
 
-      for (int i = 0; i < slice.GetX(); i++)
-        for (int j = 0; j < slice.GetY(); j++)
-          if (slice(i, j, 0) != -1) {
-        if (reconstructor->_simulated_weights[inputIndex](i, j, 0) > 0.99) {
+      for (size_t l = 0; l < pixels.size(); l++) {
+        int k = pixels[l];
+        if (simw[k] > 0.99) {
           //scale - intensity matching
-          double eb = exp(-b(i, j, 0));
-          scalenum += w(i, j, 0) * slice(i, j, 0) * eb * reconstructor->_simulated_slices[inputIndex](i, j, 0);
-          scaleden += w(i, j, 0) * slice(i, j, 0) * eb * slice(i, j, 0) * eb;
+          double eb = exp(-b[k]);
+          scalenum += w[k] * slice[k] * eb * sim[k];
+          scaleden += w[k] * slice[k] * eb * slice[k] * eb;
         }
-          }
+      }
 
       //calculate scale for this slice
       if (scaleden > 0)
@@ -3740,10 +4452,8 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_slice_cost, reconstructor->_em_slices, "Scale");
+    schedule.ParallelFor(*this);
   }
 
 };
@@ -3800,52 +4510,56 @@ public:
 
   void operator()(const blocked_range<size_t>& r) const {
     for (size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
-      // read the current slice
-      irtkRealImage slice = reconstructor->_slices[inputIndex];
+      // alias the current slice
+      const irtkRealImage& slice = reconstructor->_slices[inputIndex];
+      const irtkRealPixel *ps = slice.GetPointerToVoxels();
+      const vector<int> &pixels = reconstructor->_active_pixels[inputIndex];
 
       //alias the current weight image
       irtkRealImage& w = reconstructor->_weights[inputIndex];
+      const irtkRealPixel *pw = w.GetPointerToVoxels();
 
       //alias the current bias image
-      irtkRealImage b = reconstructor->_bias[inputIndex];
+      irtkRealPixel *pb = reconstructor->_bias[inputIndex].GetPointerToVoxels();
+
+      //alias the simulated slice
+      const irtkRealPixel *sim = reconstructor->_simulated_slices[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *simw = reconstructor->_simulated_weights[inputIndex].GetPointerToVoxels();
 
       //identify scale factor
       double scale = reconstructor->_scale_cpu[inputIndex];
 
       //prepare weight image for bias field
       irtkRealImage wb = w;
+      irtkRealPixel *pwb = wb.GetPointerToVoxels();
 
-      //simulated slice
-      // irtkRealImage sim;
-      // sim.Initialize( slice.GetImageAttributes() );
-      // sim = 0;
       irtkRealImage wresidual(slice.GetImageAttributes());
       wresidual = 0;
+      irtkRealPixel *pr = wresidual.GetPointerToVoxels();
 
-      for (int i = 0; i < slice.GetX(); i++)
-        for (int j = 0; j < slice.GetY(); j++)
-          if (slice(i, j, 0) != -1) {
-        if (reconstructor->_simulated_weights[inputIndex](i, j, 0) > 0.99) {
+      for (size_t l = 0; l < pixels.size(); l++) {
+        int k = pixels[l];
+        if (simw[k] > 0.99) {
           //bias-correct and scale current slice
-          double eb = exp(-b(i, j, 0));
-          slice(i, j, 0) *= (eb * scale);
+          double eb = exp(-pb[k]);
+          irtkRealPixel value = ps[k];
+          value *= (eb * scale);
 
           //calculate weight image
-          wb(i, j, 0) = w(i, j, 0) * slice(i, j, 0);
+          pwb[k] = pw[k] * value;
 
           //calculate weighted residual image
           //make sure it is far from zero to avoid numerical instability
-          //if ((sim(i,j,0)>_low_intensity_cutoff*_max_intensity)&&(slice(i,j,0)>_low_intensity_cutoff*_max_intensity))
-          if ((reconstructor->_simulated_slices[inputIndex](i, j, 0) > 1) && (slice(i, j, 0) > 1)) {
-            wresidual(i, j, 0) = log(slice(i, j, 0) / reconstructor->_simulated_slices[inputIndex](i, j, 0)) * wb(i, j, 0);
+          if ((sim[k] > 1) && (value > 1)) {
+            pr[k] = log(value / sim[k]) * pwb[k];
           }
         }
         else {
           //do not take into account this voxel when calculating bias field
-          wresidual(i, j, 0) = 0;
-          wb(i, j, 0) = 0;
+          pr[k] = 0;
+          pwb[k] = 0;
         }
-          }
+      }
 
       //calculate bias field for this slice
       irtkGaussianBlurring<irtkRealPixel> gb(reconstructor->_sigma_bias);
@@ -3859,31 +4573,27 @@ public:
       gb.SetOutput(&wb);
       gb.Run();
 
+      //blurring may reallocate the images
+      pwb = wb.GetPointerToVoxels();
+      pr = wresidual.GetPointerToVoxels();
+
       //update bias field
       double sum = 0;
       double num = 0;
-      for (int i = 0; i < slice.GetX(); i++)
-        for (int j = 0; j < slice.GetY(); j++)
-          if (slice(i, j, 0) != -1) {
-        if (wb(i, j, 0) > 0)
-          b(i, j, 0) += wresidual(i, j, 0) / wb(i, j, 0);
-        sum += b(i, j, 0);
+      for (size_t l = 0; l < pixels.size(); l++) {
+        int k = pixels[l];
+        if (pwb[k] > 0)
+          pb[k] += pr[k] / pwb[k];
+        sum += pb[k];
         num++;
-          }
+      }
 
       //normalize bias field to have zero mean
-      if (!reconstructor->_global_bias_correction) {
-        double mean = 0;
-        if (num > 0)
-          mean = sum / num;
-        for (int i = 0; i < slice.GetX(); i++)
-          for (int j = 0; j < slice.GetY(); j++)
-            if ((slice(i, j, 0) != -1) && (num > 0)) {
-          b(i, j, 0) -= mean;
-            }
+      if (!reconstructor->_global_bias_correction && (num > 0)) {
+        double mean = sum / num;
+        for (size_t l = 0; l < pixels.size(); l++)
+          pb[pixels[l]] -= mean;
       }
-
-      reconstructor->_bias[inputIndex] = b;
     }
   }
 
@@ -3893,10 +4603,8 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_slice_cost, reconstructor->_em_slices, "Bias");
+    schedule.ParallelFor(*this);
   }
 
 };
@@ -3931,8 +4639,6 @@ void irtkReconstruction::Bias()
   ParallelBias parallelBias(this);
   parallelBias();
 
-  _bias[79].Write("biasField79CPU.nii");
-
   if (_debug)
     cout << "done. " << endl;
 }
@@ -3946,14 +4652,16 @@ public:
 
   void operator()(const blocked_range<size_t>& r) {
     for (size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
-      // read the current slice
-      irtkRealImage slice = reconstructor->_slices[inputIndex];
-
-      //read the current weight image
-      irtkRealImage& w = reconstructor->_weights[inputIndex];
+      PerfStats::Timer timer("Superresolution/slice", inputIndex);
+      // alias the current slice
+      const irtkRealPixel *ps = reconstructor->_slices[inputIndex].GetPointerToVoxels();
+      const vector<int> &pixels = reconstructor->_active_pixels[inputIndex];
+      int x = reconstructor->_slices[inputIndex].GetX();
 
-      //read the current bias image
-      irtkRealImage& b = reconstructor->_bias[inputIndex];
+      //alias the current weight and bias image and the simulated slice
+      const irtkRealPixel *w = reconstructor->_weights[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *b = reconstructor->_bias[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *sim = reconstructor->_simulated_slices[inputIndex].GetPointerToVoxels();
 
       //identify scale factor
       double scale = reconstructor->_scale_cpu[inputIndex];
@@ -3962,24 +4670,24 @@ public:
 
       //Distribute error to the volume
       POINT3D p;
-      for (int i = 0; i < slice.GetX(); i++)
-        for (int j = 0; j < slice.GetY(); j++)
-          if (slice(i, j, 0) != -1) {
+      for (size_t l = 0; l < pixels.size(); l++) {
+        int i = pixels[l] % x, j = pixels[l] / x;
         //bias correct and scale the slice
-        slice(i, j, 0) *= exp(-b(i, j, 0)) * scale;
+        irtkRealPixel e = ps[pixels[l]];
+        e *= exp(-b[pixels[l]]) * scale;
 
-        if (reconstructor->_simulated_slices[inputIndex](i, j, 0) > 0)
-          slice(i, j, 0) -= reconstructor->_simulated_slices[inputIndex](i, j, 0);
+        if (sim[pixels[l]] > 0)
+          e -= sim[pixels[l]];
         else
-          slice(i, j, 0) = 0;
+          e = 0;
 
         size_t n = reconstructor->_volcoeffs[inputIndex][i][j].size();
         for (int k = 0; k < n; k++) {
           p = reconstructor->_volcoeffs[inputIndex][i][j][k];
-          addon(p.x, p.y, p.z) += p.value * slice(i, j, 0) * w(i, j, 0) * reconstructor->_slice_weight_cpu[inputIndex];
-          confidence_map(p.x, p.y, p.z) += p.value * w(i, j, 0) * reconstructor->_slice_weight_cpu[inputIndex];
+          addon(p.x, p.y, p.z) += p.value * e * w[pixels[l]] * reconstructor->_slice_weight_cpu[inputIndex];
+          confidence_map(p.x, p.y, p.z) += p.value * w[pixels[l]] * reconstructor->_slice_weight_cpu[inputIndex];
         }
-          }
+      }
     } //end of loop for a slice inputIndex
   }
 
@@ -4014,10 +4722,8 @@ public:
 
   // execute
   void operator() () {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_reduce(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_slice_cost, reconstructor->_active_slices, "Superresolution");
+    schedule.ParallelReduce(*this);
   }
 };
 
@@ -4129,34 +4835,33 @@ public:
 
   void operator()(const blocked_range<size_t>& r) {
     for (size_t inputIndex = r.begin(); inputIndex < r.end(); ++inputIndex) {
-      // read the current slice
-      irtkRealImage slice = reconstructor->_slices[inputIndex];
-
-      //alias the current weight image
-      irtkRealImage& w = reconstructor->_weights[inputIndex];
+      // alias the current slice
+      const irtkRealPixel *ps = reconstructor->_slices[inputIndex].GetPointerToVoxels();
+      const vector<int> &pixels = reconstructor->_active_pixels[inputIndex];
 
-      //alias the current bias image
-      irtkRealImage& b = reconstructor->_bias[inputIndex];
+      //alias the current weight and bias image and the simulated slice
+      const irtkRealPixel *w = reconstructor->_weights[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *b = reconstructor->_bias[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *sim = reconstructor->_simulated_slices[inputIndex].GetPointerToVoxels();
+      const irtkRealPixel *simw = reconstructor->_simulated_weights[inputIndex].GetPointerToVoxels();
 
       //identify scale factor
       double scale = reconstructor->_scale_cpu[inputIndex];
 
       //calculate error
-      for (int i = 0; i < slice.GetX(); i++)
-        for (int j = 0; j < slice.GetY(); j++)
-          if (slice(i, j, 0) != -1) {
-        //bias correct and scale the slice
-        slice(i, j, 0) *= exp(-b(i, j, 0)) * scale;
-
+      for (size_t l = 0; l < pixels.size(); l++) {
+        int k = pixels[l];
         //otherwise the error has no meaning - it is equal to slice intensity
-        if (reconstructor->_simulated_weights[inputIndex](i, j, 0) > 0.99) {
-
-          slice(i, j, 0) -= reconstructor->_simulated_slices[inputIndex](i, j, 0);
+        if (simw[k] > 0.99) {
+          //bias correct and scale the slice
+          irtkRealPixel value = ps[k];
+          value *= exp(-b[k]) * scale;
+          value -= sim[k];
 
           //sigma and mix
-          double e = slice(i, j, 0);
-          sigma += e * e * w(i, j, 0);
-          mix += w(i, j, 0);
+          double e = value;
+          sigma += e * e * w[k];
+          mix += w[k];
 
           //_m
           if (e < min)
@@ -4166,7 +4871,7 @@ public:
 
           num++;
         }
-          }
+      }
     } //end of loop for a slice inputIndex
   }
 
@@ -4203,10 +4908,8 @@ public:
 
   // execute
   void operator() () {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_reduce(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_slice_cost, reconstructor->_em_slices, "MStep");
+    schedule.ParallelReduce(*this);
   }
 };
 
@@ -4308,10 +5011,8 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, 13),
+    irtkParallelFor(blocked_range<size_t>(0, 13),
       *this);
-    init.terminate();
   }
 
 };
@@ -4383,10 +5084,8 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, reconstructor->_reconstructed.GetX()),
+    irtkParallelFor(blocked_range<size_t>(0, reconstructor->_reconstructed.GetX()),
       *this);
-    init.terminate();
   }
 
 };
@@ -4587,38 +5286,31 @@ public:
         cout << inputIndex << " ";
       }
 
-      // alias the current slice
-      irtkRealImage& slice = reconstructor->_slices[inputIndex];
-
-      //read the current bias image
-      irtkRealImage b = reconstructor->_bias[inputIndex];
+      //alias the current bias image
+      const irtkRealPixel *pb = reconstructor->_bias[inputIndex].GetPointerToVoxels();
+      const vector<int> &pixels = reconstructor->_active_pixels[inputIndex];
+      int x = reconstructor->_slices[inputIndex].GetX();
 
       //read current scale factor
       double scale = reconstructor->_scale_cpu[inputIndex];
 
-      irtkRealPixel *pi = slice.GetPointerToVoxels();
-      irtkRealPixel *pb = b.GetPointerToVoxels();
-      for (int i = 0; i<slice.GetNumberOfVoxels(); i++) {
-        if ((*pi>-1) && (scale > 0))
-          *pb -= log(scale);
-        pb++;
-        pi++;
-      }
-
       //Distribute slice intensities to the volume
       POINT3D p;
-      for (int i = 0; i < slice.GetX(); i++)
-        for (int j = 0; j < slice.GetY(); j++)
-          if (slice(i, j, 0) != -1) {
+      for (size_t l = 0; l < pixels.size(); l++) {
+        int i = pixels[l] % x, j = pixels[l] / x;
+        //bias corrected for the scale
+        irtkRealPixel value = pb[pixels[l]];
+        if (scale > 0)
+          value -= log(scale);
         //number of volume voxels with non-zero coefficients for current slice voxel
         size_t n = reconstructor->_volcoeffs[inputIndex][i][j].size();
         //add contribution of current slice voxel to all voxel volumes
         //to which it contributes
         for (int k = 0; k < n; k++) {
           p = reconstructor->_volcoeffs[inputIndex][i][j][k];
-          bias(p.x, p.y, p.z) += p.value * b(i, j, 0);
+          bias(p.x, p.y, p.z) += p.value * value;
         }
-          }
+      }
       //end of loop for a slice inputIndex                
     }
   }
@@ -4643,10 +5335,8 @@ public:
 
   // execute
   void operator() () {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_reduce(blocked_range<size_t>(0, reconstructor->_slices.size()),
-      *this);
-    init.terminate();
+    irtkSliceSchedule schedule(reconstructor->_slices, reconstructor->_slice_cost, "NormaliseBias");
+    schedule.ParallelReduce(*this);
   }
 };
 
@@ -4821,6 +5511,49 @@ void irtkReconstruction::replaceSlices(string folder)
 
 }
 
+void irtkReconstruction::ReadTransformationTable(const char* filename)
+{
+  vector<irtkSliceContainer::Record> records;
+  irtkSliceContainer::ReadTable(filename, records);
+
+  if (records.size() != _slices.size()) {
+    cerr << "Slice table " << filename << " has " << records.size() << " slices, expected " << _slices.size() << endl;
+    exit(1);
+  }
+  cout << "Reading transformations from " << filename << endl;
+
+  _transformations.clear();
+  _transformations_gpu.clear();
+  for (unsigned int i = 0; i < records.size(); i++) {
+    irtkRigidTransformation transformation = irtkSliceContainer::GetTransformation(records[i]);
+    _transformations.push_back(transformation);
+    _transformations_gpu.push_back(transformation);
+  }
+}
+
+void irtkReconstruction::replaceSlices(const char* filename, const char* table)
+{
+  //replaces slices with packed slices, stack Id and transformations are taken from the table
+  vector<irtkSliceContainer::Record> records;
+  irtkSliceContainer::ReadTable(table, records);
+
+  vector<irtkRealImage> newSlices;
+  irtkSliceContainer::ReadImages(filename, records, newSlices);
+
+  vector<double> thickness;
+  vector<int> stackId;
+  vector<irtkRigidTransformation> transforms;
+  for (unsigned int i = 0; i < records.size(); i++)
+  {
+    thickness.push_back(records[i].dz);
+    stackId.push_back(records[i].stackIndex);
+    transforms.push_back(irtkSliceContainer::GetTransformation(records[i]));
+  }
+  std::cout << "replacing every slice with " << newSlices.size() << " slices from " << filename << std::endl;
+
+  SetSlicesAndTransformations(newSlices, transforms, stackId, thickness);
+}
+
 void irtkReconstruction::transformManualMaskwithPSF(irtkRealImage manualMask, irtkGenericImage<float>* transformedManualMask)
 {
 
@@ -4872,13 +5605,15 @@ void irtkReconstruction::SaveBiasFields()
   char buffer[256];
   for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
     sprintf(buffer, "bias%i.nii.gz", inputIndex);
-    _bias[inputIndex].Write(buffer);
+    if (_writer != NULL) _writer->Write(_bias[inputIndex], buffer);
+    else _bias[inputIndex].Write(buffer);
   }
 }
 
 void irtkReconstruction::SaveConfidenceMap()
 {
-  _confidence_map.Write("confidence-map.nii.gz");
+  if (_writer != NULL) _writer->Write(_confidence_map, "confidence-map.nii.gz");
+  else _confidence_map.Write("confidence-map.nii.gz");
 }
 
 void irtkReconstruction::SaveSlices()
@@ -4887,7 +5622,8 @@ void irtkReconstruction::SaveSlices()
   for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++)
   {
     sprintf(buffer, "slice%i.nii.gz", inputIndex);
-    _slices[inputIndex].Write(buffer);
+    if (_writer != NULL) _writer->Write(_slices[inputIndex], buffer);
+    else _slices[inputIndex].Write(buffer);
   }
 }
 
@@ -4896,7 +5632,8 @@ void irtkReconstruction::SaveWeights()
   char buffer[256];
   for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
     sprintf(buffer, "weights%i.nii.gz", inputIndex);
-    _weights[inputIndex].Write(buffer);
+    if (_writer != NULL) _writer->Write(_weights[inputIndex], buffer);
+    else _weights[inputIndex].Write(buffer);
   }
 }
 
@@ -4908,16 +5645,50 @@ void irtkReconstruction::SaveTransformations()
     t->PutMatrix(_reconstructed.GetWorldToImageMatrix() * _transformations[inputIndex].GetMatrix() * _slices[inputIndex].GetImageToWorldMatrix());
 
     sprintf(buffer, "croppedSliceTransformation%i.dof", inputIndex);
-    _transformations[inputIndex].irtkTransformation::Write(buffer);
+    if (_writer != NULL) _writer->Write(_transformations[inputIndex], buffer);
+    else _transformations[inputIndex].irtkTransformation::Write(buffer);
 
     sprintf(buffer, "croppedSliceToVolumeTransformation%i.dof", inputIndex);
-    t->irtkTransformation::Write(buffer);
+    if (_writer != NULL) _writer->Write(*t, buffer);
+    else t->irtkTransformation::Write(buffer);
+    delete t;
 
     //sprintf(buffer, "sliceTransformation_gpu%i.dof", inputIndex);
     //_transformations_gpu[inputIndex].irtkTransformation::Write(buffer);
   }
 }
 
+void irtkReconstruction::SaveSlices(const char *filename)
+{
+  irtkRealImage *packed = irtkSliceContainer::Pack(_slices);
+  if (_writer != NULL) _writer->Write(packed, filename);
+  else {
+    packed->Write(filename);
+    delete packed;
+  }
+}
+
+void irtkReconstruction::SaveWeights(const char *filename)
+{
+  irtkRealImage *packed = irtkSliceContainer::Pack(_weights);
+  if (_writer != NULL) _writer->Write(packed, filename);
+  else {
+    packed->Write(filename);
+    delete packed;
+  }
+}
+
+void irtkReconstruction::SaveTransformations(const char *filename)
+{
+  vector<irtkSliceContainer::Record> records;
+  irtkMatrix w2i = _reconstructed.GetWorldToImageMatrix();
+  for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    irtkMatrix sliceToVolume = w2i * _transformations[inputIndex].GetMatrix() * _slices[inputIndex].GetImageToWorldMatrix();
+    records.push_back(irtkSliceContainer::MakeRecord(_slices[inputIndex], _stack_index[inputIndex], _transformations[inputIndex], sliceToVolume));
+  }
+  irtkSliceContainer::WriteTable(filename, records);
+}
+
 void irtkReconstruction::GetTransformations(vector<irtkRigidTransformation> &transformations)
 {
   transformations.clear();
@@ -4927,6 +5698,11 @@ void irtkReconstruction::GetTransformations(vector<irtkRigidTransformation> &tra
   }
 }
 
+void irtkReconstruction::GetSliceWeights(vector<double> &weights)
+{
+  weights = _slice_weight_cpu;
+}
+
 void irtkReconstruction::GetSlices(vector<irtkRealImage> &slices)
 {
   slices.clear();
@@ -4934,6 +5710,80 @@ void irtkReconstruction::GetSlices(vector<irtkRealImage> &slices)
     slices.push_back(_slices[i]);
 }
 
+static double ImageBytes(const vector<irtkRealImage> &images)
+{
+  double bytes = 0;
+  for (unsigned int i = 0; i < images.size(); i++)
+    bytes += double(images[i].GetNumberOfVoxels()) * sizeof(irtkRealPixel);
+  return bytes;
+}
+
+static void PrintMemory(ostream &out, const char *name, double current, double predicted)
+{
+  out << name << "\t" << current / 1048576.0 << "\t" << predicted / 1048576.0 << endl;
+}
+
+double irtkReconstruction::MemoryReport(ostream &out, int threads, double &current)
+{
+  //the per slice images all have the geometry of the slices
+  double slices = ImageBytes(_slices);
+
+  //slice-volume matrix: a vector per slice voxel and the PSF support in the
+  //volume for each slice voxel inside the slice mask
+  double vx, vy, vz;
+  _reconstructed.GetPixelSize(&vx, &vy, &vz);
+  double coeffs = 0, predictedCoeffs = 0;
+  for (unsigned int inputIndex = 0; inputIndex < _slices.size(); inputIndex++) {
+    irtkRealImage &slice = _slices[inputIndex];
+    double dx, dy, dz;
+    slice.GetPixelSize(&dx, &dy, &dz);
+    double support = (ceil(2 * dx / vx) + 1) * (ceil(2 * dy / vx) + 1) * (ceil(2 * dz / vx) + 1);
+    long inside = 0;
+    for (int i = 0; i < slice.GetX(); i++)
+      for (int j = 0; j < slice.GetY(); j++)
+        if (slice(i, j, 0) != -1) inside++;
+    predictedCoeffs += sizeof(SLICECOEFFS) + slice.GetX() * sizeof(vector<VOXELCOEFFS>)
+      + double(slice.GetX()) * slice.GetY() * sizeof(VOXELCOEFFS) + inside * support * sizeof(POINT3D);
+
+    if (inputIndex < _volcoeffs.size()) {
+      coeffs += sizeof(SLICECOEFFS) + _volcoeffs[inputIndex].capacity() * sizeof(vector<VOXELCOEFFS>);
+      for (unsigned int i = 0; i < _volcoeffs[inputIndex].size(); i++) {
+        coeffs += _volcoeffs[inputIndex][i].capacity() * sizeof(VOXELCOEFFS);
+        for (unsigned int j = 0; j < _volcoeffs[inputIndex][i].size(); j++)
+          coeffs += _volcoeffs[inputIndex][i][j].capacity() * sizeof(POINT3D);
+      }
+    }
+  }
+
+  //reconstructed volume, mask, volume weights, confidence map and the float copy
+  double volume = double(_reconstructed.GetNumberOfVoxels()) * sizeof(irtkRealPixel);
+  double volumes = 4 * volume + double(_reconstructed_gpu.GetNumberOfVoxels()) * sizeof(float);
+  double currentVolumes = volume + double(_mask.GetNumberOfVoxels() + _volume_weights.GetNumberOfVoxels()
+    + _confidence_map.GetNumberOfVoxels()) * sizeof(irtkRealPixel) + double(_reconstructed_gpu.GetNumberOfVoxels()) * sizeof(float);
+
+  //temporary volumes: addon and confidence map of each Superresolution thread,
+  //13 directions and 2 copies in AdaptiveRegularization
+  double temporary = max(2.0 * threads, 15.0) * volume;
+
+  out << "structure\tcurrent (MB)\tpredicted (MB)" << endl;
+  PrintMemory(out, "slices", slices, slices);
+  PrintMemory(out, "weights", ImageBytes(_weights), slices);
+  PrintMemory(out, "bias", ImageBytes(_bias), slices);
+  PrintMemory(out, "simulated slices", ImageBytes(_simulated_slices), slices);
+  PrintMemory(out, "simulated weights", ImageBytes(_simulated_weights), slices);
+  PrintMemory(out, "simulated inside", ImageBytes(_simulated_inside), slices);
+  PrintMemory(out, "resampled slices", ImageBytes(_slices_resampled), ImageBytes(_slices_resampled));
+  PrintMemory(out, "slice-volume matrix", coeffs, max(coeffs, predictedCoeffs));
+  PrintMemory(out, "volumes", currentVolumes, volumes);
+  PrintMemory(out, "temporary volumes", 0, temporary);
+
+  current = slices + ImageBytes(_weights) + ImageBytes(_bias) + ImageBytes(_simulated_slices) + ImageBytes(_simulated_weights)
+    + ImageBytes(_simulated_inside) + ImageBytes(_slices_resampled) + coeffs + currentVolumes;
+  double predicted = 6 * slices + ImageBytes(_slices_resampled) + max(coeffs, predictedCoeffs) + volumes + temporary;
+  PrintMemory(out, "total", current, predicted);
+  return predicted;
+}
+
 void irtkReconstruction::SlicesInfo(const char* filename)
 {
   std::ofstream info;
@@ -4974,6 +5824,179 @@ void irtkReconstruction::SlicesInfo(const char* filename)
   info.close();
 }
 
+/* Checkpoint */
+
+#define IRTK_CHECKPOINT_MAGIC   "IRTKCKPT"
+#define IRTK_CHECKPOINT_VERSION 2
+
+static void WriteCheckpointImage(irtkCofstream &to, irtkRealImage &image)
+{
+  irtkImageAttributes attr = image.GetImageAttributes();
+  int dims[4] = { attr._x, attr._y, attr._z, attr._t };
+  double geometry[17] = { attr._dx, attr._dy, attr._dz, attr._dt,
+    attr._xorigin, attr._yorigin, attr._zorigin, attr._torigin,
+    attr._xaxis[0], attr._xaxis[1], attr._xaxis[2],
+    attr._yaxis[0], attr._yaxis[1], attr._yaxis[2],
+    attr._zaxis[0], attr._zaxis[1], attr._zaxis[2] };
+  to.WriteAsInt(dims, 4);
+  to.WriteAsDouble(geometry, 17);
+  if (image.GetNumberOfVoxels() > 0) {
+    to.WriteAsDouble(image.GetPointerToVoxels(), image.GetNumberOfVoxels());
+  }
+}
+
+static void ReadCheckpointImage(irtkCifstream &from, irtkRealImage &image)
+{
+  int dims[4];
+  double geometry[17];
+  from.ReadAsInt(dims, 4);
+  from.ReadAsDouble(geometry, 17);
+  if (dims[0] * dims[1] * dims[2] * dims[3] == 0) {
+    image = irtkRealImage();
+    return;
+  }
+
+  irtkImageAttributes attr;
+  attr._x = dims[0];
+  attr._y = dims[1];
+  attr._z = dims[2];
+  attr._t = dims[3];
+  attr._dx = geometry[0];
+  attr._dy = geometry[1];
+  attr._dz = geometry[2];
+  attr._dt = geometry[3];
+  attr._xorigin = geometry[4];
+  attr._yorigin = geometry[5];
+  attr._zorigin = geometry[6];
+  attr._torigin = geometry[7];
+  for (int i = 0; i < 3; i++) {
+    attr._xaxis[i] = geometry[8 + i];
+    attr._yaxis[i] = geometry[11 + i];
+    attr._zaxis[i] = geometry[14 + i];
+  }
+  image.Initialize(attr, false);
+  from.ReadAsDouble(image.GetPointerToVoxels(), image.GetNumberOfVoxels());
+}
+
+static void WriteCheckpointTransformations(irtkCofstream &to, vector<irtkRigidTransformation> &transformations)
+{
+  vector<double> dofs(transformations.size() * 6);
+  for (unsigned int i = 0; i < transformations.size(); i++) {
+    for (int j = 0; j < 6; j++) dofs[6 * i + j] = transformations[i].Get(j);
+  }
+  to.WriteAsInt(transformations.size());
+  if (dofs.size() > 0) to.WriteAsDouble(&dofs[0], dofs.size());
+}
+
+static void ReadCheckpointTransformations(irtkCifstream &from, vector<irtkRigidTransformation> &transformations)
+{
+  int n;
+  from.ReadAsInt(&n, 1);
+  vector<double> dofs(n * 6);
+  if (n > 0) from.ReadAsDouble(&dofs[0], dofs.size());
+  transformations.resize(n);
+  for (int i = 0; i < n; i++) {
+    for (int j = 0; j < 6; j++) transformations[i].Put(j, dofs[6 * i + j]);
+  }
+}
+
+static void WriteCheckpointVector(irtkCofstream &to, vector<int> &v)
+{
+  to.WriteAsInt(v.size());
+  if (v.size() > 0) to.WriteAsInt(&v[0], v.size());
+}
+
+static void ReadCheckpointVector(irtkCifstream &from, vector<int> &v)
+{
+  int n;
+  from.ReadAsInt(&n, 1);
+  v.resize(n);
+  if (n > 0) from.ReadAsInt(&v[0], n);
+}
+
+void irtkReconstruction::WriteCheckpoint(const char *filename, int iteration)
+{
+  // Written to a temporary file first, so that a job killed while writing
+  // leaves the previous checkpoint intact
+  string tmpname = string(filename) + ".tmp";
+  irtkCofstream to;
+  to.Open(tmpname.c_str());
+
+  to.WriteAsChar((char *)IRTK_CHECKPOINT_MAGIC, 8);
+  to.WriteAsInt(IRTK_CHECKPOINT_VERSION);
+  to.WriteAsInt(iteration);
+
+  //slice geometry, to check that the checkpoint belongs to the same slices
+  vector<int> dims;
+  for (unsigned int i = 0; i < _slices.size(); i++) {
+    dims.push_back(_slices[i].GetX());
+    dims.push_back(_slices[i].GetY());
+  }
+  WriteCheckpointVector(to, dims);
+
+  WriteCheckpointTransformations(to, _transformations);
+  WriteCheckpointTransformations(to, _transformations_gpu);
+
+  to.WriteAsInt(_have_mask);
+  WriteCheckpointImage(to, _mask);
+  WriteCheckpointImage(to, _reconstructed);
+
+  to.Close();
+
+  if (rename(tmpname.c_str(), filename) != 0) {
+    cerr << "Could not write checkpoint " << filename << endl;
+    exit(1);
+  }
+}
+
+int irtkReconstruction::ReadCheckpoint(const char *filename)
+{
+  irtkCifstream from;
+  from.Open(filename);
+
+  char magic[8];
+  int version, iteration;
+  from.ReadAsChar(magic, 8);
+  if (strncmp(magic, IRTK_CHECKPOINT_MAGIC, 8) != 0) {
+    cerr << filename << " is not a reconstruction checkpoint" << endl;
+    exit(1);
+  }
+  from.ReadAsInt(&version, 1);
+  if (version != IRTK_CHECKPOINT_VERSION) {
+    cerr << "Checkpoint " << filename << " has unsupported version " << version << endl;
+    exit(1);
+  }
+  from.ReadAsInt(&iteration, 1);
+
+  vector<int> dims;
+  ReadCheckpointVector(from, dims);
+  bool match = (dims.size() == 2 * _slices.size());
+  for (unsigned int i = 0; match && (i < _slices.size()); i++) {
+    match = (dims[2 * i] == _slices[i].GetX()) && (dims[2 * i + 1] == _slices[i].GetY());
+  }
+  if (!match) {
+    cerr << "Checkpoint " << filename << " does not match the slices of this reconstruction" << endl;
+    exit(1);
+  }
+
+  ReadCheckpointTransformations(from, _transformations);
+  ReadCheckpointTransformations(from, _transformations_gpu);
+
+  int have_mask;
+  from.ReadAsInt(&have_mask, 1);
+  _have_mask = (have_mask != 0);
+  ReadCheckpointImage(from, _mask);
+  ReadCheckpointImage(from, _reconstructed);
+  from.Close();
+
+  //the GPU volume is initialised from this copy by SyncGPU
+  _reconstructed_gpu = _reconstructed;
+  _template_created = true;
+
+  cout << "Resuming from checkpoint " << filename << " at iteration " << iteration << endl;
+  return iteration;
+}
+
 /* end Set/Get/Save operations */
 
 /* Package specific functions */
@@ -5095,6 +6118,7 @@ void irtkReconstruction::HalfImage(irtkRealImage image, vector<irtkRealImage>& s
 
 void irtkReconstruction::PackageToVolume(vector<irtkRealImage>& stacks, vector<int> &pack_num, bool evenodd, bool half, int half_iter)
 {
+  PerfStats::Timer timer("Registration/PackageToVolume");
   irtkImageRigidRegistrationWithPadding rigidregistration;
   irtkGreyImage t, s;
   //irtkRigidTransformation transformation;
@@ -5139,10 +6163,7 @@ void irtkReconstruction::PackageToVolume(vector<irtkRealImage>& stacks, vector<i
       //put origin in target to zero
       irtkRigidTransformation offset;
       ResetOrigin(t, offset);
-      irtkMatrix mo = offset.GetMatrix();
-      irtkMatrix m = _transformations[firstSliceIndex].GetMatrix();
-      m = m*mo;
-      _transformations[firstSliceIndex].PutMatrix(m);
+      _transformations[firstSliceIndex].PostMultiply(offset);
 
       rigidregistration.SetInput(&t, &s);
       rigidregistration.SetOutput(&_transformations[firstSliceIndex]);
@@ -5152,10 +6173,8 @@ void irtkReconstruction::PackageToVolume(vector<irtkRealImage>& stacks, vector<i
       rigidregistration.Run();
 
       //undo the offset
-      mo.Invert();
-      m = _transformations[firstSliceIndex].GetMatrix();
-      m = m*mo;
-      _transformations[firstSliceIndex].PutMatrix(m);
+      offset.Invert();
+      _transformations[firstSliceIndex].PostMultiply(offset);
 
       if (_debug) {
         sprintf(buffer, "transformation%i-%i.dof", i, j);
@@ -0,0 +1,168 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+#include "irtkSliceArena.h"
+#include <irtkParallel.h>
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef WIN32
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+/// Alignment of the blocks and of every slice in them
+static const size_t IRTK_SLICE_ARENA_ALIGNMENT = 64;
+
+/// Allocates an aligned block, NULL if out of memory
+static void *irtkAlignedAlloc(size_t bytes)
+{
+#ifdef WIN32
+  return _aligned_malloc(bytes, IRTK_SLICE_ARENA_ALIGNMENT);
+#else
+  void *block = NULL;
+  if (posix_memalign(&block, IRTK_SLICE_ARENA_ALIGNMENT, bytes) != 0) return NULL;
+  return block;
+#endif
+}
+
+/// Frees a block of irtkAlignedAlloc
+static void irtkAlignedFree(void *block)
+{
+#ifdef WIN32
+  _aligned_free(block);
+#else
+  free(block);
+#endif
+}
+
+class ParallelSliceArenaCopy {
+  const vector<vector<irtkRealImage> *> &fields;
+  const vector<irtkRealPixel *> &blocks;
+  const irtkSliceArena *arena;
+
+public:
+  ParallelSliceArenaCopy(const vector<vector<irtkRealImage> *> &_fields,
+    const vector<irtkRealPixel *> &_blocks, const irtkSliceArena *_arena) :
+    fields(_fields), blocks(_blocks), arena(_arena) { }
+
+  void operator() (const blocked_range<size_t> &r) const {
+    for (size_t l = r.begin(); l != r.end(); ++l) {
+      const irtkSliceArena::Entry &entry = arena->_table[l];
+      for (size_t f = 0; f < fields.size(); f++) {
+        irtkRealImage &image = (*fields[f])[l];
+        irtkRealPixel *data = blocks[f] + entry.offset;
+        memcpy(data, image.GetPointerToVoxels(), image.GetNumberOfVoxels() * sizeof(irtkRealPixel));
+        image.View(entry.attr, data);
+      }
+    }
+  }
+
+  // execute
+  void operator() () const {
+    irtkParallelFor(blocked_range<size_t>(0, arena->_table.size()), *this);
+  }
+
+};
+
+irtkSliceArena::irtkSliceArena()
+{
+  _size = 0;
+  _countedSize = 0;
+}
+
+irtkSliceArena::~irtkSliceArena()
+{
+  this->Clear();
+}
+
+void irtkSliceArena::Attach(const vector<vector<irtkRealImage> *> &fields)
+{
+  const size_t align = IRTK_SLICE_ARENA_ALIGNMENT / sizeof(irtkRealPixel);
+
+  if (fields.empty()) return;
+
+  // Side table of the first field, the others must match it
+  const vector<irtkRealImage> &first = *fields[0];
+  vector<Entry> table(first.size());
+  size_t size = 0;
+  for (size_t l = 0; l < first.size(); l++) {
+    table[l].offset = size;
+    table[l].attr = first[l].GetImageAttributes();
+    size += (first[l].GetNumberOfVoxels() + align - 1) / align * align;
+  }
+  for (size_t f = 1; f < fields.size(); f++) {
+    bool match = (fields[f]->size() == first.size());
+    for (size_t l = 0; match && (l < first.size()); l++) {
+      match = ((*fields[f])[l].GetNumberOfVoxels() == first[l].GetNumberOfVoxels());
+    }
+    if (!match) {
+      cerr << "irtkSliceArena::Attach: Field " << f << " does not match the slices of the first field" << endl;
+      exit(1);
+    }
+  }
+
+  // Allocate one block per field, the pages are touched by the copy
+  vector<irtkRealPixel *> blocks(fields.size(), NULL);
+  for (size_t f = 0; f < fields.size(); f++) {
+    void *block = irtkAlignedAlloc(max(size, size_t(1)) * sizeof(irtkRealPixel));
+    if (block == NULL) {
+      cerr << "irtkSliceArena::Attach: Failed to allocate " << size * sizeof(irtkRealPixel) << " bytes" << endl;
+      exit(1);
+    }
+    blocks[f] = (irtkRealPixel *)block;
+  }
+  long counted = irtkMemoryStatistics::Allocated(IRTK_MEMORY_SLICE_ARENA, long(size * sizeof(irtkRealPixel) * fields.size()));
+
+  // Copy slices into the new blocks before the old ones are freed, as the
+  // images may still be views of them
+  vector<irtkRealPixel *> old;
+  old.swap(_blocks);
+  _table.swap(table);
+  _size = size;
+  ParallelSliceArenaCopy copy(fields, blocks, this);
+  copy();
+  _blocks.swap(blocks);
+
+  for (size_t f = 0; f < old.size(); f++) {
+    irtkAlignedFree(old[f]);
+  }
+  irtkMemoryStatistics::Deallocated(IRTK_MEMORY_SLICE_ARENA, _countedSize);
+  _countedSize = counted;
+}
+
+void irtkSliceArena::Clear()
+{
+  for (size_t f = 0; f < _blocks.size(); f++) {
+    irtkAlignedFree(_blocks[f]);
+  }
+  irtkMemoryStatistics::Deallocated(IRTK_MEMORY_SLICE_ARENA, _countedSize);
+  _countedSize = 0;
+  _blocks.clear();
+  _table.clear();
+  _size = 0;
+}
@@ -0,0 +1,282 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+#include "irtkSliceContainer.h"
+#include <irtkFileToImage.h>
+
+#include <string.h>
+
+/// Header of the slice table
+struct irtkSliceTableHeader
+{
+  char magic[8];
+  int count;
+  int recordSize;
+};
+
+static const char IRTK_SLICE_TABLE_MAGIC[8] = { 'I', 'R', 'T', 'K', 'S', 'L', 'C', '1' };
+
+irtkSliceContainer::Record irtkSliceContainer::MakeRecord(const irtkRealImage &slice, int stackIndex, irtkRigidTransformation &transformation, const irtkMatrix &sliceToVolume)
+{
+  Record record;
+  memset(&record, 0, sizeof(Record));
+
+  irtkImageAttributes attr = slice.GetImageAttributes();
+  record.stackIndex = stackIndex;
+  record.x = attr._x;
+  record.y = attr._y;
+  record.dx = attr._dx;
+  record.dy = attr._dy;
+  record.dz = attr._dz;
+  record.xorigin = attr._xorigin;
+  record.yorigin = attr._yorigin;
+  record.zorigin = attr._zorigin;
+  for (int i = 0; i < 3; i++) {
+    record.xaxis[i] = attr._xaxis[i];
+    record.yaxis[i] = attr._yaxis[i];
+    record.zaxis[i] = attr._zaxis[i];
+  }
+  for (int i = 0; i < 6; i++) {
+    record.dofs[i] = transformation.Get(i);
+  }
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      record.sliceToVolume[4 * i + j] = sliceToVolume(i, j);
+    }
+  }
+  return record;
+}
+
+irtkImageAttributes irtkSliceContainer::GetImageAttributes(const Record &record)
+{
+  irtkImageAttributes attr;
+  attr._x = record.x;
+  attr._y = record.y;
+  attr._z = 1;
+  attr._t = 1;
+  attr._dx = record.dx;
+  attr._dy = record.dy;
+  attr._dz = record.dz;
+  attr._xorigin = record.xorigin;
+  attr._yorigin = record.yorigin;
+  attr._zorigin = record.zorigin;
+  for (int i = 0; i < 3; i++) {
+    attr._xaxis[i] = record.xaxis[i];
+    attr._yaxis[i] = record.yaxis[i];
+    attr._zaxis[i] = record.zaxis[i];
+  }
+  return attr;
+}
+
+irtkRigidTransformation irtkSliceContainer::GetTransformation(const Record &record)
+{
+  irtkRigidTransformation transformation;
+  for (int i = 0; i < 6; i++) {
+    transformation.Put(i, record.dofs[i]);
+  }
+  return transformation;
+}
+
+void irtkSliceContainer::WriteTable(const char *filename, const std::vector<Record> &records)
+{
+  irtkSliceTableHeader header;
+  memcpy(header.magic, IRTK_SLICE_TABLE_MAGIC, 8);
+  header.count = records.size();
+  header.recordSize = sizeof(Record);
+
+  FILE *fp = fopen(filename, "wb");
+  if (fp == NULL) {
+    cerr << "irtkSliceContainer::WriteTable: Can't open file " << filename << endl;
+    exit(1);
+  }
+  bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  if (ok && (records.size() > 0)) {
+    ok = (fwrite(&records[0], sizeof(Record), records.size(), fp) == records.size());
+  }
+  if ((fclose(fp) != 0) || !ok) {
+    cerr << "irtkSliceContainer::WriteTable: Error writing file " << filename << endl;
+    exit(1);
+  }
+}
+
+/// Opens table and checks its header
+static FILE *irtkOpenSliceTable(const char *filename, irtkSliceTableHeader &header)
+{
+  FILE *fp = fopen(filename, "rb");
+  if (fp == NULL) {
+    cerr << "irtkSliceContainer: Can't open file " << filename << endl;
+    exit(1);
+  }
+  if ((fread(&header, sizeof(header), 1, fp) != 1) ||
+      (memcmp(header.magic, IRTK_SLICE_TABLE_MAGIC, 8) != 0) ||
+      (header.recordSize != sizeof(irtkSliceContainer::Record)) || (header.count < 0)) {
+    cerr << "irtkSliceContainer: " << filename << " is not a slice table" << endl;
+    exit(1);
+  }
+  return fp;
+}
+
+void irtkSliceContainer::ReadTable(const char *filename, std::vector<Record> &records)
+{
+  irtkSliceTableHeader header;
+  FILE *fp = irtkOpenSliceTable(filename, header);
+
+  records.resize(header.count);
+  if ((header.count > 0) && (fread(&records[0], sizeof(Record), header.count, fp) != (size_t)header.count)) {
+    cerr << "irtkSliceContainer::ReadTable: Error reading file " << filename << endl;
+    exit(1);
+  }
+  fclose(fp);
+}
+
+irtkSliceContainer::Record irtkSliceContainer::ReadRecord(const char *filename, int index)
+{
+  irtkSliceTableHeader header;
+  FILE *fp = irtkOpenSliceTable(filename, header);
+
+  Record record;
+  if ((index < 0) || (index >= header.count) ||
+      (fseek(fp, sizeof(header) + (long)index * sizeof(Record), SEEK_SET) != 0) ||
+      (fread(&record, sizeof(Record), 1, fp) != 1)) {
+    cerr << "irtkSliceContainer::ReadRecord: Can't read slice " << index << " of " << filename << endl;
+    exit(1);
+  }
+  fclose(fp);
+  return record;
+}
+
+class ParallelSlicePacking {
+  const std::vector<irtkRealImage> &images;
+  irtkRealImage *packed;
+
+public:
+  ParallelSlicePacking(const std::vector<irtkRealImage> &_images, irtkRealImage *_packed) :
+    images(_images), packed(_packed) { }
+
+  void operator() (const blocked_range<size_t> &r) const {
+    for (size_t l = r.begin(); l != r.end(); ++l) {
+      const irtkRealImage &image = images[l];
+      for (int j = 0; j < image.GetY(); j++) {
+        const irtkRealPixel *src = image.GetPointerToVoxels(0, j, 0);
+        irtkRealPixel *dst = packed->GetPointerToVoxels(0, j, 0, l);
+        for (int i = 0; i < image.GetX(); i++) {
+          dst[i] = src[i];
+        }
+      }
+    }
+  }
+
+  // execute
+  void operator() () const {
+    irtkParallelFor(blocked_range<size_t>(0, images.size()), *this);
+  }
+};
+
+irtkRealImage *irtkSliceContainer::Pack(const std::vector<irtkRealImage> &images)
+{
+  if (images.empty()) {
+    cerr << "irtkSliceContainer::Pack: No slices" << endl;
+    exit(1);
+  }
+
+  irtkImageAttributes attr;
+  attr._x = 0;
+  attr._y = 0;
+  for (unsigned int l = 0; l < images.size(); l++) {
+    if (images[l].GetZ() != 1) {
+      cerr << "irtkSliceContainer::Pack: Image " << l << " is not a slice" << endl;
+      exit(1);
+    }
+    if (images[l].GetX() > attr._x) attr._x = images[l].GetX();
+    if (images[l].GetY() > attr._y) attr._y = images[l].GetY();
+  }
+  attr._z = 1;
+  attr._t = images.size();
+  images[0].GetPixelSize(&attr._dx, &attr._dy, &attr._dz);
+
+  irtkRealImage *packed = new irtkRealImage(attr);
+  ParallelSlicePacking packing(images, packed);
+  packing();
+  return packed;
+}
+
+/// Reads frame index of the packed image into image with the slice geometry
+static void irtkReadPackedSlice(irtkFileToImage *reader, const irtkSliceContainer::Record &record, int index, irtkRealImage &image)
+{
+  irtkRealImage region;
+  reader->GetRegionAs(region, 0, 0, 0, index, record.x, record.y, 1, index + 1);
+  image.Initialize(irtkSliceContainer::GetImageAttributes(record), false);
+  memcpy(image.GetPointerToVoxels(), region.GetPointerToVoxels(), image.GetNumberOfVoxels() * sizeof(irtkRealPixel));
+}
+
+class ParallelSliceUnpacking {
+  const char *filename;
+  const std::vector<irtkSliceContainer::Record> &records;
+  std::vector<irtkRealImage> &images;
+
+public:
+  ParallelSliceUnpacking(const char *_filename, const std::vector<irtkSliceContainer::Record> &_records, std::vector<irtkRealImage> &_images) :
+    filename(_filename), records(_records), images(_images) { }
+
+  void operator() (const blocked_range<size_t> &r) const {
+    // Each task reads its range of frames with its own reader
+    irtkFileToImage *reader = irtkFileToImage::New(filename);
+    for (size_t l = r.begin(); l != r.end(); ++l) {
+      irtkReadPackedSlice(reader, records[l], l, images[l]);
+    }
+    delete reader;
+  }
+
+  // execute
+  void operator() () const {
+    irtkParallelFor(blocked_range<size_t>(0, records.size(), 64), *this);
+  }
+};
+
+void irtkSliceContainer::ReadImages(const char *filename, const std::vector<Record> &records, std::vector<irtkRealImage> &images)
+{
+  irtkFileToImage *reader = irtkFileToImage::New(filename);
+
+  images.resize(records.size());
+  if (reader->IsRandomAccess()) {
+    delete reader;
+    ParallelSliceUnpacking unpacking(filename, records, images);
+    unpacking();
+  } else {
+    // Frames are read in order, so the gzip stream is only decompressed once
+    for (unsigned int l = 0; l < records.size(); l++) {
+      irtkReadPackedSlice(reader, records[l], l, images[l]);
+    }
+    delete reader;
+  }
+}
+
+void irtkSliceContainer::ReadImage(const char *filename, const Record &record, int index, irtkRealImage &image)
+{
+  irtkFileToImage *reader = irtkFileToImage::New(filename);
+  irtkReadPackedSlice(reader, record, index, image);
+  delete reader;
+}
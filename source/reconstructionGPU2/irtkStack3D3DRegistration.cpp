@@ -87,10 +87,7 @@ public:
       irtkGreyImage source = stacks[i];
 
       //include offset in trasformation   
-      irtkMatrix mo = offset.GetMatrix();
-      irtkMatrix m = stack_transformations[i].GetMatrix();
-      m = m*mo;
-      stack_transformations[i].PutMatrix(m);
+      stack_transformations[i].PostMultiply(offset);
 
       //perform rigid registration
       registration.SetInput(&target, &source);
@@ -106,10 +103,10 @@ public:
       registration.SetTargetPadding(0);
       registration.Run();
 
-      mo.Invert();
-      m = stack_transformations[i].GetMatrix();
-      m = m*mo;
-      stack_transformations[i].PutMatrix(m);
+      //offset is shared by all stacks, undo it with a copy
+      irtkHomogeneousTransformation undo(offset);
+      undo.Invert();
+      stack_transformations[i].PostMultiply(undo);
 
       //stack_transformations[i] = transformation;            
 
@@ -129,10 +126,8 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, stacks.size()),
+    irtkParallelFor(blocked_range<size_t>(0, stacks.size()),
       *this);
-    init.terminate();
   }
 
 };
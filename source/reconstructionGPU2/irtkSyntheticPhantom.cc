@@ -0,0 +1,159 @@
+/*=========================================================================
+* GPU accelerated motion compensation for MRI
+*
+* Copyright (c) 2016 Bernhard Kainz, Amir Alansary, Maria Kuklisova-Murgasova,
+* Kevin Keraudren, Markus Steinberger
+* (b.kainz@imperial.ac.uk)
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+* IN THE SOFTWARE.
+=========================================================================*/
+
+#include "irtkSyntheticPhantom.h"
+#include <irtkNoise.h>
+
+#include <boost/random.hpp>
+
+const double irtkSyntheticPhantom::FOV = 120;
+
+irtkSyntheticPhantom::irtkSyntheticPhantom(int stacks, int slices, double resolution,
+  double motion, double noise, int seed)
+{
+  _stacks = stacks;
+  _slices = slices;
+  _resolution = resolution;
+  _motion = motion;
+  _noise = noise;
+  _seed = seed;
+}
+
+static bool inside(double x, double y, double z, double cx, double cy, double cz, double a, double b, double c)
+{
+  x = (x - cx) / a;
+  y = (y - cy) / b;
+  z = (z - cz) / c;
+  return x * x + y * y + z * z <= 1;
+}
+
+double irtkSyntheticPhantom::Value(double x, double y, double z)
+{
+  if (!inside(x, y, z, 0, 0, 0, 45, 38, 40)) return 0;
+  if (!inside(x, y, z, 0, 0, 0, 41, 34, 36)) return 1000;
+  if (!inside(x, y, z, 0, 0, 0, 37, 30, 32)) return 500;
+  //asymmetric ventricles and small lesions, so that the slice motion can
+  //be recovered by registration
+  if (inside(x, y, z, -9, 2, 6, 5, 18, 8) || inside(x, y, z, 8, -1, 5, 4, 15, 7)) return 1000;
+  if (inside(x, y, z, 15, 15, -10, 4, 4, 4)) return 1000;
+  if (inside(x, y, z, -20, 8, 15, 3, 3, 3) || inside(x, y, z, 10, -12, 18, 5, 5, 5)) return 300;
+  if (inside(x, y, z, 0, -20, -18, 16, 8, 7)) return 600;
+  return 750;
+}
+
+void irtkSyntheticPhantom::Sample(irtkRealImage &image, bool mask)
+{
+  for (int k = 0; k < image.GetZ(); k++) {
+    for (int j = 0; j < image.GetY(); j++) {
+      for (int i = 0; i < image.GetX(); i++) {
+        double x = i, y = j, z = k;
+        image.ImageToWorld(x, y, z);
+        double value = Value(x, y, z);
+        image(i, j, k) = mask ? (value > 0) : value;
+      }
+    }
+  }
+}
+
+void irtkSyntheticPhantom::Simulate(std::vector<irtkRealImage> &stacks,
+  std::vector<irtkRigidTransformation> &stack_transformations,
+  std::vector<double> &thickness,
+  std::vector<irtkRigidTransformation> *motion) const
+{
+  //slice axes of the axial, coronal and sagittal stacks
+  const double axes[3][3][3] = {
+      { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } },
+      { { 1, 0, 0 }, { 0, 0, 1 }, { 0, -1, 0 } },
+      { { 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 } }
+  };
+  boost::mt19937 rng(_seed);
+  boost::normal_distribution<> nd(0, 1);
+  boost::variate_generator<boost::mt19937&, boost::normal_distribution<> > var_nor(rng, nd);
+
+  stacks.clear();
+  stack_transformations.clear();
+  thickness.clear();
+  if (motion != NULL) motion->clear();
+
+  double spacing = FOV / _slices;
+  for (int n = 0; n < _stacks; n++) {
+    irtkImageAttributes attr;
+    attr._x = attr._y = (int)ceil(FOV / _resolution);
+    attr._z = _slices;
+    attr._dx = attr._dy = _resolution;
+    attr._dz = spacing;
+    for (int i = 0; i < 3; i++) {
+      attr._xaxis[i] = axes[n % 3][0][i];
+      attr._yaxis[i] = axes[n % 3][1][i];
+      attr._zaxis[i] = axes[n % 3][2][i];
+    }
+    //further stacks of the same orientation are shifted through-plane
+    double shift = spacing * (n / 3) / ((_stacks + 2) / 3);
+    attr._xorigin = shift * attr._zaxis[0];
+    attr._yorigin = shift * attr._zaxis[1];
+    attr._zorigin = shift * attr._zaxis[2];
+    irtkRealImage stack(attr);
+
+    for (int k = 0; k < stack.GetZ(); k++) {
+      irtkRigidTransformation t;
+      t.PutTranslationX(_motion * var_nor());
+      t.PutTranslationY(_motion * var_nor());
+      t.PutTranslationZ(_motion * var_nor());
+      t.PutRotationX(_motion * var_nor());
+      t.PutRotationY(_motion * var_nor());
+      t.PutRotationZ(_motion * var_nor());
+      if (motion != NULL) motion->push_back(t);
+
+      for (int j = 0; j < stack.GetY(); j++) {
+        for (int i = 0; i < stack.GetX(); i++) {
+          //box profile through the slice
+          double value = 0;
+          for (int p = -2; p <= 2; p++) {
+            double x = i, y = j, z = k + p / 5.0;
+            stack.ImageToWorld(x, y, z);
+            t.Transform(x, y, z);
+            value += Value(x, y, z);
+          }
+          stack(i, j, k) = value / 5;
+        }
+      }
+    }
+
+    if (_noise > 0) {
+      irtkRicianNoise<irtkRealPixel> noise(_noise);
+      noise.SetInit(_seed * 1000 + n);
+      noise.SetInput(&stack);
+      noise.SetOutput(&stack);
+      //Run(int, int, int, int) of the noise filters hides Run()
+      irtkImageToImage<irtkRealPixel> &filter = noise;
+      filter.Run();
+    }
+
+    stacks.push_back(stack);
+    stack_transformations.push_back(irtkRigidTransformation());
+    thickness.push_back(spacing);
+  }
+}
@@ -130,10 +130,7 @@ public:
         //put origin to zero
         irtkRigidTransformation offset;
         patchBased2D3DRegistration<T>::ResetOrigin(target, offset);
-        irtkMatrix mo = offset.GetMatrix();
-        irtkMatrix m = _transformations->at(inputIndex).GetMatrix();
-        m = m*mo;
-        _transformations->at(inputIndex).PutMatrix(m);
+        _transformations->at(inputIndex).PostMultiply(offset);
         //std::cout << " ofsMatrix: " << inputIndex << std::endl;
         //reconstructor->_transformations[inputIndex].GetMatrix().Print();
 
@@ -147,10 +144,8 @@ public:
 
         //reconstructor->_slices_regCertainty[inputIndex] = registration.last_similarity;
         //undo the offset
-        mo.Invert();
-        m = _transformations->at(inputIndex).GetMatrix();
-        m = m*mo;
-        _transformations->at(inputIndex).PutMatrix(m);
+        offset.Invert();
+        _transformations->at(inputIndex).PostMultiply(offset);
       }
 
      printf(".");
@@ -161,9 +156,7 @@ public:
 
   // execute
   void operator() () const {
-    task_scheduler_init init(tbb_no_threads);
-    parallel_for(blocked_range<size_t>(0, _patches.size()), *this);
-    init.terminate();
+    irtkParallelFor(blocked_range<size_t>(0, _patches.size()), *this);
     printf("\n");
   }
 
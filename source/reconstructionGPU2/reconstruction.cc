@@ -28,6 +28,8 @@
 #include <irtkTransformation.h>
 #include <irtkReconstructionGPU.h>
 #include <irtkResampling.h>
+#include <irtkFileToImage.h>
+#include <irtkAsyncWriter.h>
 #include <vector>
 #include <string>
 #include <perfstats.h>
@@ -47,6 +49,18 @@ namespace po = boost::program_options;
 
 using namespace std;
 
+//draws the time between opening and closing a file into the trace
+void traceFileIO(const char *filename, const irtkIOStatistics::Entry &, double opened, double closed)
+{
+  PerfStats::instance().event(string("I/O ") + filename, opened * 1000000.0, closed * 1000000.0);
+}
+
+//memory gauges sampled at the end of each stage
+double memoryResident() { return double(irtkMemoryStatistics::ResidentSetSize()); }
+double memoryPeakResident() { return double(irtkMemoryStatistics::PeakResidentSetSize()); }
+double memoryImages() { return double(irtkMemoryStatistics::Current()); }
+double memoryPeakImages() { return double(irtkMemoryStatistics::Peak()); }
+
 const std::string currentDateTime() {
   time_t     now = time(0);
   struct tm  tstruct;
@@ -110,6 +124,9 @@ int main(int argc, char **argv)
   string tfolder;
   //folder to replace slices with registered slices, if given
   string sfolder;
+  string tcontainer;
+  string scontainer;
+  string sliceContainer;
   //flag to swich the intensity matching on and off
   bool intensity_matching = true;
   unsigned int rec_iterations_first = 4;
@@ -153,6 +170,24 @@ int main(int argc, char **argv)
   unsigned int patchStride = 32;
   bool saveSliceTransformations = false;
   bool useNMI = false;
+  int compressionThreads = 0;
+  int compressionLevel = -1;
+  bool compressionIndex = false;
+  bool memoryMapping = true;
+  unsigned int ioBufferSize = 1024;
+  bool ioReadAhead = false;
+  int writerThreads = 2;
+  string checkpointName = "reconstruction.ckpt";
+  bool resume = false;
+  string coeffCache;
+  string traceName;
+  bool memoryReport = false;
+  bool memoryStatistics = false;
+  unsigned int memoryLimit = 0;
+  unsigned int writerMemory = 1024;
+  int threads = 0;
+  bool pinThreads = false;
+  string numaPolicy;
 
   //in case of manual mask transformation, it is required that the provided manual mask fits the first of the provided image stacks.
   std::string manualMaskName;
@@ -191,6 +226,9 @@ int main(int argc, char **argv)
       ("devices,d", po::value< vector<int> >(&devicesToUse)->multitoken(), "  Select the CP > 3.0 GPUs on which the reconstruction should be executed. Default: all devices > CP 3.0")
       ("tfolder", po::value< string >(&tfolder), "[folder] Use existing slice-to-volume transformations to initialize the reconstruction.")
       ("sfolder", po::value< string >(&sfolder), "[folder] Use existing registered slices and replace loaded ones (have to be equally many as loaded from stacks).")
+      ("tcontainer", po::value< string >(&tcontainer), "[prefix] Like tfolder, but read the slice-to-volume transformations from the slice table [prefix]transformations.slc.")
+      ("scontainer", po::value< string >(&scontainer), "[prefix] Replace the loaded slices, their stack indices and transformations with the packed slices [prefix]slices.nii.gz and the slice table [prefix]transformations.slc.")
+      ("sliceContainer", po::value< string >(&sliceContainer), "[prefix] Save per-slice outputs packed into one 4D image per type ([prefix]slices.nii.gz, [prefix]weights.nii.gz) and one slice table ([prefix]transformations.slc) instead of one file per slice. Use with compressionIndex for parallel reads.")
       ("referenceVolume", po::value<string>(&referenceVolumeName), "Name for an optional reference volume. Will be used as inital reconstruction.")
       ("T1PackageSize", po::value<unsigned int>(&T1PackageSize), "is a test if you can register T1 to T2 using NMI and only one iteration")
       ("useCPU", po::bool_switch(&useCPU)->default_value(false), "use CPU for reconstruction and registration; performs superresolution and robust statistics on CPU. Default is using the GPU")
@@ -208,7 +246,25 @@ int main(int argc, char **argv)
       //--------------------------------------------------------------------------------------------
       ("manualMask", po::value<string>(&manualMaskName), "Binary manual accurate mask to define a region accuratly slice by slice. It is required that the provided manual mask fits the *first* of the provided image stacks in -i <stacks *1*...N>! Nifti or Analyze format.")
       ("useNMI", po::bool_switch(&useNMI)->default_value(false), "use Normalized Mutual Information for slice to volume registration.")
-      ("saveSliceTransformations", po::bool_switch(&saveSliceTransformations)->default_value(false), "Save slice transformations and pixel to voxel mapping. Be aware that the index refers to the stacks cropped with the provided mask (not the original stack slice index).");
+      ("saveSliceTransformations", po::bool_switch(&saveSliceTransformations)->default_value(false), "Save slice transformations and pixel to voxel mapping. Be aware that the index refers to the stacks cropped with the provided mask (not the original stack slice index).")
+      ("compressionThreads", po::value< int >(&compressionThreads)->default_value(0), "Number of threads used to compress .nii.gz output. 0 uses all threads, 1 the serial zlib writer. [Default: 0]")
+      ("compressionLevel", po::value< int >(&compressionLevel)->default_value(-1), "zlib compression level (0-9) of .nii.gz output. [Default: -1, zlib default]")
+      ("compressionIndex", po::bool_switch(&compressionIndex)->default_value(false), "Write .nii.gz output as indexed gzip blocks which can be read in parallel and with random access. Requires compressionThreads != 1.")
+      ("memoryMapping", po::value< bool >(&memoryMapping)->default_value(true), "Memory map uncompressed .nii inputs (copy on write) instead of reading them. Input files must not be overwritten while running. [Default: true]")
+      ("ioBufferSize", po::value< unsigned int >(&ioBufferSize)->default_value(1024), "Size (KB) of the zlib/stdio buffers of image reads and writes. [Default: 1024]")
+      ("ioReadAhead", po::bool_switch(&ioReadAhead)->default_value(false), "Advise the kernel to read inputs sequentially ahead (posix_fadvise), e.g. for network file systems.")
+      ("checkpoint", po::value< string >(&checkpointName)->default_value("reconstruction.ckpt"), "Binary checkpoint of the reconstruction state written after every registration-reconstruction iteration. Use a .gz name to compress it, an empty name to switch checkpointing off. [Default: reconstruction.ckpt]")
+      ("resume", po::bool_switch(&resume)->default_value(false), "Continue an interrupted reconstruction from the checkpoint. Has to be called with the same inputs and options.")
+      ("coeffCache", po::value< string >(&coeffCache), "[folder] Existing folder to cache the slice-volume matrix of the CPU reconstruction (useCPU). The matrix is loaded instead of recomputed when slices, transformations, volume, mask and quality factor are unchanged, e.g. for parameter sweeps with tfolder.")
+      ("memoryReport", po::bool_switch(&memoryReport)->default_value(false), "Print current and predicted memory of the reconstruction structures before the reconstruction starts and stop if the prediction exceeds memoryLimit.")
+      ("memoryLimit", po::value< unsigned int >(&memoryLimit)->default_value(0), "Memory (MB) available to the reconstruction for memoryReport. [Default: 0, physical memory]")
+      ("memoryStatistics", po::bool_switch(&memoryStatistics)->default_value(false), "Count the memory of image data and slice blocks and add it (images, peak images) to the memory table of the stages.")
+      ("trace", po::value< string >(&traceName), "[file.json] Record a timeline of stages, slice tasks and file I/O of all threads in Chrome trace event format (chrome://tracing, ui.perfetto.dev).")
+      ("writerThreads", po::value< int >(&writerThreads)->default_value(2), "Number of background threads writing intermediate and debug outputs. 0 writes synchronously. [Default: 2]")
+      ("writerMemory", po::value< unsigned int >(&writerMemory)->default_value(1024), "Memory (MB) of pending background writes before computation waits for the writer. [Default: 1024]")
+      ("threads", po::value< int >(&threads)->default_value(0), "Number of threads of the CPU stages. [Default: 0, IRTK_THREADS or all cores]")
+      ("pinThreads", po::bool_switch(&pinThreads)->default_value(false), "Pin the threads of the CPU stages to cores (or set IRTK_PIN_THREADS=1).")
+      ("numa", po::value< string >(&numaPolicy), "[default|interleave|first-touch] Placement of the volumes and slices on NUMA systems: interleave pages across all nodes, or allocate slices and large images in parallel on the nodes of the threads using them. [Default: IRTK_NUMA or default]");
     po::variables_map vm;
 
     try
@@ -223,6 +279,21 @@ int main(int argc, char **argv)
       }
 
       po::notify(vm);
+
+      irtkInitializeParallel(threads, pinThreads, numaPolicy.c_str());
+      irtkCofstream::SetCompressionThreads(compressionThreads);
+      irtkCofstream::SetCompressionLevel(compressionLevel);
+      irtkCofstream::SetCompressionIndex(compressionIndex);
+      irtkFileToImage::SetMemoryMapping(memoryMapping);
+      irtkMemoryStatistics::Enable(memoryStatistics);
+      irtkCifstream::SetBufferSize(long(ioBufferSize) * 1024);
+      irtkCifstream::SetReadAhead(ioReadAhead);
+      irtkCofstream::SetBufferSize(long(ioBufferSize) * 1024);
+      if (!traceName.empty())
+      {
+        PerfStats::instance().trace(true);
+        irtkIOStatistics::SetTracer(traceFileIO);
+      }
     }
     catch (po::error& e)
     {
@@ -396,6 +467,12 @@ int main(int argc, char **argv)
   //--------------------------------------------------------------------------------------------
   reconstruction.Set_debugGPU(debug_gpu);
 
+  //intermediate and debug outputs are written in the background
+  irtkAsyncWriter writer(writerThreads, size_t(writerMemory) * 1024 * 1024);
+  reconstruction.SetAsyncWriter(&writer);
+  if (!coeffCache.empty())
+    reconstruction.SetCoeffCache(coeffCache.c_str());
+
   reconstruction.InvertStackTransformations(stack_transformations);
 
   if (!maskName.empty())
@@ -458,7 +535,7 @@ int main(int argc, char **argv)
     exit(1);
   }
   //If no mask was given  try to create mask from the template image in case it was padded
-  if ((mask == NULL) && (sfolder.empty()))
+  if ((mask == NULL) && (sfolder.empty()) && (scontainer.empty()))
   {
     //TODO calculate overlap area. Make mask from that
     mask = new irtkRealImage(stacks[templateNumber]);
@@ -488,7 +565,14 @@ int main(int argc, char **argv)
     tmpStacks.push_back(stacks[i]);
   }
 
-  PerfStats stats;
+  PerfStats &stats = PerfStats::instance();
+  stats.memory("RSS", memoryResident);
+  stats.memory("peak RSS", memoryPeakResident);
+  if (memoryStatistics)
+  {
+    stats.memory("images", memoryImages);
+    stats.memory("peak images", memoryPeakImages);
+  }
   stats.start();
 
   if (T1PackageSize > 0)
@@ -655,7 +739,7 @@ int main(int argc, char **argv)
     cout.rdbuf(file.rdbuf());
   }
 
-  if (T1PackageSize == 0 && sfolder.empty())
+  if (T1PackageSize == 0 && sfolder.empty() && scontainer.empty())
   {
     //volumetric registration
     reconstruction.StackRegistrations(stacks, stack_transformations, templateNumber);
@@ -673,7 +757,7 @@ int main(int argc, char **argv)
 
   average = reconstruction.CreateAverage(stacks, stack_transformations);
   if (debug)
-    average.Write("average1.nii.gz");
+    writer.Write(average, "average1.nii.gz");
 
   //Mask is transformed to the all other stacks and they are cropped
   for (i = 0; i < nStacks; i++)
@@ -692,9 +776,9 @@ int main(int argc, char **argv)
     if (debug)
     {
       sprintf(buffer, "mask%i.nii.gz", i);
-      m.Write(buffer);
+      writer.Write(m, buffer);
       sprintf(buffer, "cropped%i.nii.gz", i);
-      stacks[i].Write(buffer);
+      writer.Write(stacks[i], buffer);
     }
   }
 
@@ -705,7 +789,7 @@ int main(int argc, char **argv)
     cout.rdbuf(file.rdbuf());
   }
 
-  if (T1PackageSize == 0 && sfolder.empty())
+  if (T1PackageSize == 0 && sfolder.empty() && scontainer.empty())
   {
     //volumetric registration
     reconstruction.StackRegistrations(stacks, stack_transformations, templateNumber);
@@ -725,7 +809,7 @@ int main(int argc, char **argv)
     reconstruction.MatchStackIntensitiesWithMasking(stacks, stack_transformations, averageValue, true);
   average = reconstruction.CreateAverage(stacks, stack_transformations);
   if (debug)
-    average.Write("average2.nii.gz");
+    writer.Write(average, "average2.nii.gz");
   //exit(1);
 
   //Create slices and slice-dependent transformations
@@ -751,6 +835,10 @@ int main(int argc, char **argv)
     //TODO replace slices for US experiment
     reconstruction.replaceSlices(sfolder);
   }
+  else if (!scontainer.empty())
+  {
+    reconstruction.replaceSlices((scontainer + "slices.nii.gz").c_str(), (scontainer + "transformations.slc").c_str());
+  }
 
   //Mask all the slices
   reconstruction.MaskSlices();
@@ -777,9 +865,44 @@ int main(int argc, char **argv)
   else
     reconstruction.GlobalBiasCorrectionOff();
 
+  //shrink the slices to their masked region, the GPU path needs them at
+  //the stack size
+  if (useCPU)
+    reconstruction.CropSlices();
+
   //if given read slice-to-volume registrations
   if (!tfolder.empty())
     reconstruction.ReadTransformation((char*)tfolder.c_str());
+  else if (!tcontainer.empty())
+    reconstruction.ReadTransformationTable((tcontainer + "transformations.slc").c_str());
+
+  //continue interrupted reconstruction
+  int firstIteration = 0;
+  if (resume)
+  {
+    if (checkpointName.empty())
+    {
+      cerr << "--resume needs a checkpoint" << endl;
+      return EXIT_FAILURE;
+    }
+    firstIteration = reconstruction.ReadCheckpoint(checkpointName.c_str());
+  }
+
+  //reject jobs which would run out of memory before the expensive stages
+  if (memoryReport)
+  {
+    double current;
+    double predicted = reconstruction.MemoryReport(cout, irtkParallelThreads(), current);
+    double available = (memoryLimit > 0) ? double(memoryLimit) * 1048576.0 : double(irtkMemoryStatistics::PhysicalMemory());
+    //everything else in memory (stacks, libraries, GPU driver) stays
+    predicted += irtkMemoryStatistics::ResidentSetSize() - current;
+    cout << "predicted memory " << predicted / 1048576.0 << " MB of " << available / 1048576.0 << " MB available" << endl;
+    if ((available > 0) && (predicted > available))
+    {
+      cerr << "Predicted memory exceeds the available memory, use fewer threads, a lower resolution or a smaller mask" << endl;
+      return EXIT_FAILURE;
+    }
+  }
 
   stats.sample("overhead/setup");
   pt::ptime tick = pt::microsec_clock::local_time();
@@ -814,7 +937,7 @@ int main(int argc, char **argv)
   }
 
   //interleaved registration-reconstruction iterations
-  for (int iter = 0; iter < iterations; iter++)
+  for (int iter = firstIteration; iter < iterations; iter++)
   {
     //Print iteration number on the screen
     if (!no_log) {
@@ -954,7 +1077,7 @@ int main(int argc, char **argv)
       {
         reconstructed = reconstruction.GetReconstructed();
         sprintf(buffer, "GaussianReconstruction_CPU%i.nii", iter);
-        reconstructed.Write(buffer);
+        writer.Write(reconstructed, buffer);
       }
     }
     else {
@@ -963,7 +1086,7 @@ int main(int argc, char **argv)
       {
         reconstructedGPU = reconstruction.GetReconstructedGPU();
         sprintf(buffer, "GaussianReconstruction_GPU%i.nii", iter);
-        reconstructedGPU.Write(buffer);
+        writer.Write(reconstructedGPU, buffer);
       }
     }
     stats.sample("GaussianReconstruction");
@@ -1049,7 +1172,7 @@ int main(int argc, char **argv)
 #if 0
         reconstructed = reconstruction.GetReconstructed();
         sprintf(buffer, "superCPU%i.nii", i);
-        reconstructed.Write(buffer);
+        writer.Write(reconstructed, buffer);
 #endif
       }
       else {
@@ -1114,12 +1237,12 @@ int main(int argc, char **argv)
         {
           reconstructed = reconstruction.GetReconstructed();
           sprintf(buffer, "superCPU%i.nii", i);
-          reconstructed.Write(buffer);
+          writer.Write(reconstructed, buffer);
         }
         else {
           reconstructedGPU = reconstruction.GetReconstructedGPU();
           sprintf(buffer, "superGPU%i.nii", i);
-          reconstructedGPU.Write(buffer);
+          writer.Write(reconstructedGPU, buffer);
         }
       }
       printf("%d ", i);
@@ -1146,16 +1269,20 @@ int main(int argc, char **argv)
         printf("writing volWeights\n");
         irtkGenericImage<float> volweights = reconstruction.getVolWeights();
         sprintf(buffer, "volWeights%i_GPU.nii", iter);
-        volweights.Write(buffer);
+        writer.Write(volweights, buffer);
         printf("writing weights\n");
         irtkGenericImage<float> weights = reconstruction.getWeights();
         sprintf(buffer, "weights%i_GPU.nii", iter);
-        weights.Write(buffer);
+        writer.Write(weights, buffer);
       }
-      else
+      else if (sliceContainer.empty())
       {
         reconstruction.SaveWeights();
       }
+      else
+      {
+        reconstruction.SaveWeights((sliceContainer + "weights.nii.gz").c_str());
+      }
     }
     //--------------------------------------------------------------------------------------------
     // superpixel (spx)
@@ -1166,16 +1293,20 @@ int main(int argc, char **argv)
         printf("writing volWeights\n");
         irtkGenericImage<float> volweights = reconstruction.getVolWeights();
         sprintf(buffer, "volWeights%i_GPU.nii", iter);
-        volweights.Write(buffer);
+        writer.Write(volweights, buffer);
         printf("writing weights\n");
         irtkGenericImage<float> weights = reconstruction.getWeights();
         sprintf(buffer, "weights%i_GPU.nii", iter);
-        weights.Write(buffer);
+        writer.Write(weights, buffer);
       }
-      else
+      else if (sliceContainer.empty())
       {
         reconstruction.SaveWeights();
       }
+      else
+      {
+        reconstruction.SaveWeights((sliceContainer + "weights.nii.gz").c_str());
+      }
     }
 
     //Save reconstructed image
@@ -1183,14 +1314,14 @@ int main(int argc, char **argv)
     {
       reconstructed = reconstruction.GetReconstructed();
       sprintf(buffer, "image%i_CPU.nii.gz", iter);
-      reconstructed.Write(buffer);
+      writer.Write(reconstructed, buffer);
     }
     else {
       reconstruction.SyncCPU();
       stats.sample("SyncCPU");
       reconstructed = reconstruction.GetReconstructed();
       sprintf(buffer, "image%i_GPU.nii.gz", iter);
-      reconstructed.Write(buffer);
+      writer.Write(reconstructed, buffer);
       //get quality gradient
       //TODO implement patch-based quality metric
       /*if (iter > 0)
@@ -1212,8 +1343,16 @@ int main(int argc, char **argv)
 
     if (saveSliceTransformations)
     {
-      reconstruction.SaveSlices();
-      reconstruction.SaveTransformations();
+      if (sliceContainer.empty())
+      {
+        reconstruction.SaveSlices();
+        reconstruction.SaveTransformations();
+      }
+      else
+      {
+        reconstruction.SaveSlices((sliceContainer + "slices.nii.gz").c_str());
+        reconstruction.SaveTransformations((sliceContainer + "transformations.slc").c_str());
+      }
     }
 
     //Evaluate - write number of included/excluded/outside/zero slices in each iteration in the file
@@ -1233,6 +1372,12 @@ int main(int argc, char **argv)
     if (!no_log) {
       cout.rdbuf(strm_buffer);
     }
+
+    if (!checkpointName.empty())
+    {
+      reconstruction.WriteCheckpoint(checkpointName.c_str(), iter + 1);
+      stats.sample("Checkpoint");
+    }
     printf("\n");
   }// end of interleaved registration-reconstruction iterations
 
@@ -1281,14 +1426,27 @@ int main(int argc, char **argv)
 
   if (useCPU)
   {
-    sprintf(buffer, "performance_CPU_%s.txt", currentDateTime().c_str());
+    sprintf(buffer, "performance_CPU_%s", currentDateTime().c_str());
   }
   else {
-    sprintf(buffer, "performance_GPU_%s.txt", currentDateTime().c_str());
+    sprintf(buffer, "performance_GPU_%s", currentDateTime().c_str());
   }
-  ofstream perf_file(buffer);
+  string perfName = buffer;
+  //pending background writes belong to the I/O statistics below
+  writer.Flush();
+  stats.sample("overall", mss, PerfStats::TIME);
+  //machine readable copies to track stages across runs and releases
+  ofstream perf_json((perfName + ".json").c_str());
+  stats.writeJSON(perf_json);
+  perf_json.close();
+  ofstream perf_csv((perfName + ".csv").c_str());
+  stats.writeCSV(perf_csv);
+  perf_csv.close();
+  ofstream perf_file((perfName + ".txt").c_str());
   stats.print();
   stats.print(perf_file);
+  irtkIOStatistics::Print(cout);
+  irtkIOStatistics::Print(perf_file);
   perf_file << "\n.........overall time: ";
   perf_file << mss;
   perf_file << " s........\n";
@@ -1298,6 +1456,19 @@ int main(int argc, char **argv)
   //save final result
   reconstructed = reconstruction.GetReconstructed();
   reconstructed.Write(outputName.c_str());
+  if (writer.GetNumberOfFailedWrites() > 0)
+  {
+    cerr << "Warning: " << writer.GetNumberOfFailedWrites() << " intermediate files could not be written" << endl;
+  }
+
+  if (!traceName.empty())
+  {
+    stats.sample("save result");
+    ofstream trace_file(traceName.c_str());
+    stats.writeTrace(trace_file);
+    trace_file.close();
+    cout << "Trace written to " << traceName << endl;
+  }
 
   //write computation time to file for tuner test
 